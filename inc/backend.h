@@ -0,0 +1,60 @@
+/**
+ * @file backend.h
+ * @brief hardware backends for the nixie SPI, GPIO and ws2811 LED outputs
+ * @details backend_hw drives the raspberry pi, backend_sim records every SPI word, GPIO edge
+ * and LED frame with a timestamp so the hot paths can run and be measured on any linux box.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __BACKEND_H__
+#define __BACKEND_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "ws2811.h"
+
+typedef struct {
+    const char *name;
+    int (*spi_open)(void);
+    int (*spi_transfer)(int fd, uint8_t *txbuf, uint8_t *rxbuf, uint32_t length);
+    int (*spi_burst)(int fd, uint8_t *txbuf, uint32_t length, const uint16_t *show, uint32_t count);
+    void *(*gpio_open)(void);
+    void (*gpio_function)(void *map, uint8_t pin, uint32_t function);
+    void (*gpio_set)(void *map, uint8_t pin);
+    void (*gpio_clear)(void *map, uint8_t pin);
+    ws2811_return_t (*led_init)(ws2811_t *ws2811);
+    ws2811_return_t (*led_render)(ws2811_t *ws2811);
+    void (*led_fini)(ws2811_t *ws2811);
+    const char *(*led_error)(ws2811_return_t state);
+} backend_t;
+
+/* selected backend, set before the tasks are started */
+extern const backend_t *backend;
+extern const backend_t backend_hw;
+extern const backend_t backend_sim;
+
+/* simulated backend event log */
+#define SIM_EVENTS 65536    /* power of two */
+
+typedef enum {SIM_SPI_WORD, SIM_GPIO_SET, SIM_GPIO_CLEAR, SIM_LED_FRAME} SIM_EVENT_e;
+
+typedef struct {
+    int64_t ns;         /* CLOCK_REALTIME nanoseconds */
+    uint32_t type;      /* SIM_EVENT_e */
+    uint32_t arg;       /* pin, SPI byte count or LED count */
+    uint64_t data;      /* first eight SPI bytes or FNV-1a hash of the LED frame */
+} simevent_t;
+
+typedef struct {
+    atomic_uint_fast64_t head;      /* total events recorded, the ring keeps the last SIM_EVENTS */
+    simevent_t event[SIM_EVENTS];
+} simlog_t;
+
+extern simlog_t simlog;
+
+void sim_reset(void);
+
+#endif /* __BACKEND_H__ */
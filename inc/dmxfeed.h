@@ -0,0 +1,52 @@
+/**
+ * @file dmxfeed.h
+ * @brief E1.31 (sACN) and Art-Net DMX universes received as live LED frames
+ * @details Lighting control software sends a universe of 512 channels a packet, which is 170 RGB LEDs.
+ * The strip takes dmxUniverse and as many universes after it as it needs, counting LEDs left to right,
+ * top to bottom. Art-Net port address 0 is universe 1, the way most consoles number them. When the
+ * sender synchronizes (an E1.31 synchronization address or Art-Net ArtSync) the universes are held
+ * and shown together on the sync packet, otherwise a frame is complete once every universe has
+ * arrived, or when a universe repeats before the others did. Complete frames go out through the
+ * live feed, see livefeed.h, so the roll comes back when the stream stops.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __DMXFEED_H__
+#define __DMXFEED_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nixieclock.h"
+
+#define DMXFEED_E131_PORT 5568
+#define DMXFEED_ARTNET_PORT 6454
+#define DMXFEED_CHANNELS 512
+#define DMXFEED_LEDS (DMXFEED_CHANNELS / 3)
+/* highest universe E1.31 allows */
+#define DMXFEED_UNIVERSE_MAX 63999
+/* packets read by one recvmmsg */
+#define DMXFEED_BATCH 16
+/* largest packet either protocol sends */
+#define DMXFEED_PACKET 638
+/* Art-Net leaves sync mode when no ArtSync has come for this long */
+#define DMXFEED_ARTSYNC_MS 4000
+/* E1.31 sequence numbers this far behind are out of order, further is a restarted source */
+#define DMXFEED_SEQUENCE_WINDOW 20
+
+/* first universe set by main, 0 leaves the DMX input off */
+extern uint32_t dmxUniverse;
+
+int dmxfeed_open(const ledgeometry_t *geometry, int *e131, int *artnet);
+const uint32_t *dmxfeed_receive(int fd);
+void dmxfeed_close(void);
+
+/* packet builders for pixie-dmxgen and the bench, return the packet length */
+size_t dmxfeed_e131(uint8_t *packet, uint16_t universe, uint8_t sequence, uint16_t sync,
+    const uint8_t *data, uint16_t length);
+size_t dmxfeed_e131sync(uint8_t *packet, uint16_t sync, uint8_t sequence);
+size_t dmxfeed_artnet(uint8_t *packet, uint16_t universe, uint8_t sequence, const uint8_t *data, uint16_t length);
+size_t dmxfeed_artsync(uint8_t *packet);
+
+#endif /* __DMXFEED_H__ */
@@ -0,0 +1,70 @@
+/**
+ * @file framesched.h
+ * @brief drift free LED frame pacing on CLOCK_MONOTONIC
+ * @details Every frame has a deadline measured from the start of the roll and the scheduler sleeps
+ * until it on an absolute CLOCK_MONOTONIC timerfd, polled together with a stop fd so shutdown does not
+ * wait out a long record, and wake fds that let a live frame or a button in between two deadlines. Render and
+ * DMA time never push later frames back, a player that falls behind skips frames whose slot has
+ * already passed instead of slowing down.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __FRAMESCHED_H__
+#define __FRAMESCHED_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* a frame that starts more than this many nanoseconds after its deadline is counted late */
+#define FRAMESCHED_LATE 2000000LL
+/* framesched_wait() return when the stop fd woke it before the deadline */
+#define FRAMESCHED_STOP (-1LL)
+/* framesched_wait() return when a wake fd woke it before the deadline, no frame is counted */
+#define FRAMESCHED_WAKE (-2LL)
+/* framesched_wait() deadline that leaves the timer disarmed, only the stop and wake fds end the wait */
+#define FRAMESCHED_NEVER INT64_MAX
+/* eventfds that can interrupt a wait */
+#define FRAMESCHED_WAKEFDS 3
+
+typedef struct {
+    int fd;                 /* CLOCK_MONOTONIC timerfd armed on the next deadline */
+    int stopfd;             /* eventfd that ends a wait early, -1 for none */
+    int wakefd[FRAMESCHED_WAKEFDS]; /* eventfds that interrupt a wait, drained on waking, -1 for none */
+    struct timespec start;  /* CLOCK_MONOTONIC time of deadline 0 */
+    int64_t late;           /* nanoseconds the last frame started after its deadline */
+    int64_t maxLate;        /* worst lateness seen since start */
+    uint64_t frames;        /* frames shown */
+    uint64_t dropped;       /* frames skipped because the next one was already due */
+    uint64_t lateFrames;    /* frames shown more than FRAMESCHED_LATE after their deadline */
+    uint64_t rendered;      /* frames shown that were sent to the LEDs */
+    uint64_t suppressed;    /* frames shown that matched the LEDs already and were not sent */
+} framesched_t;
+
+int framesched_open(framesched_t *fs, int stopfd);
+void framesched_start(framesched_t *fs);
+int64_t framesched_now(const framesched_t *fs);
+int framesched_arm(framesched_t *fs, int64_t deadline);
+int64_t framesched_wait(framesched_t *fs, int64_t deadline);
+int64_t framesched_due(framesched_t *fs, int64_t deadline);
+void framesched_close(framesched_t *fs);
+
+/*
+ * @brief framesched_drop counts a frame that was skipped to catch up
+ */
+static inline void framesched_drop(framesched_t *fs)
+{
+    fs->dropped++;
+}
+
+/*
+ * @brief framesched_since(const framesched_t *fs, int64_t monotonic)
+ * @return CLOCK_MONOTONIC nanoseconds as nanoseconds since framesched_start()
+ */
+static inline int64_t framesched_since(const framesched_t *fs, int64_t monotonic)
+{
+    return monotonic - (((int64_t) fs->start.tv_sec * 1000000000LL) + fs->start.tv_nsec);
+}
+
+#endif /* __FRAMESCHED_H__ */
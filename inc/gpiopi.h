@@ -127,9 +127,19 @@ static inline bool gpio_get_value(void *base, uint8_t pin)
 
         
 
+/*
+ * @brief gpio_set_enable sets or clears bit of an enable register without touching the rest
+ */
+static inline void gpio_set_enable(void *base, int reg, uint32_t bit, bool enable)
+{
+    volatile uint32_t *p = (volatile uint32_t *) (base + reg);
+    *p = enable ? (*p | bit) : (*p & ~bit);
+}
+
 void *gpio_open(void);
 
 void gpio_set_event(void *base, uint8_t pin, EVENT_TYPE_e event, bool async_edge);
+void gpio_set_pull(void *base, uint8_t pin, uint32_t pull);
 
 
 #endif /* __GPIOPI_H__ */
\ No newline at end of file
@@ -0,0 +1,50 @@
+/**
+ * @file idle.h
+ * @brief parks the tubes and LEDs while nobody is there to see them
+ * @details Set from the "idle" object of the system block of the LED config. With "presence" the
+ * clock goes idle once the sensor on the IR input has not seen anyone for that many seconds, with
+ * "from" and "until" only between those local times, with both only in the window and when nobody
+ * is there. A button press counts as someone being there. The clock thread decides, blanks the
+ * tubes and waits with its ticker disarmed. The LED thread sends one black frame and waits with no
+ * deadline. Neither wakes again until someone is seen, a button is pressed or the window ends.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __IDLE_H__
+#define __IDLE_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "nixieclock.h"
+#include "input.h"
+
+#define IDLE_PRESENCE_MAX 86400
+#define IDLE_MINUTES (24 * 60)
+/* without a sensor a button keeps the clock awake in the window this long */
+#define IDLE_HOLD 60
+#define IDLE_OFF {.presence = 0, .from = -1, .until = -1}
+
+/* what the clock thread knows about who is there */
+typedef struct {
+    time_t seen;                /* last second someone was there */
+    bool present;               /* the sensor is high */
+    uint32_t parks;             /* times the clock went idle */
+} idlestate_t;
+
+/* settings main took from the config */
+extern idleconfig_t idleconfig;
+
+int idle_open(void);
+int idle_fd(void);
+bool idle_enabled(void);
+void idle_input(idlestate_t *state, const inputevent_t *event, time_t now);
+bool idle_due(const idlestate_t *state, time_t now, int minute);
+time_t idle_until(time_t now, int minute, int seconds);
+void idle_park(bool parked);
+bool idle_parked(void);
+void idle_close(void);
+
+#endif /* __IDLE_H__ */
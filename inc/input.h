@@ -0,0 +1,64 @@
+/**
+ * @file input.h
+ * @brief buttons and sensor lines read on edges, debounced, with long press and repeat
+ * @details The input thread sleeps in epoll until a line changes. It asks the kernel GPIO
+ * character device for edge events on each line. Where that is not available it falls back to
+ * reading the level register (GPLEV) on a timer, a press between two looks is missed. The first
+ * edge from a settled line is passed on straight away, further edges for INPUT_DEBOUNCE_MS are
+ * bounce, and the line is looked at again once that is over in case it ended up back where it
+ * started. Held buttons give INPUT_LONG and then INPUT_REPEAT from a timer armed only while they
+ * are held, an idle clock never wakes the thread. Every event goes to a queue for each consumer,
+ * with an eventfd the consumer can wait on together with its timer.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __INPUT_H__
+#define __INPUT_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "nixieclock.h"
+
+#define INPUT_CHIP "/dev/gpiochip0"
+/* edges this soon after the one passed on are bounce */
+#define INPUT_DEBOUNCE_MS 20
+/* a button held this long gives INPUT_LONG, then INPUT_REPEAT this often until it is let go */
+#define INPUT_LONG_MS 800
+#define INPUT_REPEAT_MS 150
+/* how often the levels are read when there is no character device */
+#define INPUT_POLL_MS 10
+/* events a consumer can fall behind by before new ones are dropped, power of two */
+#define INPUT_QUEUE 64
+
+typedef enum {INPUT_UP = 0, INPUT_DOWN, INPUT_MODE, INPUT_LS, INPUT_IR, INPUT_LINES} inputLineEnum_t;
+/* buttons give press, long, repeat and release, the sensor lines high and low */
+typedef enum {INPUT_PRESS = 1, INPUT_LONG, INPUT_REPEAT, INPUT_RELEASE, INPUT_HIGH, INPUT_LOW} inputEventEnum_t;
+typedef enum {INPUT_DISPLAY = 0, INPUT_LED, INPUT_CONSUMERS} inputConsumerEnum_t;
+
+typedef struct {
+    int64_t ns;                 /* CLOCK_MONOTONIC time of the edge, or of the timer for long and repeat */
+    uint16_t line;              /* inputLineEnum_t */
+    uint16_t type;              /* inputEventEnum_t */
+    uint32_t arg;               /* repeats so far for INPUT_REPEAT, milliseconds held for INPUT_RELEASE */
+} inputevent_t;
+
+typedef struct {
+    atomic_uint_fast64_t edges;     /* edges seen on all lines */
+    atomic_uint_fast64_t bounces;   /* edges inside the debounce time */
+    atomic_uint_fast64_t events;    /* events queued */
+    atomic_uint_fast64_t dropped;   /* events a full consumer queue had no room for */
+} inputstats_t;
+
+extern inputstats_t inputstats;
+
+int input_open(void);
+int input_fd(inputConsumerEnum_t consumer);
+bool input_take(inputConsumerEnum_t consumer, inputevent_t *event);
+int input_sim_edge(uint8_t pin, bool level, int64_t ns);
+void input_close(void);
+void *inputTask(void *threadid);
+
+#endif /* __INPUT_H__ */
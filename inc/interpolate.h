@@ -0,0 +1,41 @@
+/**
+ * @file interpolate.h
+ * @brief blends a whole LED frame between two color arrays
+ * @details Same result as interpolateRGB() on every pixel, bit for bit, but the divide by max is a
+ * multiply by a fixed point reciprocal worked out once per frame and the pixels are done four or
+ * eight at a time with NEON, SSE2 or AVX2 where the cpu has them.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __INTERPOLATE_H__
+#define __INTERPOLATE_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+/* largest step count the vector paths take, the weights have to fit a signed 16 bit multiply */
+#define INTERPOLATE_VECTOR_MAX 32767
+
+typedef struct {
+    uint32_t from;      /* weight of the current color, max - pos */
+    uint32_t to;        /* weight of the next color, pos */
+    uint32_t max;
+    uint32_t recip;     /* ceil(2^shift / max) */
+    uint32_t shift;     /* 8 + 2 * ceil(log2(max)), enough that the reciprocal is exact for 8 bit colors */
+} interpolateweight_t;
+
+typedef void (*interpolatefn_t)(uint32_t *out, const uint32_t *from, const uint32_t *to, uint32_t count,
+    const interpolateweight_t *w);
+
+typedef struct {
+    const char *name;
+    interpolatefn_t blend;
+} interpolatekernel_t;
+
+void interpolate_weight(interpolateweight_t *w, int pos, int max);
+void interpolate_frame(uint32_t *out, const uint32_t *from, const uint32_t *to, uint32_t count, int pos, int max);
+const interpolatekernel_t *interpolate_kernel(void);
+int interpolate_kernels(const interpolatekernel_t **list);
+
+#endif /* __INTERPOLATE_H__ */
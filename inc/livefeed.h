@@ -0,0 +1,72 @@
+/**
+ * @file livefeed.h
+ * @brief live LED frames from other processes over a SOCK_SEQPACKET unix socket
+ * @details Each message is a livefeedheader_t and count pixels of three bytes. A frame can be sent
+ * as one message or as several pixel ranges, the last one flagged LIVEFEED_END. Complete frames
+ * go through a triple buffer, the render loop takes the newest one without waiting and shows it
+ * at its presentation time. The roll carries on underneath and takes over again once the feed
+ * has been quiet for LIVEFEED_HOLD_MS.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __LIVEFEED_H__
+#define __LIVEFEED_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "nixieclock.h"
+
+#define LIVEFEED_PATH "/run/pixie.sock"
+#define LIVEFEED_MAGIC 0x464C5850      /* "PXLF" little endian */
+#define LIVEFEED_VERSION 1
+/* pixel byte order */
+#define LIVEFEED_RGB 0
+#define LIVEFEED_GRB 1
+/* flags, the message completes the frame */
+#define LIVEFEED_END 0x01
+/* producers connected at once */
+#define LIVEFEED_CLIENTS 4
+/* messages read by one recvmmsg */
+#define LIVEFEED_BATCH 8
+/* a frame this late for its presentation time is dropped instead of shown */
+#define LIVEFEED_LATE 20000000LL
+/* the roll comes back this long after the last live frame */
+#define LIVEFEED_HOLD_MS 1000
+
+typedef struct {
+    uint32_t magic;             /* LIVEFEED_MAGIC */
+    uint16_t version;           /* LIVEFEED_VERSION */
+    uint8_t format;             /* LIVEFEED_RGB or LIVEFEED_GRB */
+    uint8_t flags;              /* LIVEFEED_END on the last message of a frame */
+    uint32_t sequence;          /* frame number, a frame not newer than the last one is dropped */
+    uint32_t start;             /* first LED of the range, counting left to right, top to bottom */
+    uint32_t count;             /* LEDs in the range */
+    uint32_t reserved;
+    int64_t present;            /* CLOCK_MONOTONIC nanoseconds to show the frame, 0 as soon as possible */
+} livefeedheader_t;
+
+typedef struct {
+    atomic_uint_fast64_t messages;      /* messages accepted */
+    atomic_uint_fast64_t frames;        /* complete frames published */
+    atomic_uint_fast64_t shown;         /* frames the render loop took */
+    atomic_uint_fast64_t superseded;    /* frames replaced by a newer one before they were taken */
+    atomic_uint_fast64_t late;          /* frames dropped for missing their presentation time */
+    atomic_uint_fast64_t stale;         /* frames dropped for an old sequence number */
+    atomic_uint_fast64_t rejected;      /* malformed messages */
+} livefeedstats_t;
+
+/* socket path set by main, NULL leaves the socket off, the feed also runs for DMX input */
+extern const char *livefeedPath;
+extern livefeedstats_t livefeedstats;
+
+int livefeed_open(void);
+int livefeed_fd(void);
+void livefeed_ready(const ledgeometry_t *geometry);
+bool livefeed_take(int64_t now, const uint32_t **frame, int64_t *present);
+void livefeed_close(void);
+void *livefeedTask(void *threadid);
+
+#endif /* __LIVEFEED_H__ */
@@ -0,0 +1,94 @@
+/**
+ * @file metrics.h
+ * @brief counters and log2 histograms of the clock and LED hot paths
+ * @details Each metric has exactly one thread that records it, so recording is a relaxed load and
+ * store on the metric's own cache lines, no lock and no read-modify-write. The metrics thread reads
+ * them once a second and writes Prometheus text exposition to a file, for node_exporter's textfile
+ * collector or anything that can read a file. Durations are nanoseconds, bucket i counts values up
+ * to 2^(METRIC_SHIFT + i) ns, 1 us to 1 s, the last bucket everything longer.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __METRICS_H__
+#define __METRICS_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define METRICS_PATH "/run/pixie.prom"
+/* the file is rewritten this often */
+#define METRICS_INTERVAL_MS 1000
+#define METRIC_SHIFT 10
+#define METRIC_BUCKETS 22
+#define METRIC_ALIGN 64
+
+typedef struct {
+    _Alignas(METRIC_ALIGN) atomic_uint_fast64_t bucket[METRIC_BUCKETS];
+    atomic_uint_fast64_t count;
+    atomic_int_fast64_t sum;        /* nanoseconds */
+    atomic_int_fast64_t max;        /* nanoseconds */
+} metrichist_t;
+
+typedef struct {
+    metrichist_t flip;              /* second boundary to LE high, timeTask */
+    metrichist_t spi;               /* nixie frame SPI transfer, timeTask */
+    metrichist_t build;             /* LED frame build and copy to the channels, ledTask */
+    metrichist_t render;            /* ws2811 render call, ledTask */
+    metrichist_t frame;             /* LED frame start after its deadline, ledTask */
+    _Alignas(METRIC_ALIGN) atomic_uint_fast64_t secondsMissed;  /* timeTask */
+    atomic_uint_fast64_t clockSteps;                            /* timeTask */
+    _Alignas(METRIC_ALIGN) atomic_uint_fast64_t framesLate;     /* ledTask, over FRAMESCHED_LATE */
+    atomic_uint_fast64_t framesDropped;                         /* ledTask */
+} metrics_t;
+
+/* stats file set by main, NULL leaves the metrics thread off */
+extern const char *metricsPath;
+extern metrics_t metrics;
+
+static inline int64_t metric_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+/*
+ * @brief metric_record(metrichist_t *h, int64_t ns) adds a duration, only from the metric's thread
+ */
+static inline void metric_record(metrichist_t *h, int64_t ns)
+{
+    int b = 0;
+
+    if (ns < 0) ns = 0;
+    if (ns > (1LL << METRIC_SHIFT)) {
+        b = 64 - __builtin_clzll((uint64_t) ns - 1) - METRIC_SHIFT;
+        if (b >= METRIC_BUCKETS) b = METRIC_BUCKETS - 1;
+    }
+    atomic_store_explicit(&h->bucket[b], atomic_load_explicit(&h->bucket[b], memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&h->sum, atomic_load_explicit(&h->sum, memory_order_relaxed) + ns, memory_order_relaxed);
+    if (ns > atomic_load_explicit(&h->max, memory_order_relaxed)) atomic_store_explicit(&h->max, ns, memory_order_relaxed);
+    /* count last, a reader that sees it also sees the bucket */
+    atomic_store_explicit(&h->count, atomic_load_explicit(&h->count, memory_order_relaxed) + 1, memory_order_release);
+}
+
+/*
+ * @brief metric_set(atomic_uint_fast64_t *counter, uint64_t value) for a counter kept elsewhere
+ */
+static inline void metric_set(atomic_uint_fast64_t *counter, uint64_t value)
+{
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+static inline void metric_add(atomic_uint_fast64_t *counter, uint64_t value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+int64_t metric_quantile(const metrichist_t *h, double q);
+int metrics_write(const char *path);
+void *metricsTask(void *threadid);
+
+#endif /* __METRICS_H__ */
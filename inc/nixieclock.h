@@ -30,6 +30,11 @@
  
 #ifndef __NIXIECLOCK_H__
 #define __NIXIECLOCK_H__
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <poll.h>
+#include <unistd.h>
 
 #define SDA1 2
 #define SCL1 3
@@ -65,60 +70,193 @@
 #define PWM2 20
 #define PWM3 21
 
+/* default LED geometry, the six tube clock has a single row of eight. Panels set "width",
+ * "height" and "layout" in the system object of the LED config instead.
+ */
 #define LEDWIDTH	8
 #define LEDHEIGHT	1
-#define LEDCOUNT    (LEDWIDTH * LEDHEIGHT)
+/* most LEDs the strips together are allowed to have */
+#define LEDMAX      16384
+/* ws2811 PWM channels, each drives its own strip and both are sent by the same DMA */
+#define LEDCHANNELS 2
+/* every LED frame is padded to a whole cache line */
+#define LEDFRAME_ALIGN 64
+#define LEDFRAME_STRIDE(n) ((((n) + (LEDFRAME_ALIGN / sizeof(uint32_t)) - 1) / (LEDFRAME_ALIGN / sizeof(uint32_t))) * (LEDFRAME_ALIGN / sizeof(uint32_t)))
 
-#define CONSIDERATE_SLEEP 950000000L
-#define INTERPOLATE_STEP 25
+/* NIXIE_LATCH_LEAD is how many nanoseconds ahead of the second the clock wakes up. The next
+ * frame is already in the shift registers, so all that is left at the boundary is raising LE.
+ * A raspberry pi 3B+ took about 130usec to wake up, the remainder of the lead is spent polling
+ * the clock for the boundary. If the latch error reported in DEBUG builds is large, raise it.
+ */
+#define NIXIE_LATCH_LEAD 250000L
+/* MODE shows the date as month, day and year for this many seconds */
+#define NIXIE_DATE_SECONDS 3
+/* LEDFPS is the default frame rate of slow fades, "fps" in the system object or a record changes it */
+#define LEDFPS 40
+#define LEDFPS_MAX 200
+/* UP and DOWN step the brightness of the strips by this much, held they keep stepping */
+#define LEDBRIGHTNESS_STEP 16
+/* TIMELINE_LIMIT is the default memory cap in KB for the compiled LED timeline, 0 leaves it off
+ * and every slow step is interpolated as it is shown. Overridden by "timeline" in the system object.
+ */
+#define TIMELINE_LIMIT 0
 
 typedef enum {COLON_OFF = 0, COLON_BLINK, COLON_ON} colonEnum_t;
 
-typedef union {
-    uint64_t ll;
-    uint8_t b[8];
-} llconv_t;
+/* LAYOUT_ROWS every row runs left to right, LAYOUT_SERPENTINE odd rows are wired right to left */
+typedef enum {LAYOUT_ROWS = 0, LAYOUT_SERPENTINE} ledLayoutEnum_t;
+
+typedef struct {
+    uint32_t gpio;
+    uint32_t count;             /* LEDs on this strip, 0 if the channel is not used */
+    uint32_t brightness;
+    uint32_t strip;             /* ws2811 strip type, the order the colors are sent in */
+} ledchannel_t;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t count;             /* width * height */
+    uint32_t stride;            /* LEDs per frame in memory, count padded to LEDFRAME_ALIGN */
+    ledLayoutEnum_t layout;
+    ledchannel_t channel[LEDCHANNELS];  /* the first channel takes the first LEDs of a frame */
+} ledgeometry_t;
+
+/* threads the "realtime" object of the system block can set up, see realtime.h */
+typedef enum {RT_CLOCK = 0, RT_LED, RT_FEED, RT_THREADS} rtThreadEnum_t;
+
+typedef struct {
+    int32_t priority;           /* SCHED_FIFO 1 to 99, 0 leaves the thread on the normal scheduler */
+    int32_t cpu;                /* core the thread is pinned to, -1 for any */
+} rtthread_t;
+
+typedef struct {
+    uint32_t lock;              /* lock the daemon's memory and prefault the realtime stacks */
+    rtthread_t thread[RT_THREADS];
+} realtime_t;
+
+/* when the clock parks its tubes and LEDs, see idle.h */
+typedef struct {
+    uint32_t presence;          /* seconds after the last sign of someone, 0 if there is no sensor */
+    int32_t from;               /* local minute of the day the idle window starts, -1 for no window */
+    int32_t until;              /* local minute of the day it ends */
+} idleconfig_t;
+
+/* crossfade, dimming and cathode refresh of the tubes, see tubefx.h */
+typedef struct {
+    uint32_t fade;              /* milliseconds the digits crossfade over after each flip, 0 flips hard */
+    uint32_t brightness;        /* percent of each PWM period the tubes are lit */
+    uint32_t refreshEvery;      /* minutes between cathode refreshes, 0 for none */
+    int32_t refreshAt;          /* local minute of the day of a daily refresh, -1 for none */
+    uint32_t refreshSeconds;    /* how long a refresh runs */
+    uint32_t reserved;
+} tubeconfig_t;
 
 typedef struct {
-    uint32_t color[LEDCOUNT];
     int32_t delay;
+    uint32_t steps;             /* frames a slow record fades over, delay * fps / 1000, 1 if fast */
     bool isFast;
 } ledroll_t;
 
+/*
+ * @brief ledroll_offset(const ledroll_t *p, uint32_t step)
+ * @return nanoseconds from the start of the record that step is shown, steps returns the record length
+ */
+static inline int64_t ledroll_offset(const ledroll_t *p, uint32_t step)
+{
+    return ((int64_t) p->delay * 1000000LL * step) / p->steps;
+}
+
+struct ledtimeline;
+
 typedef struct {
     int32_t count;
-    int32_t pos;
     colonEnum_t colon;
+    uint32_t timelineLimit;     /* KB */
+    ledgeometry_t geometry;
+    realtime_t realtime;        /* only taken at startup, a reload does not change it */
+    idleconfig_t idle;          /* only taken at startup */
+    tubeconfig_t tubes;         /* only taken at startup */
     ledroll_t *roll;
+    uint32_t *pixels;           /* count frames of geometry.stride colors in strip order */
+    struct ledtimeline *timeline;   /* the roll compiled into frames, NULL to interpolate */
+    const char *path;           /* file the roll was read from */
+    void *map;                  /* mapped .pxr the roll and pixels point into, NULL if they are heap */
+    size_t mapSize;
 } ledrollhead_t;
 
+/*
+ * @brief ledposition(const ledgeometry_t *g, uint32_t index)
+ * @return position on the strip of the LED at index counting left to right, top to bottom
+ */
+static inline uint32_t ledposition(const ledgeometry_t *g, uint32_t index)
+{
+    uint32_t row = index / g->width;
+    uint32_t column = index % g->width;
+    if ((g->layout == LAYOUT_SERPENTINE) && (row & 1)) column = g->width - 1 - column;
+    return (row * g->width) + column;
+}
+
+/*
+ * @brief ledroll_color(const ledrollhead_t *ledrollhead, int record)
+ * @return colors for record, ready to copy to the strip
+ */
+static inline uint32_t *ledroll_color(const ledrollhead_t *ledrollhead, int record)
+{
+    return &ledrollhead->pixels[(size_t) record * ledrollhead->geometry.stride];
+}
+
+/*
+ * Termination is a flag the loops test without a lock and an eventfd the tasks block on together
+ * with their timers. The eventfd is never read, once written it stays readable and wakes every poll.
+ */
 typedef struct {
-    pthread_mutex_t mutex;
-    bool kill;
+    atomic_bool kill;
+    int fd;
 } terminate_t;
 
 extern terminate_t terminate;
+/* run the startup tube test sequence */
+extern bool nixieTest;
 
 static inline bool isTerminate(void)
 {
-    bool rv;
-    pthread_mutex_lock(&terminate.mutex);
-	rv = terminate.kill;
-    pthread_mutex_unlock(&terminate.mutex);
-    return rv;
+    return atomic_load_explicit(&terminate.kill, memory_order_relaxed);
 }
 
+/*
+ * @brief notifyToTerminate asks every task to finish, safe to call from a signal handler
+ */
 static inline void notifyToTerminate(void)
 {
-    pthread_mutex_lock(&terminate.mutex);
-	terminate.kill = true;
-    pthread_mutex_unlock(&terminate.mutex);
+    uint64_t one = 1;
+    atomic_store(&terminate.kill, true);
+    if (terminate.fd >= 0) {
+        if (write(terminate.fd, &one, sizeof(one)) < 0) return; /* already at the eventfd maximum */
+    }
+}
+
+/*
+ * @brief terminateWait sleeps up to ms milliseconds, returning early on termination
+ * @return true if termination was asked for
+ */
+static inline bool terminateWait(int ms)
+{
+    struct pollfd pfd = {.fd = terminate.fd, .events = POLLIN};
+    poll(&pfd, 1, ms);
+    return isTerminate();
 }
 
-void setColon(bool thisColon);
+void setColon(colonEnum_t thisColon);
 bool nextColon(bool thisColon);
 
+uint8_t interpolateColor(uint8_t color, uint8_t nextcolor, int pos, int max);
+int32_t interpolateRGB(uint32_t color, uint32_t nextcolor, int pos, int max);
+
 void *timeTask(void *threadid);
 void *ledTask(void *threadid);
 ledrollhead_t *parseconfig(void);
+ledrollhead_t *parseconfigfile(const char *path);
+bool configslot(const char *path, const char **json, const char **compiled);
+void freeconfig(ledrollhead_t *ledrollhead);
 #endif /* __NIXIECLOCK_H__ */
\ No newline at end of file
@@ -0,0 +1,65 @@
+/**
+ * @file nixieframe.h
+ * @brief table driven encoder for the 64 bit HV driver word of the six tube clock
+ * @details Tube slot 0 is the leftmost (tens of hours) tube. Every tube has ten cathode bits,
+ * the two colon groups have two bits each. The word is kept already byte swapped in the order
+ * it is shifted out, so only the bit fields of tubes whose digit changed are patched.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __NIXIEFRAME_H__
+#define __NIXIEFRAME_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NIXIE_TUBES 6
+#define NIXIE_DIGITS 10
+/* digit value for a tube with all cathodes off */
+#define NIXIE_BLANK NIXIE_DIGITS
+
+typedef union {
+    uint64_t ll;
+    uint8_t b[8];
+} llconv_t;
+
+typedef struct {
+    llconv_t word;                  /* driver word in shift out byte order */
+    uint8_t digit[NIXIE_TUBES];     /* digit currently encoded in each slot or NIXIE_BLANK */
+    bool colon;
+} nixieframe_t;
+
+typedef struct {
+    uint64_t digit[NIXIE_TUBES][NIXIE_DIGITS + 1];  /* cathode bit for slot/digit, blank is 0 */
+    uint64_t slot[NIXIE_TUBES];                     /* all ten cathode bits of a slot */
+    uint64_t colon;                                 /* both colon groups */
+} nixielut_t;
+
+extern const nixielut_t nixielut;
+
+void nixie_frame_init(nixieframe_t *frame);
+
+/*
+ * @brief nixie_frame_set_digit patches one tube slot, no-op if the digit is already encoded
+ */
+static inline void nixie_frame_set_digit(nixieframe_t *frame, int slot, uint8_t digit)
+{
+    if (digit > NIXIE_BLANK) digit = NIXIE_BLANK;
+    if (frame->digit[slot] == digit) return;
+    frame->word.ll = (frame->word.ll & ~nixielut.slot[slot]) | nixielut.digit[slot][digit];
+    frame->digit[slot] = digit;
+}
+
+static inline void nixie_frame_set_colon(nixieframe_t *frame, bool colon)
+{
+    if (frame->colon == colon) return;
+    frame->word.ll ^= nixielut.colon;
+    frame->colon = colon;
+}
+
+void nixie_frame_set_digits(nixieframe_t *frame, const uint8_t digit[NIXIE_TUBES], bool colon);
+void nixie_frame_set_hms(nixieframe_t *frame, int hours, int minutes, int seconds, bool colon);
+void nixie_frame_set_bcd(nixieframe_t *frame, uint32_t bcd, bool colon);
+
+#endif /* __NIXIEFRAME_H__ */
@@ -0,0 +1,43 @@
+/**
+ * @file reactor.h
+ * @brief the clock and the LEDs on one thread waiting on one epoll set
+ * @details With -e the daemon runs the clock and the LED roll from a single thread instead of one
+ * each. The second tick and the frame deadline are timerfds, SIGINT, SIGTERM, SIGHUP and SIGUSR1
+ * come in on a signalfd, and the button, live feed and idle eventfds are on the same set. Events
+ * that are ready together are handled in reactorSourceEnum_t order, so the tube flip always goes
+ * first, and a LED frame due just ahead of the flip waits until the tubes have flipped.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __REACTOR_H__
+#define __REACTOR_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nixieclock.h"
+
+/* ready events taken by one epoll_wait */
+#define REACTOR_EVENTS 16
+/* a LED frame due this many nanoseconds either side of the tick waits for the flip */
+#define REACTOR_GUARD 1000000LL
+
+/* what woke the reactor, in the order they are handled */
+typedef enum {REACTOR_TICK = 0, REACTOR_STOP, REACTOR_SIGNAL, REACTOR_DISPLAY, REACTOR_FRAME, REACTOR_LED,
+    REACTOR_SOURCES} reactorSourceEnum_t;
+
+typedef struct {
+    uint64_t wakeups;                   /* returns from epoll_wait */
+    uint64_t handled[REACTOR_SOURCES];  /* ready events of each source */
+    uint64_t deferred;                  /* LED frames that waited for the flip */
+} reactorstats_t;
+
+/* written by the reactor thread only, read once it has finished */
+extern reactorstats_t reactorstats;
+
+int reactor_open(void);
+void reactor_close(void);
+void *reactorTask(void *threadid);
+
+#endif /* __REACTOR_H__ */
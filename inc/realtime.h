@@ -0,0 +1,38 @@
+/**
+ * @file realtime.h
+ * @brief SCHED_FIFO priorities, CPU pinning and locked memory for the time critical threads
+ * @details Set from the "realtime" object of the system block of the LED config, which main reads
+ * before any thread starts. Left out, every thread stays on the normal scheduler like any other
+ * process. The clock, LED and feed threads each apply their own settings as they start. What the
+ * daemon is not allowed to do is logged and left as it is, the clock still runs without them.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __REALTIME_H__
+#define __REALTIME_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nixieclock.h"
+
+#define REALTIME_ANY (-1)
+#define REALTIME_PRIORITY_MAX 99
+#define REALTIME_CPU_MAX 63
+/* names of the rtThreadEnum_t threads in the config */
+#define REALTIME_NAMES {"clock", "led", "feed"}
+#define REALTIME_OFF {.lock = 0, .thread = {{0, REALTIME_ANY}, {0, REALTIME_ANY}, {0, REALTIME_ANY}}}
+/* with the memory locked every thread stack is resident, so they are made this size instead of 8MB */
+#define REALTIME_THREAD_STACK (512 * 1024)
+/* stack each realtime thread touches as it starts, so it never takes a page fault near a boundary */
+#define REALTIME_PREFAULT (64 * 1024)
+
+/* settings main took from the config, the threads read them as they start */
+extern realtime_t realtime;
+
+int realtime_lock(void);
+int realtime_thread(rtThreadEnum_t which);
+void realtime_unlock(void);
+
+#endif /* __REALTIME_H__ */
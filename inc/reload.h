@@ -0,0 +1,32 @@
+/**
+ * @file reload.h
+ * @brief reloads the LED roll on SIGHUP or when the config file changes
+ * @details The new file is parsed and compiled on its own thread and handed to the render loop
+ * through an atomic pointer. The render loop takes it at a frame boundary without blocking and
+ * hands the roll it replaced back the same way to be freed off the render thread.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __RELOAD_H__
+#define __RELOAD_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nixieclock.h"
+
+/* quiet time after the last change to the file before it is read, editors write in several steps */
+#define RELOAD_SETTLE_MS 200
+/* how often the reload thread looks for the LED task to start playing */
+#define RELOAD_POLL_MS 100
+
+ledrollhead_t *loadconfig(void);
+int reload_open(void);
+void reload_request(void);
+void reload_ready(const ledrollhead_t *active);
+ledrollhead_t *reload_take(ledrollhead_t *current);
+void reload_close(void);
+void *reloadTask(void *threadid);
+
+#endif /* __RELOAD_H__ */
@@ -0,0 +1,62 @@
+/**
+ * @file rollfile.h
+ * @brief compiled LED roll file (.pxr) that the daemon maps and plays without parsing
+ * @details pixie-compile turns a LEDcolor.json into a .pxr. The file is a fixed header followed by
+ * the records in ledroll_t layout and the frames in strip order, level applied and padded to
+ * LEDFRAME_ALIGN, exactly as parseconfig() builds them in memory. The loader checks the header and
+ * the CRC, then points the roll at the read only mapping, so the frames are shared page cache.
+ * Fields are in the byte order of the machine that compiled the file, the byte order mark rejects
+ * a file from a machine of the other order.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __ROLLFILE_H__
+#define __ROLLFILE_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nixieclock.h"
+
+#define ROLLFILE_MAGIC "PXRL"
+/* bump when the header or the record layout changes, older daemons refuse newer files */
+#define ROLLFILE_VERSION 5
+#define ROLLFILE_BYTEORDER 0x01020304
+#define ROLLFILE_EXTENSION ".pxr"
+
+typedef struct {
+    uint32_t gpio;
+    uint32_t count;
+    uint32_t brightness;
+    uint32_t strip;
+} rollfilechannel_t;
+
+typedef struct {
+    char magic[4];              /* ROLLFILE_MAGIC */
+    uint16_t version;           /* ROLLFILE_VERSION */
+    uint16_t headerSize;        /* sizeof(rollfileheader_t) */
+    uint32_t byteOrder;         /* ROLLFILE_BYTEORDER */
+    uint32_t crc;               /* CRC-32 of the whole file with this field zero */
+    uint64_t size;              /* bytes in the file */
+    uint32_t count;             /* records */
+    uint32_t colon;             /* colonEnum_t */
+    uint32_t timelineLimit;     /* KB */
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;            /* LEDs per frame */
+    uint32_t layout;            /* ledLayoutEnum_t */
+    uint32_t reserved;
+    rollfilechannel_t channel[LEDCHANNELS];
+    realtime_t realtime;
+    idleconfig_t idle;
+    tubeconfig_t tubes;
+    uint64_t rollOffset;        /* count ledroll_t records */
+    uint64_t pixelOffset;       /* count frames of stride colors, LEDFRAME_ALIGN aligned */
+} rollfileheader_t;
+
+uint32_t rollfile_crc(uint32_t crc, const void *data, size_t length);
+ledrollhead_t *rollfile_load(const char *path);
+int rollfile_write(const ledrollhead_t *ledrollhead, const char *path);
+
+#endif /* __ROLLFILE_H__ */
@@ -26,9 +26,19 @@
 #define SPI_MODE SPI_MODE_1
 #define SPI_SPEED 500000
 #define SPI_DELAY 0
+/* bursts of driver words for the tube effects shift faster so a word takes 16us, not 128us */
+#define SPI_BURST_SPEED 4000000
+/* transfers in one SPI_IOC_MESSAGE, the ioctl size field limits it to 511 */
+#define SPI_BURST_MAX 256
+/* with dtoverlay=spi0-2cs,cs1_pin=22 LE is the chip select of SPI_CHANNEL, low while a word shifts
+ * and pulsed high after each word of a burst, which latches it */
+#define SPI_CS_PIN 22
+/* the spi core holds the chip select high this long between the transfers of a burst */
+#define SPI_CS_GAP_US 10
 
 int spi_open();
 
 int spi_transfer(int fd, uint8_t *txbuf, uint8_t *rxbuf, uint32_t length);
+int spi_burst(int fd, uint8_t *txbuf, uint32_t length, const uint16_t *show, uint32_t count);
 
 #endif /* __SPIPI_H__ */
\ No newline at end of file
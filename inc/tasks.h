@@ -0,0 +1,36 @@
+/**
+ * @file tasks.h
+ * @brief the clock and the LED tasks one wakeup at a time
+ * @details timeTask and ledTask each block on their own timer and hand every wakeup to these.
+ * The reactor (see reactor.h) waits on all of their file descriptors at once instead and hands
+ * the wakeups to the same functions, so both ways run the same clock and the same roll.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __TASKS_H__
+#define __TASKS_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "nixieclock.h"
+#include "ticker.h"
+#include "framesched.h"
+
+/* what the tubes show and where the clock is, private to timeTask.c */
+typedef struct clockstate clockstate_t;
+/* where the roll is and what the strips show, private to ledTask.c */
+typedef struct ledstate ledstate_t;
+
+clockstate_t *clocktask_open(ticker_t *ticker);
+int clocktask_wake(clockstate_t *cs, ticker_t *ticker, int rv, struct timespec *now);
+void clocktask_close(clockstate_t *cs, ticker_t *ticker);
+
+ledstate_t *ledtask_open(ledrollhead_t *roll, framesched_t *fs);
+int64_t ledtask_deadline(const ledstate_t *ls);
+int ledtask_frame(ledstate_t *ls, framesched_t *fs, int64_t now);
+void ledtask_close(ledstate_t *ls, framesched_t *fs);
+
+#endif /* __TASKS_H__ */
@@ -0,0 +1,46 @@
+/**
+ * @file ticker.h
+ * @brief second boundary ticker built on a CLOCK_REALTIME timerfd
+ * @details The timer is armed on absolute second boundaries with TFD_TIMER_CANCEL_ON_SET
+ * so a step of the wall clock (NTP, RTC, date) cancels it and it can be re-armed against
+ * the new time. The timer can be armed a lead time ahead of each boundary for callers that need
+ * to be awake and ready when the second changes. Each wakeup records how late it was. The wait
+ * also returns when a stop fd becomes readable so shutdown does not wait for the next second.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __TICKER_H__
+#define __TICKER_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define TICKER_TICK 0
+#define TICKER_STEPPED 1
+#define TICKER_STOP 2
+#define TICKER_WAKE 3
+
+typedef struct {
+    int fd;
+    int stopfd;         /* eventfd that ends the wait early, -1 for none */
+    int wakefd;         /* eventfd that interrupts the wait, drained on waking, -1 for none */
+    long lead;          /* nanoseconds ahead of the boundary the timer fires */
+    time_t second;      /* next boundary the timer is armed for */
+    time_t boundary;    /* boundary of the last wakeup */
+    int64_t late;       /* nanoseconds the last wakeup came after its deadline (boundary - lead) */
+    int64_t maxLate;    /* worst lateness seen since open */
+    uint64_t ticks;     /* wakeups */
+    uint64_t missed;    /* boundaries that expired without a wakeup of their own */
+    uint32_t steps;     /* clock steps that cancelled the timer */
+} ticker_t;
+
+int ticker_open(ticker_t *tk, long lead, int stopfd);
+int ticker_arm(ticker_t *tk);
+int ticker_park(ticker_t *tk, time_t until);
+int ticker_wait(ticker_t *tk, struct timespec *now);
+int ticker_read(ticker_t *tk, struct timespec *now);
+void ticker_close(ticker_t *tk);
+
+#endif /* __TICKER_H__ */
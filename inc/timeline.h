@@ -0,0 +1,36 @@
+/**
+ * @file timeline.h
+ * @brief LED roll compiled into ready to send frames
+ * @details The roll is static and loops, so every interpolated step can be worked out once at load
+ * time. Playing the timeline is then a copy of one frame and a sleep until the next offset.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __TIMELINE_H__
+#define __TIMELINE_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nixieclock.h"
+
+typedef struct ledtimeline {
+    uint32_t count;     /* frames in one pass of the roll */
+    uint32_t leds;      /* LEDs in a frame */
+    uint32_t stride;    /* LEDs per frame, padded so every frame starts on a cache line */
+    int64_t period;     /* nanoseconds for one pass of the roll */
+    int64_t *offset;    /* nanoseconds from the start of the pass each frame is shown */
+    uint32_t *frame;    /* count * stride colors */
+} ledtimeline_t;
+
+static inline const uint32_t *timeline_frame(const ledtimeline_t *tl, uint32_t index)
+{
+    return &tl->frame[(size_t) index * tl->stride];
+}
+
+size_t timeline_size(const ledrollhead_t *ledrollhead);
+ledtimeline_t *timeline_compile(const ledrollhead_t *ledrollhead, size_t limit);
+void timeline_free(ledtimeline_t *tl);
+
+#endif /* __TIMELINE_H__ */
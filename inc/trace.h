@@ -0,0 +1,113 @@
+/**
+ * @file trace.h
+ * @brief always on ring buffers of timestamped hot path events, one per thread
+ * @details A thread claims a ring with trace_thread() and is the only writer of it, an event is a
+ * clock read and a few stores with no lock and no read-modify-write. The rings keep the last
+ * TRACE_EVENTS events of each thread. trace_dump() writes them all with nothing but open, write
+ * and close, so it can run in a signal handler. The clock dumps on its own when it misses a
+ * second and SIGUSR1 dumps on demand. tools/trace2chrome.py turns a dump into Chrome trace JSON
+ * for chrome://tracing or Perfetto.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __TRACE_H__
+#define __TRACE_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define TRACE_PATH "/run/pixie.trace"
+#define TRACE_MAGIC "PXTR"
+#define TRACE_VERSION 1
+/* events kept per thread, power of two */
+#define TRACE_EVENTS 4096
+#define TRACE_RINGS 4
+#define TRACE_NAME 16
+/* a missed second dumps again only after this many seconds, the first dump is the one that matters */
+#define TRACE_DUMP_HOLD 60
+
+/* B and E pairs are spans, the rest are instants, tools/trace2chrome.py has the same table */
+typedef enum {
+    TRACE_SLEEP = 1,        /* B waiting for the next deadline */
+    TRACE_WAKE,             /* E the wait ended, arg nanoseconds late */
+    TRACE_BOUNDARY,         /* the latch spin saw the second boundary */
+    TRACE_SPI,              /* B nixie frame SPI transfer */
+    TRACE_SPI_END,          /* E */
+    TRACE_LATCH,            /* LE raised, arg nanoseconds after the boundary */
+    TRACE_BUILD,            /* B LED frame build */
+    TRACE_BUILD_END,        /* E arg 1 if the frame changed */
+    TRACE_RENDER,           /* B LED render submitted */
+    TRACE_RENDER_END,       /* E */
+    TRACE_MISSED,           /* arg seconds missed */
+    TRACE_STEPPED,          /* the wall clock was stepped */
+    TRACE_LIVE,             /* a live frame was taken */
+} TRACE_EVENT_e;
+
+typedef struct {
+    int64_t ns;             /* CLOCK_MONOTONIC */
+    uint32_t type;          /* TRACE_EVENT_e */
+    uint32_t arg;
+} traceevent_t;
+
+typedef struct {
+    _Alignas(64) atomic_uint_fast64_t head;    /* events written, the ring keeps the last TRACE_EVENTS */
+    char name[TRACE_NAME];
+    traceevent_t event[TRACE_EVENTS];
+} tracering_t;
+
+/* file layout, the header then every claimed ring as name, head and events */
+typedef struct {
+    char magic[4];          /* TRACE_MAGIC */
+    uint32_t version;       /* TRACE_VERSION */
+    uint32_t rings;
+    uint32_t events;        /* TRACE_EVENTS */
+    int64_t realtime;       /* CLOCK_REALTIME - CLOCK_MONOTONIC when dumped, nanoseconds */
+} traceheader_t;
+
+extern const char *tracePath;
+extern _Thread_local tracering_t *traceRing;
+
+void trace_thread(const char *name);
+int trace_dump(const char *path);
+void trace_signal(int signum);
+
+/*
+ * @brief trace_at(uint32_t type, uint32_t arg, int64_t ns) records an event at a time already read
+ */
+static inline void trace_at(uint32_t type, uint32_t arg, int64_t ns)
+{
+    tracering_t *ring = traceRing;
+    uint64_t head;
+    traceevent_t *e;
+
+    if (ring == NULL) return;
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    e = &ring->event[head & (TRACE_EVENTS - 1)];
+    e->ns = ns;
+    e->type = type;
+    e->arg = arg;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/*
+ * @brief trace_event(uint32_t type, uint32_t arg) records an event now
+ */
+static inline void trace_event(uint32_t type, uint32_t arg)
+{
+    struct timespec now;
+
+    if (traceRing == NULL) return;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    trace_at(type, arg, ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec);
+}
+
+/* arg for a nanosecond count, saturated */
+static inline uint32_t trace_ns(int64_t ns)
+{
+    return (ns < 0) ? 0 : (ns > UINT32_MAX) ? UINT32_MAX : (uint32_t) ns;
+}
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,88 @@
+/**
+ * @file tubefx.h
+ * @brief crossfades the tube digits, dims the tubes and refreshes unused cathodes with driver words
+ * sent in bursts
+ * @details Set from the "tubes" object of the system block of the LED config. Left out the clock
+ * thread loads and latches the tubes itself. With a fade or dimming the tubes belong to the tube
+ * thread, which switches them through PWM periods of TUBEFX_STEPS steps, about 1 kHz. Each period
+ * shows the new word for part of the lit steps, the old one for the rest and blank for the
+ * remainder. A burst of periods is rendered up front and sent in one multi transfer
+ * SPI_IOC_MESSAGE, where the transfer delays time the words, so the thread sleeps in the ioctl
+ * instead of waking for every word. LE is the chip select of the bursts (see SPI_CS_PIN), low while
+ * a word shifts in and pulsed high after it, so the tubes only ever show whole words. The clock
+ * hands over the frame of every second ahead of its boundary. The tube thread ends its bursts
+ * before the boundary, shifts in the first word of the next fade with LE low and raises LE on the
+ * boundary, as the clock does without it. A cathode left dark for hours while its neighbours glow
+ * gets coated and stops lighting evenly. Every "every" minutes or daily "at" a time, for "seconds",
+ * the clock asks for a refresh and the tube thread fills the gap between two flips with a
+ * precomputed sequence that lights every cathode in turn, leaving the time on the tubes for
+ * TUBEFX_REFRESH_HOLD_MS after each flip. With only a refresh the tube thread has nothing but those
+ * gaps, the clock still flips the tubes and shifts the next second in again once the refresh is
+ * done with the shift registers. How long each cathode has been lit is kept for the metrics.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __TUBEFX_H__
+#define __TUBEFX_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "nixieclock.h"
+#include "nixieframe.h"
+
+/* a PWM period is TUBEFX_STEPS steps of TUBEFX_STEP_US, a step is longer than a word takes to shift and latch */
+#define TUBEFX_STEP_US 50
+#define TUBEFX_STEPS 20
+#define TUBEFX_PERIOD_US (TUBEFX_STEP_US * TUBEFX_STEPS)
+/* a fade has to be over before the clock hands over the next second */
+#define TUBEFX_FADE_MAX 900
+/* words in one burst, a steady dimmed period takes two and a fading one up to three */
+#define TUBEFX_BURST 128
+/* frames the clock can hand over before the tube thread takes them, power of two */
+#define TUBEFX_QUEUE 8
+/* seconds still to come the tube thread holds on to */
+#define TUBEFX_PENDING 4
+/* refresh limits, its words show this long, the time shows this long after each flip */
+#define TUBEFX_EVERY_MAX (24 * 60)
+#define TUBEFX_REFRESH_MAX 3600
+#define TUBEFX_REFRESH_STEP_MS 20
+#define TUBEFX_REFRESH_HOLD_MS 200
+#define TUBEFX_OFF {.fade = 0, .brightness = 100, .refreshEvery = 0, .refreshAt = -1, .refreshSeconds = 0}
+
+/* one word of a PWM period and the steps it shows for */
+typedef struct {
+    uint64_t word;              /* driver word in shift out byte order */
+    uint32_t steps;
+} tubeword_t;
+
+typedef struct {
+    atomic_uint_fast64_t flips;     /* fades started on a second boundary */
+    atomic_int_fast64_t maxLate;    /* worst boundary to the first word of a flip, ns */
+    atomic_uint_fast64_t bursts;    /* SPI_IOC_MESSAGE calls */
+    atomic_uint_fast64_t words;     /* driver words sent */
+    atomic_uint_fast64_t dropped;   /* frames the queue or the pending seconds had no room for */
+    atomic_uint_fast64_t refreshes; /* cathode refreshes started */
+    atomic_uint_fast64_t cathode[NIXIE_TUBES][NIXIE_DIGITS];   /* ns each cathode has been lit */
+} tubefxstats_t;
+
+/* settings main took from the config */
+extern tubeconfig_t tubeconfig;
+extern tubefxstats_t tubefxstats;
+
+int tubefx_open(void);
+bool tubefx_enabled(void);
+bool tubefx_driving(void);
+bool tubefx_refreshing(time_t second);
+bool tubefx_refresh_due(int minute, int seconds);
+void tubefx_refresh(time_t until);
+void tubefx_load(uint64_t word, time_t second);
+void tubefx_account(uint64_t word, int64_t ns);
+uint32_t tubefx_period(uint64_t from, uint64_t to, uint32_t mix, uint32_t on, tubeword_t *out);
+void tubefx_close(void);
+void *tubefxTask(void *threadid);
+
+#endif /* __TUBEFX_H__ */
@@ -0,0 +1,59 @@
+/**
+ * @file tzcache.h
+ * @brief UTC to local time of day without calling localtime() every second
+ * @details The UTC offset is resolved once and stays valid until the next zone transition
+ * (or a recheck horizon), between those the time of day is integer arithmetic on tv_sec.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#ifndef __TZCACHE_H__
+#define __TZCACHE_H__
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define SECONDS_PER_DAY 86400L
+/* how far ahead to look for the next transition */
+#define TZCACHE_HORIZON (400L * SECONDS_PER_DAY)
+/* resolve again at least this often so a changed /etc/localtime is picked up */
+#define TZCACHE_RECHECK 3600L
+
+typedef struct {
+    time_t from;        /* first second the cached offset was resolved for */
+    time_t until;       /* cached offset is valid up to but not including this second */
+    time_t transition;  /* next change of UTC offset, or the end of the horizon */
+    long offset;        /* seconds east of UTC */
+    uint32_t resolves;  /* number of times the zone was resolved */
+} tzcache_t;
+
+void tzcache_resolve(tzcache_t *tz, time_t t);
+
+/*
+ * @brief tzcache_invalidate forces the next conversion to resolve, used when the clock is stepped
+ */
+static inline void tzcache_invalidate(tzcache_t *tz)
+{
+    tz->from = 1;
+    tz->until = 0;
+    tz->transition = 0;
+}
+
+/*
+ * @brief tzcache_hms local hours, minutes and seconds for UTC time t
+ */
+static inline void tzcache_hms(tzcache_t *tz, time_t t, int *hours, int *minutes, int *seconds)
+{
+    long sod;
+    if ((t < tz->from) || (t >= tz->until)) tzcache_resolve(tz, t);
+    sod = (long) ((t + tz->offset) % SECONDS_PER_DAY);
+    if (sod < 0) sod += SECONDS_PER_DAY;
+    *hours = sod / 3600;
+    *minutes = (sod / 60) % 60;
+    *seconds = sod % 60;
+}
+
+int tzcache_selftest(time_t start, int years);
+
+#endif /* __TZCACHE_H__ */
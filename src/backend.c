@@ -0,0 +1,46 @@
+/**
+ * @file backend.c
+ * @brief raspberry pi hardware backend
+ * @details spidev for the nixie shifters, /dev/gpiomem for LE and rpi_ws281x for the LEDs
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "gpiopi.h"
+#include "spipi.h"
+#include "backend.h"
+
+static void hw_gpio_function(void *map, uint8_t pin, uint32_t function)
+{
+    gpio_set_function_select(map, pin, function);
+}
+
+static void hw_gpio_set(void *map, uint8_t pin)
+{
+    gpio_set_output(map, pin);
+}
+
+static void hw_gpio_clear(void *map, uint8_t pin)
+{
+    gpio_clear_output(map, pin);
+}
+
+const backend_t backend_hw = {
+    .name = "hardware",
+    .spi_open = spi_open,
+    .spi_transfer = spi_transfer,
+    .spi_burst = spi_burst,
+    .gpio_open = gpio_open,
+    .gpio_function = hw_gpio_function,
+    .gpio_set = hw_gpio_set,
+    .gpio_clear = hw_gpio_clear,
+    .led_init = ws2811_init,
+    .led_render = ws2811_render,
+    .led_fini = ws2811_fini,
+    .led_error = ws2811_get_return_t_str,
+};
@@ -0,0 +1,1375 @@
+/*
+ * @file bench.c
+ * @brief latency and cost benchmark for the nixie and LED hot paths on the simulated backend
+ * @details builds with make bench on any linux box, no raspberry pi hardware is touched
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <byteswap.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+#include "nixieclock.h"
+#include "nixieframe.h"
+#include "tzcache.h"
+#include "backend.h"
+#include "timeline.h"
+#include "interpolate.h"
+#include "framesched.h"
+#include "rollfile.h"
+#include "livefeed.h"
+#include "dmxfeed.h"
+#include "metrics.h"
+#include "realtime.h"
+#include "input.h"
+#include "idle.h"
+#include "trace.h"
+#include "reactor.h"
+#include "tubefx.h"
+
+#define BENCH_SECONDS 5
+#define ENCODE_LOOPS 2000000
+#define FRAME_LOOPS 20000
+#define BENCH_PIXELS 1024
+#define REFRESH_FRAMES 40
+#define FADE_MS 2000
+/* milliseconds per step of a fade at the default frame rate */
+#define BENCH_STEP (1000 / LEDFPS)
+/* records in the generated roll the config loader is timed on */
+#define CONFIG_RECORDS 100000
+#define CONFIG_LOOPS 5
+/* live frames sent one at a time for the latency, then back to back for the burst */
+#define FEED_FRAMES 2000
+#define FEED_BURST 64
+/* synchronized DMX frames per protocol, a strip that fits in two universes */
+#define DMX_FRAMES 100
+#define DMX_PIXELS 256
+#define DMX_GAP_US 10000
+#define METRIC_LOOPS 10000000
+#define TRACE_LOOPS 10000000
+#define INPUT_PRESSES 200
+/* presses and releases are this far apart, past the debounce time with room for a late wakeup */
+#define INPUT_GAP_MS (INPUT_DEBOUNCE_MS + 10)
+/* the held press is long enough for the long press event and this many repeats */
+#define INPUT_REPEATS 3
+/* the idle run parks a second after the sensor goes low, then stays parked this long */
+#define IDLE_PARKED_SECONDS 2
+/* the clock's SCHED_FIFO priority in the loaded tick run */
+#define BENCH_RT_PRIORITY 80
+/* tube effects of the tube run, the lit share is measured once the fade is over */
+#define TUBE_FADE_MS 300
+#define TUBE_BRIGHTNESS 60
+/* seconds of cathode refresh in the refresh run */
+#define CATHODE_SECONDS 3
+
+/* globals main.c would provide */
+terminate_t terminate = {.kill = false, .fd = -1};
+bool nixieTest = false;
+const backend_t *backend = &backend_sim;
+
+extern ws2811_t ledmodule;
+
+static inline int64_t nsnow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+static int cmp64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *) a;
+    int64_t y = *(const int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/* the string encoder setNixie() used before the frame table, kept as the reference */
+static uint64_t legacyEncode(bool colon, const char *str)
+{
+    uint64_t ll = 0;
+    int i;
+    if (colon) ll |= 3;
+    for (i = 5; i >= 3; i--) {
+        ll <<= 10;
+        if ((str[i] >= '0') && (str[i] <= '9')) ll |= (1 << (str[i] - '0'));
+    }
+    ll <<= 2;
+    if (colon) ll |= 3;
+    for (i = 2; i >= 0; i--) {
+        ll <<= 10;
+        if ((str[i] >= '0') && (str[i] <= '9')) ll |= (1 << (str[i] - '0'));
+    }
+    return bswap_64(ll);
+}
+
+static int benchEncode(void)
+{
+    nixieframe_t frame;
+    tzcache_t tz = {0};
+    struct tm tm;
+    char str[8];
+    time_t t = time(NULL);
+    volatile uint64_t sink = 0;
+    int64_t start, legacy, table;
+    int h, m, s;
+    int errors = 0;
+
+    nixie_frame_init(&frame);
+    tzcache_invalidate(&tz);
+    for (int i = 0; i < 86400; i++) {
+        tzcache_hms(&tz, t + i, &h, &m, &s);
+        nixie_frame_set_hms(&frame, h, m, s, i & 1);
+        localtime_r(&(time_t){t + i}, &tm);
+        strftime(str, sizeof(str), "%H%M%S", &tm);
+        if (frame.word.ll != legacyEncode(i & 1, str)) errors++;
+    }
+    start = nsnow();
+    for (int i = 0; i < ENCODE_LOOPS; i++) {
+        time_t u = t + i;
+        localtime_r(&u, &tm);
+        strftime(str, sizeof(str), "%H%M%S", &tm);
+        sink += legacyEncode(i & 1, str);
+    }
+    legacy = nsnow() - start;
+    start = nsnow();
+    for (int i = 0; i < ENCODE_LOOPS; i++) {
+        tzcache_hms(&tz, t + i, &h, &m, &s);
+        nixie_frame_set_hms(&frame, h, m, s, i & 1);
+        sink += frame.word.ll;
+    }
+    table = nsnow() - start;
+    fprintf(stdout, "nixie encode   localtime+strftime+shift %7.1f ns/frame, tzcache+table %7.1f ns/frame, %d mismatches\n",
+        (double) legacy / ENCODE_LOOPS, (double) table / ENCODE_LOOPS, errors);
+    return errors;
+}
+
+static void benchFrames(void)
+{
+    uint32_t *from = malloc(BENCH_PIXELS * sizeof(uint32_t));
+    uint32_t *to = malloc(BENCH_PIXELS * sizeof(uint32_t));
+    uint32_t *out = malloc(BENCH_PIXELS * sizeof(uint32_t));
+    int64_t start, build;
+    int max = 3000 / BENCH_STEP;
+
+    for (int i = 0; i < BENCH_PIXELS; i++) {
+        from[i] = (uint32_t) rand() & 0xFFFFFF;
+        to[i] = (uint32_t) rand() & 0xFFFFFF;
+    }
+    start = nsnow();
+    for (int i = 0; i < FRAME_LOOPS; i++) {
+        for (int j = 0; j < BENCH_PIXELS; j++) out[j] = interpolateRGB(from[j], to[j], i % max, max);
+    }
+    build = nsnow() - start;
+    fprintf(stdout, "LED frame      interpolateRGB %7.1f ns/frame (%5.2f ns/pixel) at %d pixels\n",
+        (double) build / FRAME_LOOPS, (double) build / FRAME_LOOPS / BENCH_PIXELS, BENCH_PIXELS);
+    free(from);
+    free(to);
+    free(out);
+}
+
+/*
+ * back to back renders of BENCH_PIXELS on one channel, then split over both channels, the
+ * simulated backend holds each render for the wire time of the longest channel like the DMA does
+ */
+static void benchRefresh(void)
+{
+    for (int channels = 1; channels <= LEDCHANNELS; channels++) {
+        ws2811_t module = ledmodule;
+        int64_t start, elapsed;
+        for (int c = 0; c < RPI_PWM_CHANNELS; c++) {
+            module.channel[c].gpionum = (c < channels) ? ((c == 0) ? PWM1 : 13) : 0;
+            module.channel[c].count = (c < channels) ? BENCH_PIXELS / channels : 0;
+            module.channel[c].brightness = 255;
+            module.channel[c].strip_type = SK6812_STRIP;
+        }
+        backend->led_init(&module);
+        backend->led_render(&module);
+        start = nsnow();
+        for (int i = 0; i < REFRESH_FRAMES; i++) {
+            for (int c = 0; c < channels; c++) memset(module.channel[c].leds, i, module.channel[c].count * sizeof(ws2811_led_t));
+            backend->led_render(&module);
+        }
+        elapsed = nsnow() - start;
+        backend->led_fini(&module);
+        fprintf(stdout, "LED refresh    %d channel%s %6.1f frames/s %6.1f kpixel/s at %d pixels\n", channels,
+            (channels > 1) ? "s" : " ", (REFRESH_FRAMES * 1e9) / elapsed,
+            ((double) BENCH_PIXELS * REFRESH_FRAMES * 1000000.0) / elapsed, BENCH_PIXELS);
+    }
+}
+
+/*
+ * a fade of 25ms steps paced the old way, render then sleep a step, against the frame scheduler,
+ * for a strip that can be sent within a step and one that can not
+ */
+static void benchSched(void)
+{
+    static const int pixels[] = {256, 1024};
+    const int64_t step = BENCH_STEP * 1000000LL;
+    const int64_t end = FADE_MS * 1000000LL;
+    struct timespec stepDelay = {.tv_sec = 0, .tv_nsec = step};
+    framesched_t fs;
+
+    for (int k = 0; k < sizeof(pixels) / sizeof(pixels[0]); k++) {
+        ws2811_t module = ledmodule;
+        int64_t start, relative, now;
+        module.channel[0].gpionum = PWM1;
+        module.channel[0].count = pixels[k];
+        module.channel[0].strip_type = SK6812_STRIP;
+        module.channel[1].count = 0;
+        backend->led_init(&module);
+        framesched_open(&fs, -1);
+        start = nsnow();
+        for (int64_t at = 0; at < end; at += step) {
+            backend->led_render(&module);
+            nanosleep(&stepDelay, NULL);
+        }
+        relative = nsnow() - start;
+        framesched_start(&fs);
+        for (int64_t at = 0; at < end; at += step) {
+            now = framesched_wait(&fs, at);
+            while (at + step <= now) {
+                framesched_drop(&fs);
+                at += step;
+            }
+            backend->led_render(&module);
+        }
+        /* the start of whatever record follows the fade */
+        framesched_wait(&fs, end);
+        framesched_close(&fs);
+        backend->led_fini(&module);
+        fprintf(stdout, "LED pacing     %4d pixels %d ms fade, sleep per step took %5.1f ms, scheduled took %5.1f ms with %llu dropped %llu late\n",
+            pixels[k], FADE_MS, (double) relative / 1e6, (double) (end + fs.late) / 1e6,
+            (unsigned long long) fs.dropped, (unsigned long long) fs.lateFrames);
+    }
+}
+
+/* every frame kernel against interpolateRGB, then pixels per second on a BENCH_PIXELS frame */
+static int benchKernels(void)
+{
+    static const int wide[] = {1000, 4095, 4096, 4097, 12000, INTERPOLATE_VECTOR_MAX, INTERPOLATE_VECTOR_MAX + 1, 100000};
+    const interpolatekernel_t *kernel;
+    int kernels = interpolate_kernels(&kernel);
+    uint32_t *from = malloc(BENCH_PIXELS * sizeof(uint32_t));
+    uint32_t *to = malloc(BENCH_PIXELS * sizeof(uint32_t));
+    uint32_t *out = malloc(BENCH_PIXELS * sizeof(uint32_t));
+    interpolateweight_t w;
+    int max = 3000 / BENCH_STEP;
+    int64_t start, elapsed;
+    int total = 0;
+
+    /* full 32 bit values, the top byte must be ignored */
+    for (int i = 0; i < BENCH_PIXELS; i++) {
+        from[i] = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+        to[i] = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    }
+    from[0] = 0x00FFFFFF;
+    to[1] = 0xFFFFFFFF;
+    for (int k = 0; k < kernels; k++) {
+        int errors = 0;
+        for (int m = 1; m <= 512 + (int) (sizeof(wide) / sizeof(wide[0])); m++) {
+            int steps = (m <= 512) ? m : wide[m - 513];
+            int stride = (steps <= 512) ? 1 : (steps / 97) + 1;
+            for (int pos = 0; pos < steps; pos += stride) {
+                /* odd counts so the scalar tail after the vector loop is checked too */
+                uint32_t count = 61 + (pos & 7);
+                interpolate_weight(&w, pos, steps);
+                kernel[k].blend(out, from, to, count, &w);
+                for (uint32_t j = 0; j < count; j++) {
+                    if (out[j] != (uint32_t) interpolateRGB(from[j], to[j], pos, steps)) errors++;
+                }
+            }
+        }
+        start = nsnow();
+        for (int i = 0; i < FRAME_LOOPS; i++) {
+            interpolate_weight(&w, i % max, max);
+            kernel[k].blend(out, from, to, BENCH_PIXELS, &w);
+        }
+        elapsed = nsnow() - start;
+        fprintf(stdout, "LED kernel     %-6s %8.1f ns/frame %8.1f Mpixel/s, %d mismatches%s\n", kernel[k].name,
+            (double) elapsed / FRAME_LOOPS, ((double) BENCH_PIXELS * FRAME_LOOPS * 1000.0) / elapsed, errors,
+            (k == kernels - 1) ? " (selected)" : "");
+        total += errors;
+    }
+    free(from);
+    free(to);
+    free(out);
+    return total;
+}
+
+/* one pass of a two fade roll, interpolated per step against copied from the compiled timeline */
+static int benchTimeline(void)
+{
+    ledroll_t roll[2] = {{.delay = 3000, .steps = 3000 / BENCH_STEP, .isFast = false},
+        {.delay = 3000, .steps = 3000 / BENCH_STEP, .isFast = false}};
+    ledrollhead_t head = {.count = 2, .colon = COLON_ON, .timelineLimit = 0, .roll = roll,
+        .geometry = {.width = LEDWIDTH, .height = LEDHEIGHT, .count = LEDWIDTH * LEDHEIGHT,
+            .stride = LEDFRAME_STRIDE(LEDWIDTH * LEDHEIGHT), .layout = LAYOUT_ROWS}};
+    uint32_t leds = head.geometry.count;
+    ledtimeline_t *tl;
+    uint32_t *out = malloc(leds * sizeof(uint32_t));
+    volatile uint32_t sink = 0;
+    int64_t start, compile, interpolate, copy;
+    uint32_t index;
+    int errors = 0;
+
+    head.pixels = aligned_alloc(LEDFRAME_ALIGN, 2 * head.geometry.stride * sizeof(uint32_t));
+    memset(head.pixels, 0, 2 * head.geometry.stride * sizeof(uint32_t));
+    for (uint32_t i = 0; i < leds; i++) {
+        ledroll_color(&head, 0)[i] = (uint32_t) rand() & 0xFFFFFF;
+        ledroll_color(&head, 1)[i] = (uint32_t) rand() & 0xFFFFFF;
+    }
+    start = nsnow();
+    tl = timeline_compile(&head, SIZE_MAX);
+    compile = nsnow() - start;
+    if (tl == NULL) {
+        fprintf(stdout, "LED timeline   failed to compile\n");
+        free(head.pixels);
+        free(out);
+        return 1;
+    }
+    start = nsnow();
+    for (int n = 0; n < FRAME_LOOPS; n++) {
+        for (int r = 0; r < 2; r++) {
+            int max = roll[r].steps;
+            for (int i = 0; i < max; i++) {
+                for (uint32_t j = 0; j < leds; j++) {
+                    out[j] = interpolateRGB(ledroll_color(&head, r)[j], ledroll_color(&head, r ^ 1)[j], i, max);
+                }
+                sink += out[i % leds];
+            }
+        }
+    }
+    interpolate = nsnow() - start;
+    start = nsnow();
+    for (int n = 0; n < FRAME_LOOPS; n++) {
+        for (uint32_t i = 0; i < tl->count; i++) {
+            memcpy(out, timeline_frame(tl, i), leds * sizeof(uint32_t));
+            sink += out[i % leds];
+        }
+    }
+    copy = nsnow() - start;
+    index = 0;
+    for (int r = 0; r < 2; r++) {
+        int max = roll[r].steps;
+        for (int i = 0; i < max; i++, index++) {
+            for (uint32_t j = 0; j < leds; j++) {
+                uint32_t expect = interpolateRGB(ledroll_color(&head, r)[j], ledroll_color(&head, r ^ 1)[j], i, max);
+                if (timeline_frame(tl, index)[j] != expect) errors++;
+            }
+        }
+    }
+    fprintf(stdout, "LED timeline   %u frames %zu bytes compiled in %.1f us, interpolate %6.1f ns/frame, copy %6.1f ns/frame, %d mismatches\n",
+        tl->count, timeline_size(&head), (double) compile / 1000,
+        (double) interpolate / FRAME_LOOPS / tl->count, (double) copy / FRAME_LOOPS / tl->count, errors);
+    timeline_free(tl);
+    free(head.pixels);
+    free(out);
+    return errors;
+}
+
+/*
+ * writes a CONFIG_RECORDS roll for the default strip, alternating fast and slow records of
+ * changing colors, and times parseconfigfile() on it against loading it compiled to a .pxr
+ */
+static int benchConfig(void)
+{
+    static char path[] = "/tmp/pixie-benchXXXXXX";
+    static char compiled[sizeof(path) + sizeof(ROLLFILE_EXTENSION)];
+    int fd = mkstemp(path);
+    FILE *f;
+    ledrollhead_t *head, *json = NULL;
+    long size;
+    int64_t start, best = INT64_MAX, bestCompiled = INT64_MAX;
+    int errors = 0;
+
+    if ((fd < 0) || ((f = fdopen(fd, "w")) == NULL)) {
+        fprintf(stdout, "config load    unable to create %s\n", path);
+        return 1;
+    }
+    fprintf(f, "{\n  \"system\" : { \"level\" : 100, \"colon\" : \"blink\" },\n  \"roll\" : [\n");
+    for (int i = 0; i < CONFIG_RECORDS; i++) {
+        fprintf(f, "    { \"step\" : \"%s\", \"delay\" : %d, \"color\" : [", (i & 1) ? "slow" : "fast", 50 + (i % 4) * 25);
+        for (int k = 0; k < LEDWIDTH * LEDHEIGHT; k++) {
+            fprintf(f, "%s\"#%06X\"", (k == 0) ? "" : ",", (unsigned) ((i * 2654435761u + k) & 0xFFFFFF));
+        }
+        fprintf(f, "] }%s\n", (i == CONFIG_RECORDS - 1) ? "" : ",");
+    }
+    fprintf(f, "  ]\n}\n");
+    size = ftell(f);
+    fclose(f);
+    for (int n = 0; n < CONFIG_LOOPS; n++) {
+        start = nsnow();
+        head = parseconfigfile(path);
+        start = nsnow() - start;
+        if (start < best) best = start;
+        if (head == NULL) {
+            errors++;
+            break;
+        }
+        for (int i = 0; i < head->count; i += 997) {
+            uint32_t expect = (i * 2654435761u + 3) & 0xFFFFFF;
+            if (ledroll_color(head, i)[3] != expect) errors++;
+        }
+        if (head->count != CONFIG_RECORDS) errors++;
+        freeconfig(json);
+        json = head;
+    }
+    unlink(path);
+    fprintf(stdout, "config load    %d records %.1f MB in %.1f ms (%.0f MB/s), %d mismatches\n",
+        CONFIG_RECORDS, (double) size / 1e6, (double) best / 1e6, ((double) size / 1e6) / ((double) best / 1e9), errors);
+    if (json == NULL) return errors;
+    snprintf(compiled, sizeof(compiled), "%s%s", path, ROLLFILE_EXTENSION);
+    if (rollfile_write(json, compiled) < 0) {
+        freeconfig(json);
+        return errors + 1;
+    }
+    size = 0;
+    for (int n = 0; n < CONFIG_LOOPS; n++) {
+        start = nsnow();
+        head = rollfile_load(compiled);
+        start = nsnow() - start;
+        if (start < bestCompiled) bestCompiled = start;
+        if (head == NULL) {
+            errors++;
+            break;
+        }
+        size = head->mapSize;
+        if (head->count != json->count || memcmp(head->roll, json->roll, json->count * sizeof(ledroll_t)) != 0
+            || memcmp(head->pixels, json->pixels, (size_t) json->count * json->geometry.stride * sizeof(uint32_t)) != 0) {
+            errors++;
+        }
+        freeconfig(head);
+    }
+    unlink(compiled);
+    freeconfig(json);
+    fprintf(stdout, "config load    same roll compiled %.1f MB in %.1f ms, %.0fx faster, %d mismatches\n",
+        (double) size / 1e6, (double) bestCompiled / 1e6, (double) best / bestCompiled, errors);
+    return errors;
+}
+
+/*
+ * @brief feedSend sends one BENCH_PIXELS frame with every LED set to value, to show at present
+ */
+static int feedSend(int fd, uint8_t *message, uint32_t sequence, uint32_t value, int64_t present)
+{
+    livefeedheader_t h = {.magic = LIVEFEED_MAGIC, .version = LIVEFEED_VERSION, .format = LIVEFEED_RGB,
+        .flags = LIVEFEED_END, .sequence = sequence, .start = 0, .count = BENCH_PIXELS, .present = present};
+    uint8_t *p = message + sizeof(h);
+
+    memcpy(message, &h, sizeof(h));
+    for (int i = 0; i < BENCH_PIXELS; i++, p += 3) {
+        p[0] = value >> 16;
+        p[1] = value >> 8;
+        p[2] = value;
+    }
+    return (send(fd, message, sizeof(h) + (BENCH_PIXELS * 3), 0) < 0) ? -1 : 0;
+}
+
+/*
+ * @brief feedTake waits up to a second for a frame to be published and takes it
+ * @return true if a frame was taken, frame is NULL if it was too late
+ */
+static bool feedTake(struct pollfd *wake, const uint32_t **frame, int64_t *present)
+{
+    uint64_t drain;
+
+    for (int i = 0; i < 100; i++) {
+        if (livefeed_take(nsnow(), frame, present)) return true;
+        while ((poll(wake, 1, 10) < 0) && (errno == EINTR));
+        if (read(wake->fd, &drain, sizeof(drain)) < 0) drain = 0;
+    }
+    return false;
+}
+
+/*
+ * runs the live feed thread on a temporary socket, times a frame from send() to the render loop
+ * taking it, then sends a burst without taking any and checks only the newest one comes out.
+ * Last a frame held for the future is followed by a late one, which must hand the held one back.
+ */
+static int benchFeed(void)
+{
+    char path[64];
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    ledgeometry_t geometry = {.width = 32, .height = BENCH_PIXELS / 32, .count = BENCH_PIXELS,
+        .stride = LEDFRAME_STRIDE(BENCH_PIXELS), .layout = LAYOUT_ROWS};
+    uint8_t *message = malloc(sizeof(livefeedheader_t) + (BENCH_PIXELS * 3));
+    int64_t *latency = malloc(FEED_FRAMES * sizeof(int64_t));
+    struct pollfd wake;
+    const uint32_t *frame = NULL;
+    const uint32_t *held = NULL;
+    pthread_t thread;
+    int64_t present, sent;
+    uint64_t late, published;
+    uint32_t sequence = 0;
+    int errors = 0;
+    int count = 0;
+    int fd = -1;
+
+    snprintf(path, sizeof(path), "/tmp/pixie-bench-%d.sock", (int) getpid());
+    livefeedPath = path;
+    terminate.kill = false;
+    terminate.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (livefeed_open() < 0) return 1;
+    wake.fd = livefeed_fd();
+    wake.events = POLLIN;
+    pthread_create(&thread, NULL, livefeedTask, NULL);
+    livefeed_ready(&geometry);
+    strcpy(addr.sun_path, path);
+    for (int i = 0; i < 100; i++) {
+        fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) break;
+        close(fd);
+        fd = -1;
+        usleep(10000);
+    }
+    if (fd < 0) {
+        fprintf(stdout, "live feed      unable to connect to %s\n", path);
+        errors++;
+        goto done;
+    }
+    for (int i = 0; i < FEED_FRAMES; i++) {
+        uint64_t drain;
+        sent = nsnow();
+        if (feedSend(fd, message, ++sequence, i, 0) < 0) break;
+        do {
+            while ((poll(&wake, 1, 1000) < 0) && (errno == EINTR));
+            if (read(wake.fd, &drain, sizeof(drain)) < 0) drain = 0;
+        } while (!livefeed_take(nsnow(), &frame, &present) || (frame == NULL));
+        latency[count++] = nsnow() - sent;
+        if ((frame[0] != (uint32_t) i) || (frame[BENCH_PIXELS - 1] != (uint32_t) i)) errors++;
+    }
+    for (int i = 0; i < FEED_BURST; i++) {
+        if (feedSend(fd, message, ++sequence, 0x100000 + i, 0) < 0) break;
+    }
+    /* a stale sequence number is ignored */
+    feedSend(fd, message, 1, 0, 0);
+    for (int i = 0; (i < 100) && (atomic_load(&livefeedstats.stale) == 0); i++) usleep(1000);
+    /* the batch the stale message came in is published after it was counted */
+    for (int i = 0; i < 100; i++) {
+        if (livefeed_take(nsnow(), &frame, &present) && (frame != NULL) && (frame[0] == 0x100000 + FEED_BURST - 1)) break;
+        usleep(1000);
+    }
+    if ((frame == NULL) || (frame[0] != 0x100000 + FEED_BURST - 1)) errors++;
+    /* the render loop holds a frame due in a second when one already past LIVEFEED_LATE arrives */
+    feedSend(fd, message, ++sequence, 0x200000, nsnow() + 1000000000LL);
+    if (!feedTake(&wake, &held, &present) || (held == NULL) || (held[0] != 0x200000)) errors++;
+    late = atomic_load(&livefeedstats.late);
+    feedSend(fd, message, ++sequence, 0x200001, nsnow() - (2 * LIVEFEED_LATE));
+    if (!feedTake(&wake, &frame, &present) || (frame != NULL) || (atomic_load(&livefeedstats.late) != late + 1)) errors++;
+    /* two more frames, sent apart so neither supersedes the other, and the held one is written over */
+    for (uint32_t value = 0x200002; value <= 0x200003; value++) {
+        published = atomic_load(&livefeedstats.frames);
+        feedSend(fd, message, ++sequence, value, 0);
+        for (int i = 0; (i < 100) && (atomic_load(&livefeedstats.frames) == published); i++) usleep(1000);
+    }
+    if ((held == NULL) || (held[0] != 0x200003)) errors++;
+    close(fd);
+    qsort(latency, count, sizeof(int64_t), cmp64);
+    fprintf(stdout, "live feed      %d frames of %d pixels, send to take p50 %.1f us p99 %.1f us max %.1f us\n",
+        count, BENCH_PIXELS, (double) latency[count / 2] / 1000, (double) latency[(count * 99) / 100] / 1000,
+        (double) latency[count - 1] / 1000);
+    fprintf(stdout, "live feed      burst of %d, %llu superseded %llu stale %llu late, %d mismatches\n", FEED_BURST,
+        (unsigned long long) livefeedstats.superseded, (unsigned long long) livefeedstats.stale,
+        (unsigned long long) livefeedstats.late, errors);
+done:
+    notifyToTerminate();
+    pthread_join(thread, NULL);
+    livefeed_close();
+    close(terminate.fd);
+    terminate.fd = -1;
+    terminate.kill = false;
+    livefeedPath = NULL;
+    free(latency);
+    free(message);
+    return errors;
+}
+
+/*
+ * runs the live feed thread with DMX input and sends it synchronized E1.31 and Art-Net frames over
+ * loopback, timing the first packet of a frame to the simulated render of it returning
+ */
+static int benchDmx(void)
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    ledgeometry_t geometry = {.width = 16, .height = DMX_PIXELS / 16, .count = DMX_PIXELS,
+        .stride = LEDFRAME_STRIDE(DMX_PIXELS), .layout = LAYOUT_ROWS};
+    int universes = (DMX_PIXELS + DMXFEED_LEDS - 1) / DMXFEED_LEDS;
+    uint8_t *channels = calloc(universes, DMXFEED_CHANNELS);
+    int64_t *latency = malloc(DMX_FRAMES * sizeof(int64_t));
+    ws2811_t module = ledmodule;
+    uint8_t packet[DMXFEED_PACKET];
+    struct pollfd wake;
+    const uint32_t *frame;
+    pthread_t thread;
+    int64_t present, sent;
+    uint64_t messages = atomic_load(&livefeedstats.messages);
+    uint64_t rejected = atomic_load(&livefeedstats.rejected);
+    uint64_t stale = atomic_load(&livefeedstats.stale);
+    int errors = 0;
+    int fd;
+
+    module.channel[0].gpionum = PWM1;
+    module.channel[0].count = DMX_PIXELS;
+    module.channel[0].strip_type = SK6812_STRIP;
+    module.channel[1].count = 0;
+    backend->led_init(&module);
+    dmxUniverse = 1;
+    terminate.kill = false;
+    terminate.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    livefeed_open();
+    wake.fd = livefeed_fd();
+    wake.events = POLLIN;
+    pthread_create(&thread, NULL, livefeedTask, NULL);
+    livefeed_ready(&geometry);
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    for (int artnet = 0; artnet < 2; artnet++) {
+        int count = 0;
+        addr.sin_port = htons(artnet ? DMXFEED_ARTNET_PORT : DMXFEED_E131_PORT);
+        for (int i = 0; i < DMX_FRAMES; i++) {
+            uint64_t drain;
+            size_t size;
+            uint8_t sequence = (i % 255) + 1;
+            memset(channels, i, universes * DMXFEED_CHANNELS);
+            usleep(DMX_GAP_US);
+            if (read(wake.fd, &drain, sizeof(drain)) < 0) drain = 0;
+            sent = nsnow();
+            for (int u = 0; u < universes; u++) {
+                int length = ((u == universes - 1) ? DMX_PIXELS - (u * DMXFEED_LEDS) : DMXFEED_LEDS) * 3;
+                if (artnet) {
+                    size = dmxfeed_artnet(packet, u + 1, sequence, &channels[u * DMXFEED_CHANNELS], length);
+                } else {
+                    size = dmxfeed_e131(packet, u + 1, sequence, 1, &channels[u * DMXFEED_CHANNELS], length);
+                }
+                sendto(fd, packet, size, 0, (struct sockaddr *) &addr, sizeof(addr));
+            }
+            size = artnet ? dmxfeed_artsync(packet) : dmxfeed_e131sync(packet, 1, sequence);
+            sendto(fd, packet, size, 0, (struct sockaddr *) &addr, sizeof(addr));
+            frame = NULL;
+            while ((frame == NULL) && (poll(&wake, 1, 1000) > 0)) {
+                if (read(wake.fd, &drain, sizeof(drain)) < 0) drain = 0;
+                livefeed_take(nsnow(), &frame, &present);
+            }
+            if (frame == NULL) break;
+            memcpy(module.channel[0].leds, frame, DMX_PIXELS * sizeof(ws2811_led_t));
+            backend->led_render(&module);
+            latency[count++] = nsnow() - sent;
+            /* every universe of the frame arrived together */
+            if ((frame[0] != (uint32_t) (i & 0xff) * 0x010101) || (frame[DMX_PIXELS - 1] != frame[0])) errors++;
+        }
+        if (count == 0) {
+            fprintf(stdout, "DMX input      %s no frames received, is a DMX receiver already running?\n",
+                artnet ? "Art-Net" : "E1.31  ");
+            continue;
+        }
+        qsort(latency, count, sizeof(int64_t), cmp64);
+        fprintf(stdout, "DMX input      %s %d synchronized frames of %d universes, packet to render p50 %.1f us p99 %.1f us max %.1f us\n",
+            artnet ? "Art-Net" : "E1.31  ", count, universes, (double) latency[count / 2] / 1000,
+            (double) latency[(count * 99) / 100] / 1000, (double) latency[count - 1] / 1000);
+    }
+    fprintf(stdout, "DMX input      %llu packets, %llu rejected %llu out of order, %d mismatches\n",
+        (unsigned long long) (livefeedstats.messages - messages), (unsigned long long) (livefeedstats.rejected - rejected),
+        (unsigned long long) (livefeedstats.stale - stale), errors);
+    close(fd);
+    notifyToTerminate();
+    pthread_join(thread, NULL);
+    livefeed_close();
+    close(terminate.fd);
+    terminate.fd = -1;
+    terminate.kill = false;
+    dmxUniverse = 0;
+    backend->led_fini(&module);
+    free(latency);
+    free(channels);
+    return errors;
+}
+
+/*
+ * @brief inputNext waits up to a second for the next event queued for the display
+ * @return true with the event and the time it was taken
+ */
+static bool inputNext(inputevent_t *event, int64_t *taken)
+{
+    struct pollfd wake = {.fd = input_fd(INPUT_DISPLAY), .events = POLLIN};
+    uint64_t count;
+
+    while (!input_take(INPUT_DISPLAY, event)) {
+        if (poll(&wake, 1, 1000) <= 0) return false;
+        if (read(wake.fd, &count, sizeof(count)) < 0) count = 0;
+    }
+    *taken = nsnow();
+    return true;
+}
+
+/*
+ * the input thread on simulated lines, how long a press takes from its edge to a consumer, then
+ * a press that bounces and is held for the long press and repeats
+ */
+static int benchInput(void)
+{
+    pthread_t thread;
+    inputevent_t event;
+    int64_t *latency = malloc(INPUT_PRESSES * sizeof(int64_t));
+    int64_t edge, taken;
+    int counts[INPUT_LOW + 1] = {0};
+    int errors = 0;
+    int presses = 0;
+
+    terminate.kill = false;
+    terminate.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (input_open() < 0) {
+        fprintf(stdout, "input          unable to open the simulated lines\n");
+        free(latency);
+        return 1;
+    }
+    pthread_create(&thread, NULL, inputTask, NULL);
+    for (int i = 0; i < INPUT_PRESSES; i++) {
+        edge = nsnow();
+        input_sim_edge(MODE, false, edge);
+        if (!inputNext(&event, &taken) || (event.line != INPUT_MODE) || (event.type != INPUT_PRESS) || (event.ns != edge)) {
+            errors++;
+            continue;
+        }
+        latency[presses++] = taken - edge;
+        usleep(INPUT_GAP_MS * 1000);
+        input_sim_edge(MODE, true, nsnow());
+        if (!inputNext(&event, &taken) || (event.type != INPUT_RELEASE)) errors++;
+        usleep(INPUT_GAP_MS * 1000);
+    }
+    /* contact bounce on the way down and up, one press and one release should come of it */
+    edge = nsnow();
+    for (int i = 0; i < 5; i++) {
+        input_sim_edge(UP, (i & 1), edge + (i * 300000LL));
+    }
+    usleep((INPUT_LONG_MS + (INPUT_REPEATS * INPUT_REPEAT_MS) + (INPUT_REPEAT_MS / 2)) * 1000);
+    edge = nsnow();
+    for (int i = 0; i < 5; i++) {
+        input_sim_edge(UP, !(i & 1), edge + (i * 300000LL));
+    }
+    while (inputNext(&event, &taken) && (event.type != INPUT_RELEASE)) counts[event.type]++;
+    counts[event.type]++;
+    /* nothing more once it has settled */
+    usleep((INPUT_DEBOUNCE_MS * 2) * 1000);
+    if (input_take(INPUT_DISPLAY, &event)) errors++;
+    if ((counts[INPUT_PRESS] != 1) || (counts[INPUT_LONG] != 1) || (counts[INPUT_REPEAT] != INPUT_REPEATS)
+        || (counts[INPUT_RELEASE] != 1)) {
+        errors++;
+    }
+    notifyToTerminate();
+    pthread_join(thread, NULL);
+    input_close();
+    close(terminate.fd);
+    terminate.fd = -1;
+    terminate.kill = false;
+    if (presses > 0) {
+        qsort(latency, presses, sizeof(int64_t), cmp64);
+        fprintf(stdout, "input          %d presses, edge to consumer p50 %.1f us p99 %.1f us max %.1f us\n", presses,
+            (double) latency[presses / 2] / 1000, (double) latency[(presses * 99) / 100] / 1000,
+            (double) latency[presses - 1] / 1000);
+    }
+    fprintf(stdout, "input          bouncing hold %d press %d long %d repeats %d release, %llu bounces, %d errors\n",
+        counts[INPUT_PRESS], counts[INPUT_LONG], counts[INPUT_REPEAT], counts[INPUT_RELEASE],
+        (unsigned long long) inputstats.bounces, errors);
+    free(latency);
+    return errors;
+}
+
+/*
+ * @brief simAfter finds the first simulated event of type on pin (any pin for -1) at or after ns
+ * @return its CLOCK_REALTIME nanoseconds, 0 if there is none yet
+ */
+static int64_t simAfter(uint32_t type, int pin, int64_t ns)
+{
+    uint64_t head = atomic_load(&simlog.head);
+    for (uint64_t i = (head > SIM_EVENTS) ? head - SIM_EVENTS : 0; i < head; i++) {
+        simevent_t *e = &simlog.event[i & (SIM_EVENTS - 1)];
+        if ((e->type == type) && ((pin < 0) || (e->arg == pin)) && (e->ns >= ns)) return e->ns;
+    }
+    return 0;
+}
+
+/*
+ * runs the clock, the LEDs and the buttons with idle after a second without presence. Once the
+ * sensor goes low both should park and leave the simulated SPI, LE and strips alone until it goes
+ * high again, measured from that edge to LE showing the time and to the first LED frame.
+ */
+static int benchIdle(void)
+{
+    static char path[] = "/tmp/pixie-idleXXXXXX";
+    int fd = mkstemp(path);
+    pthread_t clock, led, input;
+    ledrollhead_t *head;
+    struct timespec edge;
+    uint64_t parked, events;
+    int64_t at, tubes = 0, leds = 0;
+    int errors = 0;
+    FILE *f;
+
+    if ((fd < 0) || ((f = fdopen(fd, "w")) == NULL)) {
+        fprintf(stdout, "idle           unable to create %s\n", path);
+        return 1;
+    }
+    fprintf(f, "{\n  \"system\" : { \"idle\" : { \"presence\" : 1 } },\n  \"roll\" : [\n");
+    for (int i = 0; i < 2; i++) {
+        fprintf(f, "    { \"step\" : \"slow\", \"delay\" : 500, \"color\" : [");
+        for (int k = 0; k < LEDWIDTH * LEDHEIGHT; k++) fprintf(f, "%s\"#%06X\"", (k == 0) ? "" : ",", i ? 0x102030 : 0x403020);
+        fprintf(f, "] }%s\n", i ? "" : ",");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    head = parseconfigfile(path);
+    unlink(path);
+    if (head == NULL) {
+        fprintf(stdout, "idle           config not valid\n");
+        return 1;
+    }
+    idleconfig = head->idle;
+    sim_reset();
+    terminate.kill = false;
+    terminate.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ((input_open() < 0) || (idle_open() < 0)) {
+        fprintf(stdout, "idle           unable to open the simulated lines\n");
+        freeconfig(head);
+        return 1;
+    }
+    pthread_create(&input, NULL, inputTask, NULL);
+    pthread_create(&clock, NULL, timeTask, NULL);
+    pthread_create(&led, NULL, ledTask, head);
+    input_sim_edge(IR, true, nsnow());
+    usleep(100000);
+    input_sim_edge(IR, false, nsnow());
+    sleep(idleconfig.presence + 2);
+    if (!idle_parked()) errors++;
+    parked = atomic_load(&simlog.head);
+    sleep(IDLE_PARKED_SECONDS);
+    events = atomic_load(&simlog.head) - parked;
+    if (events != 0) errors++;
+    clock_gettime(CLOCK_REALTIME, &edge);
+    input_sim_edge(IR, true, nsnow());
+    at = ((int64_t) edge.tv_sec * 1000000000LL) + edge.tv_nsec;
+    for (int i = 0; (i < 100) && ((tubes == 0) || (leds == 0)); i++) {
+        usleep(10000);
+        tubes = simAfter(SIM_GPIO_SET, LE, at);
+        leds = simAfter(SIM_LED_FRAME, -1, at);
+    }
+    if ((tubes == 0) || (leds == 0) || idle_parked()) errors++;
+    notifyToTerminate();
+    pthread_join(clock, NULL);
+    pthread_join(led, NULL);
+    pthread_join(input, NULL);
+    input_close();
+    idle_close();
+    idleconfig = (idleconfig_t) IDLE_OFF;
+    close(terminate.fd);
+    terminate.fd = -1;
+    terminate.kill = false;
+    fprintf(stdout, "idle           parked %d s with %llu simulated events, sensor to tubes %.1f us to LEDs %.1f us, %d errors\n",
+        IDLE_PARKED_SECONDS, (unsigned long long) events,
+        tubes ? (double) (tubes - at) / 1000 : -1.0, leds ? (double) (leds - at) / 1000 : -1.0, errors);
+    return errors;
+}
+
+/*
+ * the LE rising edge of every flip in the simulated log against the second boundary it was meant for
+ */
+static void latchReport(const char *name)
+{
+    int64_t *latch = malloc(SIM_EVENTS * sizeof(int64_t));
+    int count = 0;
+    uint64_t head;
+    int64_t lastSpi = 0;
+    double sum = 0;
+
+    head = atomic_load(&simlog.head);
+    for (uint64_t i = (head > SIM_EVENTS) ? head - SIM_EVENTS : 0; i < head; i++) {
+        simevent_t *e = &simlog.event[i & (SIM_EVENTS - 1)];
+        int64_t offset;
+        if (e->type == SIM_SPI_WORD) lastSpi = e->ns;
+        if ((e->type != SIM_GPIO_SET) || (e->arg != LE)) continue;
+        /* only preloaded flips, not the load and latch of the startup clear or shutdown blank */
+        if (e->ns - lastSpi < 10000000LL) continue;
+        offset = e->ns % 1000000000LL;
+        if (offset > 500000000LL) offset -= 1000000000LL;
+        latch[count++] = offset;
+        sum += offset;
+    }
+    if (count == 0) {
+        fprintf(stdout, "%-15sno boundary latches recorded\n", name);
+    } else {
+        qsort(latch, count, sizeof(int64_t), cmp64);
+        fprintf(stdout, "%-15s%d flips, boundary to LE min %ld ns avg %.0f ns p50 %ld ns p99 %ld ns max %ld ns\n",
+            name, count, (long) latch[0], sum / count, (long) latch[count / 2], (long) latch[(count * 99) / 100],
+            (long) latch[count - 1]);
+    }
+    free(latch);
+}
+
+/*
+ * runs the real timeTask on the simulated backend and measures the LE rising edge against
+ * the second boundary it was meant for
+ */
+static void benchTick(int seconds, const char *name, bool shutdown)
+{
+    pthread_t thread;
+    int64_t stop;
+
+    sim_reset();
+    terminate.kill = false;
+    terminate.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    pthread_create(&thread, NULL, timeTask, NULL);
+    sleep(seconds);
+    /* half way through a second, the clock is blocked waiting for the next boundary */
+    usleep(500000);
+    stop = nsnow();
+    notifyToTerminate();
+    pthread_join(thread, NULL);
+    stop = nsnow() - stop;
+    close(terminate.fd);
+    terminate.fd = -1;
+    latchReport(name);
+    if (shutdown) fprintf(stdout, "tick shutdown  terminate to clock thread exit %.1f us\n", (double) stop / 1000);
+}
+
+/*
+ * the clock and the LEDs on the same roll, first as their own threads and then both on the
+ * reactor thread, for the flip latency, the LED frames and the context switches each way costs
+ */
+static int benchReactor(int seconds)
+{
+    static char path[] = "/tmp/pixie-reactorXXXXXX";
+    static const char *names[2] = {"threads", "reactor"};
+    int fd = mkstemp(path);
+    pthread_t clock, led;
+    ledrollhead_t *head;
+    struct rusage before, after;
+    uint64_t frames, end;
+    int errors = 0;
+    FILE *f;
+
+    if ((fd < 0) || ((f = fdopen(fd, "w")) == NULL)) {
+        fprintf(stdout, "reactor        unable to create %s\n", path);
+        return 1;
+    }
+    fprintf(f, "{\n  \"roll\" : [\n");
+    for (int i = 0; i < 2; i++) {
+        fprintf(f, "    { \"step\" : \"slow\", \"delay\" : %d, \"color\" : [", FADE_MS);
+        for (int k = 0; k < LEDWIDTH * LEDHEIGHT; k++) fprintf(f, "%s\"#%06X\"", (k == 0) ? "" : ",", i ? 0x102030 : 0x403020);
+        fprintf(f, "] }%s\n", i ? "" : ",");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    for (int pass = 0; pass < 2; pass++) {
+        /* the LED side frees the roll as it stops */
+        head = parseconfigfile(path);
+        if (head == NULL) {
+            fprintf(stdout, "reactor        config not valid\n");
+            errors++;
+            break;
+        }
+        sim_reset();
+        terminate.kill = false;
+        terminate.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        getrusage(RUSAGE_SELF, &before);
+        if (pass == 0) {
+            pthread_create(&clock, NULL, timeTask, NULL);
+            pthread_create(&led, NULL, ledTask, head);
+        } else {
+            pthread_create(&clock, NULL, reactorTask, head);
+        }
+        sleep(seconds);
+        usleep(500000);
+        notifyToTerminate();
+        pthread_join(clock, NULL);
+        if (pass == 0) pthread_join(led, NULL);
+        getrusage(RUSAGE_SELF, &after);
+        close(terminate.fd);
+        terminate.fd = -1;
+        terminate.kill = false;
+        frames = 0;
+        end = atomic_load(&simlog.head);
+        for (uint64_t i = (end > SIM_EVENTS) ? end - SIM_EVENTS : 0; i < end; i++) {
+            if (simlog.event[i & (SIM_EVENTS - 1)].type == SIM_LED_FRAME) frames++;
+        }
+        if (frames == 0) errors++;
+        latchReport(names[pass]);
+        fprintf(stdout, "%-15s%llu LED frames, %ld voluntary %ld involuntary context switches\n", names[pass],
+            (unsigned long long) frames, after.ru_nvcsw - before.ru_nvcsw, after.ru_nivcsw - before.ru_nivcsw);
+    }
+    unlink(path);
+    return errors;
+}
+
+static void *busyTask(void *arg)
+{
+    volatile uint64_t spins = 0;
+    while (!atomic_load_explicit((atomic_bool *) arg, memory_order_relaxed)) spins++;
+    return NULL;
+}
+
+/*
+ * the tick again with a normal priority thread spinning on every core, first with the clock on the
+ * normal scheduler like them, then at SCHED_FIFO pinned to the last core with the memory locked
+ */
+static void benchRealtime(int seconds)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t *busy;
+    atomic_bool stop;
+
+    if (cpus < 1) cpus = 1;
+    busy = malloc(cpus * sizeof(pthread_t));
+    for (int pass = 0; pass < 2; pass++) {
+        atomic_store(&stop, false);
+        for (long i = 0; i < cpus; i++) pthread_create(&busy[i], NULL, busyTask, &stop);
+        if (pass == 1) {
+            realtime.lock = 1;
+            realtime.thread[RT_CLOCK] = (rtthread_t) {.priority = BENCH_RT_PRIORITY, .cpu = cpus - 1};
+            realtime_lock();
+        }
+        benchTick(seconds, (pass == 0) ? "tick busy" : "tick busy rt", false);
+        atomic_store(&stop, true);
+        for (long i = 0; i < cpus; i++) pthread_join(busy[i], NULL);
+        realtime = (realtime_t) REALTIME_OFF;
+        realtime_unlock();
+    }
+    free(busy);
+}
+
+/*
+ * what recording a metric costs the hot path, then the exposition of everything the other
+ * benchmarks recorded
+ */
+static int benchMetrics(void)
+{
+    static metrichist_t scratch;
+    char path[64];
+    char line[256];
+    int64_t start, elapsed;
+    int lines = 0;
+    int errors = 0;
+    FILE *fp;
+
+    start = nsnow();
+    for (int i = 0; i < METRIC_LOOPS; i++) metric_record(&scratch, i & 0xfffff);
+    elapsed = nsnow() - start;
+    start = nsnow();
+    for (int i = 0; i < METRIC_LOOPS / 10; i++) metric_record(&scratch, metric_now() - start);
+    fprintf(stdout, "metrics        record %.1f ns, with the clock reads around it %.1f ns\n",
+        (double) elapsed / METRIC_LOOPS, (double) (nsnow() - start) / (METRIC_LOOPS / 10));
+    snprintf(path, sizeof(path), "/tmp/pixie-bench-%d.prom", (int) getpid());
+    start = nsnow();
+    if (metrics_write(path) < 0) {
+        fprintf(stdout, "metrics        unable to write %s\n", path);
+        return 1;
+    }
+    elapsed = nsnow() - start;
+    fp = fopen(path, "r");
+    while ((fp != NULL) && (fgets(line, sizeof(line), fp) != NULL)) {
+        if (line[0] != '#') lines++;
+        if ((line[0] != '#') && (strncmp(line, "pixie_", 6) != 0)) errors++;
+    }
+    if (fp != NULL) fclose(fp);
+    unlink(path);
+    if (atomic_load(&metrics.flip.count) == 0) errors++;
+    fprintf(stdout, "metrics        %d samples written in %.1f us, flip p50 <= %.1f us p99 <= %.1f us, render p99 <= %.1f us\n",
+        lines, (double) elapsed / 1000, (double) metric_quantile(&metrics.flip, 0.5) / 1000,
+        (double) metric_quantile(&metrics.flip, 0.99) / 1000, (double) metric_quantile(&metrics.render, 0.99) / 1000);
+    return errors;
+}
+
+/*
+ * what an event costs the thread recording it, then a dump of the rings including the clock
+ * thread's from the tick run
+ */
+static int benchTrace(void)
+{
+    char path[64];
+    traceheader_t header = {0};
+    int64_t start, at, with;
+    long expected = -1;
+    long size = 0;
+    int errors = 0;
+    FILE *fp;
+
+    trace_thread("bench");
+    start = nsnow();
+    for (int i = 0; i < TRACE_LOOPS; i++) trace_at(TRACE_BUILD, i, start + i);
+    at = nsnow() - start;
+    start = nsnow();
+    for (int i = 0; i < TRACE_LOOPS / 10; i++) trace_event(TRACE_RENDER, i);
+    with = nsnow() - start;
+    snprintf(path, sizeof(path), "/tmp/pixie-bench-%d.trace", (int) getpid());
+    start = nsnow();
+    if (trace_dump(path) < 0) {
+        fprintf(stdout, "trace          unable to write %s\n", path);
+        return 1;
+    }
+    start = nsnow() - start;
+    fp = fopen(path, "r");
+    if ((fp != NULL) && (fread(&header, sizeof(header), 1, fp) == 1)) {
+        expected = sizeof(header) + (header.rings * (TRACE_NAME + sizeof(uint64_t) + (TRACE_EVENTS * sizeof(traceevent_t))));
+        fseek(fp, 0, SEEK_END);
+        size = ftell(fp);
+    }
+    if (fp != NULL) fclose(fp);
+    if ((size != expected) || (memcmp(header.magic, TRACE_MAGIC, 4) != 0) || (traceRing == NULL)) errors++;
+    unlink(path);
+    fprintf(stdout, "trace          event %.1f ns, with its clock read %.1f ns, %u rings dumped in %.1f us, %d errors\n",
+        (double) at / TRACE_LOOPS, (double) with / (TRACE_LOOPS / 10), header.rings, (double) start / 1000, errors);
+    return errors;
+}
+
+/*
+ * checks the PWM periods add up, then runs the clock with the tube thread crossfading and dimming.
+ * The tubes show what LE last latched, from that comes the boundary to the latch of each flip and
+ * the share of the time the tubes are lit once the fade is over. A word shifted in while LE is
+ * high shows half shifted and is an error. Then what the bursts cost.
+ */
+static int benchTubes(int seconds)
+{
+    static const tubeconfig_t config = {.fade = TUBE_FADE_MS, .brightness = TUBE_BRIGHTNESS};
+    int64_t *flip = malloc(SIM_EVENTS * sizeof(int64_t));
+    pthread_t clock, tubes;
+    tubeword_t period[3];
+    struct rusage before, after;
+    uint64_t end, start;
+    int64_t second, since = 0, lit = 0, span = 0, elapsed, cpu;
+    uint64_t shifted = 0, shown = 0;
+    int count = 0, transparent = 0, errors = 0;
+    bool high = false;
+    uint32_t words, steps;
+
+    for (uint32_t mix = 0; mix <= TUBEFX_STEPS; mix++) {
+        for (uint32_t on = 1; on <= TUBEFX_STEPS; on++) {
+            words = tubefx_period(0x1111, 0x2222, mix, on, period);
+            steps = 0;
+            for (uint32_t i = 0; i < words; i++) steps += period[i].steps;
+            if ((words > 3) || (steps != TUBEFX_STEPS)) errors++;
+        }
+    }
+    tubeconfig = config;
+    sim_reset();
+    terminate.kill = false;
+    terminate.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    memset(&tubefxstats, 0, sizeof(tubefxstats));
+    if (tubefx_open() < 0) {
+        free(flip);
+        return errors + 1;
+    }
+    getrusage(RUSAGE_SELF, &before);
+    elapsed = nsnow();
+    pthread_create(&tubes, NULL, tubefxTask, NULL);
+    pthread_create(&clock, NULL, timeTask, NULL);
+    sleep(seconds);
+    usleep(500000);
+    notifyToTerminate();
+    pthread_join(clock, NULL);
+    pthread_join(tubes, NULL);
+    elapsed = nsnow() - elapsed;
+    getrusage(RUSAGE_SELF, &after);
+    tubefx_close();
+    close(terminate.fd);
+    terminate.fd = -1;
+    terminate.kill = false;
+    tubeconfig = (tubeconfig_t) TUBEFX_OFF;
+    end = atomic_load(&simlog.head);
+    start = (end > SIM_EVENTS) ? end - SIM_EVENTS : 0;
+    second = 0;
+    for (uint64_t i = start; i < end; i++) {
+        simevent_t *e = &simlog.event[i & (SIM_EVENTS - 1)];
+        int64_t into = e->ns % 1000000000LL;
+        if (e->type == SIM_SPI_WORD) {
+            if (high) transparent++;
+            shifted = e->data;
+            continue;
+        }
+        if (((e->type != SIM_GPIO_SET) && (e->type != SIM_GPIO_CLEAR)) || (e->arg != LE)) continue;
+        high = (e->type == SIM_GPIO_SET);
+        if (!high) continue;
+        /* what showed up to this latch, from the first flip on */
+        if ((count > 0) && (since % 1000000000LL > (TUBE_FADE_MS + 10) * 1000000LL) && (since % 1000000000LL < 900000000LL)) {
+            span += e->ns - since;
+            if (shown != 0) lit += e->ns - since;
+        }
+        /* the first latch of each second after the first whole one */
+        if ((e->ns / 1000000000LL != second) && (second != 0)) flip[count++] = into;
+        if ((second == 0) || (e->ns / 1000000000LL != second)) second = e->ns / 1000000000LL;
+        shown = shifted;
+        since = e->ns;
+    }
+    cpu = ((after.ru_utime.tv_sec - before.ru_utime.tv_sec) + (after.ru_stime.tv_sec - before.ru_stime.tv_sec)) * 1000000LL
+        + (after.ru_utime.tv_usec - before.ru_utime.tv_usec) + (after.ru_stime.tv_usec - before.ru_stime.tv_usec);
+    if ((count == 0) || (span == 0) || (llabs((lit * 100 / span) - TUBE_BRIGHTNESS) > 5)) errors++;
+    if (transparent > 0) errors++;
+    if (count > 0) {
+        qsort(flip, count, sizeof(int64_t), cmp64);
+        fprintf(stdout, "tubes          %d flips, boundary to latch p50 %ld ns max %ld ns, lit %.1f%% at brightness %d\n",
+            count, (long) flip[count / 2], (long) flip[count - 1], span ? (double) lit * 100 / span : 0.0, TUBE_BRIGHTNESS);
+    }
+    fprintf(stdout, "tubes          %.0f words/s in %.1f bursts/s, %d shifted with LE high, cpu %.2f%%, %d errors\n",
+        (double) atomic_load(&tubefxstats.words) * 1e9 / elapsed, (double) atomic_load(&tubefxstats.bursts) * 1e9 / elapsed,
+        transparent, (double) cpu * 1000 * 100 / elapsed, errors);
+    free(flip);
+    return errors;
+}
+
+/*
+ * runs the clock with the tube thread refreshing the cathodes for a few seconds. Every second
+ * should still start with the clock's flip and show the time for TUBEFX_REFRESH_HOLD_MS from the
+ * boundary before the refresh words, no word should shift in while LE is high and every cathode
+ * should have been lit.
+ */
+static int benchCathodes(void)
+{
+    static const tubeconfig_t config = {.brightness = 100, .refreshEvery = 1, .refreshAt = -1, .refreshSeconds = CATHODE_SECONDS};
+    uint64_t sequence[NIXIE_DIGITS];
+    uint8_t digit[NIXIE_TUBES];
+    nixieframe_t frame;
+    pthread_t clock, tubes;
+    struct timespec now;
+    uint64_t end, shifted = 0, least = UINT64_MAX, most = 0;
+    int64_t second = 0, flip = 0, worst = 0, hold = INT64_MAX;
+    int flips = 0, transparent = 0, errors = 0;
+    bool refreshed, high = false;
+
+    /* the words the tube thread should have worked out for itself */
+    nixie_frame_init(&frame);
+    for (int i = 0; i < NIXIE_DIGITS; i++) {
+        for (int s = 0; s < NIXIE_TUBES; s++) digit[s] = (i + s) % NIXIE_DIGITS;
+        nixie_frame_set_digits(&frame, digit, (i & 1) != 0);
+        sequence[i] = frame.word.ll;
+    }
+    tubeconfig = config;
+    if (!tubefx_refresh_due(60, 0) || tubefx_refresh_due(60, 1)) errors++;
+    sim_reset();
+    terminate.kill = false;
+    terminate.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    memset(&tubefxstats, 0, sizeof(tubefxstats));
+    if (tubefx_open() < 0) return errors + 1;
+    pthread_create(&tubes, NULL, tubefxTask, NULL);
+    pthread_create(&clock, NULL, timeTask, NULL);
+    /* once the tubes show the time, the clock only asks at a boundary */
+    sleep(1);
+    clock_gettime(CLOCK_REALTIME, &now);
+    tubefx_refresh(now.tv_sec + CATHODE_SECONDS);
+    sleep(CATHODE_SECONDS + 1);
+    notifyToTerminate();
+    pthread_join(clock, NULL);
+    pthread_join(tubes, NULL);
+    tubefx_close();
+    close(terminate.fd);
+    terminate.fd = -1;
+    terminate.kill = false;
+    tubeconfig = (tubeconfig_t) TUBEFX_OFF;
+    end = atomic_load(&simlog.head);
+    for (uint64_t i = (end > SIM_EVENTS) ? end - SIM_EVENTS : 0; i < end; i++) {
+        simevent_t *e = &simlog.event[i & (SIM_EVENTS - 1)];
+        if (e->type == SIM_SPI_WORD) {
+            if (high) transparent++;
+            shifted = e->data;
+        }
+        if (((e->type == SIM_GPIO_SET) || (e->type == SIM_GPIO_CLEAR)) && (e->arg == LE)) high = (e->type == SIM_GPIO_SET);
+        /* what LE latched, leaving out the blank of the startup and the shutdown */
+        if ((e->type != SIM_GPIO_SET) || (e->arg != LE) || (shifted == 0)) continue;
+        refreshed = false;
+        for (int k = 0; k < NIXIE_DIGITS; k++) refreshed |= (shifted == sequence[k]);
+        if (e->ns / 1000000000LL != second) {
+            second = e->ns / 1000000000LL;
+            flip = 0;
+            /* the first latch of a second is the time, not the refresh */
+            if (!refreshed) {
+                flip = e->ns;
+                flips++;
+                if (e->ns % 1000000000LL > worst) worst = e->ns % 1000000000LL;
+            } else if (refreshed) {
+                errors++;
+            }
+        } else if (refreshed && (flip != 0)) {
+            if (e->ns % 1000000000LL < hold) hold = e->ns % 1000000000LL;
+            flip = 0;
+        }
+    }
+    for (int s = 0; s < NIXIE_TUBES; s++) {
+        for (int d = 0; d < NIXIE_DIGITS; d++) {
+            uint64_t lit = atomic_load(&tubefxstats.cathode[s][d]);
+            if (lit < least) least = lit;
+            if (lit > most) most = lit;
+        }
+    }
+    if ((least == 0) || (hold < TUBEFX_REFRESH_HOLD_MS * 1000000LL) || (hold == INT64_MAX)) errors++;
+    /* with only a refresh the clock flips the tubes, the tube thread just has the gaps */
+    if ((transparent > 0) || (atomic_load(&tubefxstats.flips) != 0)) errors++;
+    fprintf(stdout, "cathodes       %d flips during %d s of refresh, boundary to time max %ld ns, refresh from %.1f ms into the second\n",
+        flips, CATHODE_SECONDS, (long) worst, (hold == INT64_MAX) ? -1.0 : (double) hold / 1e6);
+    fprintf(stdout, "cathodes       each lit %.2f s to %.2f s, %llu refreshes, %llu flips by the tube thread, %d shifted with LE high, %d errors\n",
+        (double) least / 1e9, (double) most / 1e9, (unsigned long long) atomic_load(&tubefxstats.refreshes),
+        (unsigned long long) atomic_load(&tubefxstats.flips), transparent, errors);
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = (argc > 1) ? atoi(argv[1]) : BENCH_SECONDS;
+    int errors;
+
+    if (seconds <= 0) seconds = BENCH_SECONDS;
+    fprintf(stdout, "pixie bench on the %s backend\n", backend->name);
+    errors = benchEncode();
+    benchFrames();
+    benchRefresh();
+    benchSched();
+    errors += benchKernels();
+    errors += benchTimeline();
+    errors += benchConfig();
+    errors += benchFeed();
+    errors += benchDmx();
+    errors += benchInput();
+    benchTick(seconds, "tick latency", true);
+    benchRealtime(seconds);
+    errors += benchMetrics();
+    errors += benchTrace();
+    /* last, its threads take trace rings the ones before count on */
+    errors += benchIdle();
+    errors += benchReactor(seconds);
+    errors += benchTubes(seconds);
+    errors += benchCathodes();
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+/*
+ * @file compile.c
+ * @brief pixie-compile, converts LED color json files into .pxr roll files for the daemon
+ * @details for raspberry pi 3B+
+ * The json goes through the same parseconfig() checks the daemon uses, so a file that compiles
+ * plays. Put LEDcolor.pxr beside LEDcolor.json and the daemon loads it in place of the json while
+ * it is the newer of the two.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nixieclock.h"
+#include "rollfile.h"
+
+/* globals the shared headers expect main.c to provide */
+terminate_t terminate = {.kill = false, .fd = -1};
+bool nixieTest = false;
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s input.json [output.pxr]\n", name);
+    fprintf(stderr, "  the output defaults to the input with the extension changed to .pxr\n");
+}
+
+int main(int argc, char *argv[])
+{
+    ledrollhead_t *ledrollhead;
+    const char *input;
+    char *output;
+    char *dot;
+    size_t length;
+    int rv;
+
+    if (argc < 2 || argc > 3 || argv[1][0] == '-') {
+        usage(argv[0]);
+        return 1;
+    }
+    input = argv[1];
+    if (argc == 3) {
+        output = strdup(argv[2]);
+    } else {
+        length = strlen(input);
+        output = (char *) malloc(length + sizeof(ROLLFILE_EXTENSION));
+        if (output != NULL) {
+            strcpy(output, input);
+            dot = strrchr(output, '.');
+            if (dot == NULL || strchr(dot, '/') != NULL) dot = output + length;
+            strcpy(dot, ROLLFILE_EXTENSION);
+        }
+    }
+    if (output == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    ledrollhead = parseconfigfile(input);
+    if (ledrollhead == NULL) {
+        fprintf(stderr, "%s not compiled\n", input);
+        free(output);
+        return 1;
+    }
+    rv = rollfile_write(ledrollhead, output);
+    if (rv == 0) {
+        fprintf(stdout, "%s: %d records, %u x %u LEDs, written to %s\n", input, ledrollhead->count,
+            ledrollhead->geometry.width, ledrollhead->geometry.height, output);
+    }
+    freeconfig(ledrollhead);
+    free(output);
+    return (rv == 0) ? 0 : 1;
+}
@@ -0,0 +1,457 @@
+/*
+ * @file dmxfeed.c
+ * @brief E1.31 (sACN) and Art-Net receiver for the live feed
+ * @details for raspberry pi 3B+
+ * Both protocols are read on their own UDP socket by the live feed thread, DMXFEED_BATCH packets a
+ * recvmmsg. Universes are written into a frame being built and a finished frame is copied aside, so
+ * the packets after it in the same batch can not tear it. Only the newest finished frame of a batch
+ * is handed on. E1.31 universes are joined on their multicast groups, unicast and Art-Net broadcast
+ * arrive on the same sockets. Priority, preview data and ArtPoll replies are not supported, the
+ * daemon takes the stream it is sent.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "nixieclock.h"
+#include "dmxfeed.h"
+#include "livefeed.h"
+
+#define E131_ROOT_DATA 0x00000004
+#define E131_ROOT_EXTENDED 0x00000008
+#define E131_FRAMING_DATA 0x00000002
+#define E131_FRAMING_SYNC 0x00000001
+#define E131_DMP_SET_PROPERTY 0x02
+#define E131_DATA_HEADER 126
+#define E131_SYNC_SIZE 49
+#define E131_OPTION_PREVIEW 0x80
+#define E131_OPTION_TERMINATED 0x40
+#define ARTNET_OP_DMX 0x5000
+#define ARTNET_OP_SYNC 0x5200
+#define ARTNET_VERSION 14
+#define ARTNET_DATA_HEADER 18
+#define ARTNET_SYNC_SIZE 14
+/* sync address the Art-Net universes wait on, above any E1.31 universe */
+#define ARTNET_SYNC 0xFFFF
+
+static const uint8_t e131Identifier[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+static const uint8_t artnetIdentifier[8] = {'A', 'r', 't', '-', 'N', 'e', 't', 0};
+
+uint32_t dmxUniverse = 0;
+
+typedef struct {
+    uint8_t data[DMXFEED_CHANNELS];     /* channels held for the sync packet */
+    uint16_t length;
+    uint16_t sync;                      /* sync address the held channels wait for */
+    uint8_t sequence;                   /* last sequence number taken */
+    bool started;                       /* sequence is valid */
+    bool held;
+    bool received;                      /* arrived since the last frame finished */
+} dmxuniverse_t;
+
+static ledgeometry_t geometry;
+static dmxuniverse_t *universes = NULL;
+static uint32_t universeCount;
+static uint32_t receivedCount;
+static uint32_t *building = NULL;      /* frame the universes are written into */
+static uint32_t *finished = NULL;      /* last complete frame */
+static bool done;                       /* a frame finished in this batch */
+static int64_t artsyncAt;               /* when the last ArtSync came, 0 for none */
+static int e131fd = -1;
+static int artnetfd = -1;
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return ((uint16_t) p[0] << 8) | p[1];
+}
+
+static inline uint32_t get32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline void put16(uint8_t *p, uint16_t value)
+{
+    p[0] = value >> 8;
+    p[1] = value;
+}
+
+static inline void put32(uint8_t *p, uint32_t value)
+{
+    put16(p, value >> 16);
+    put16(p + 2, value);
+}
+
+static inline int64_t monotonic(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+static void finish(void)
+{
+    memcpy(finished, building, geometry.stride * sizeof(uint32_t));
+    for (uint32_t i = 0; i < universeCount; i++) universes[i].received = false;
+    receivedCount = 0;
+    done = true;
+}
+
+/*
+ * @brief apply writes the channels of universe index u into the frame being built, three to a LED
+ */
+static void apply(uint32_t u, const uint8_t *data, uint16_t length)
+{
+    uint32_t first = u * DMXFEED_LEDS;
+    uint32_t count = length / 3;
+
+    if (first + count > geometry.count) count = geometry.count - first;
+    for (uint32_t i = 0; i < count; i++, data += 3) {
+        building[ledposition(&geometry, first + i)] = ((uint32_t) data[0] << 16) | ((uint32_t) data[1] << 8) | data[2];
+    }
+}
+
+/*
+ * @brief sequenced(dmxuniverse_t *ux, uint8_t sequence) the E1.31 rule, a packet up to
+ * DMXFEED_SEQUENCE_WINDOW behind the last one arrived out of order
+ * @return true if the packet is newer
+ */
+static bool sequenced(dmxuniverse_t *ux, uint8_t sequence)
+{
+    int8_t diff = (int8_t) (sequence - ux->sequence);
+
+    if (ux->started && (diff <= 0) && (diff > -DMXFEED_SEQUENCE_WINDOW)) {
+        atomic_fetch_add_explicit(&livefeedstats.stale, 1, memory_order_relaxed);
+        return false;
+    }
+    ux->sequence = sequence;
+    ux->started = true;
+    return true;
+}
+
+/*
+ * @brief universeData takes the channels of one universe, held if the sender will sync them
+ */
+static void universeData(uint32_t universe, uint16_t sync, const uint8_t *data, uint16_t length)
+{
+    dmxuniverse_t *ux;
+
+    if ((universe < dmxUniverse) || (universe - dmxUniverse >= universeCount)) return;
+    ux = &universes[universe - dmxUniverse];
+    atomic_fetch_add_explicit(&livefeedstats.messages, 1, memory_order_relaxed);
+    if (length > DMXFEED_CHANNELS) length = DMXFEED_CHANNELS;
+    if (sync != 0) {
+        memcpy(ux->data, data, length);
+        ux->length = length;
+        ux->sync = sync;
+        ux->held = true;
+        return;
+    }
+    /* the sender moved on to the next frame without every universe arriving */
+    if (ux->received) finish();
+    apply(universe - dmxUniverse, data, length);
+    ux->received = true;
+    if (++receivedCount == universeCount) finish();
+}
+
+static void universeSync(uint16_t sync)
+{
+    bool applied = false;
+
+    for (uint32_t i = 0; i < universeCount; i++) {
+        dmxuniverse_t *ux = &universes[i];
+        if (!ux->held || (ux->sync != sync)) continue;
+        apply(i, ux->data, ux->length);
+        ux->held = false;
+        applied = true;
+    }
+    if (applied) finish();
+}
+
+static void e131Packet(const uint8_t *p, size_t length)
+{
+    uint32_t universe;
+    uint16_t count;
+
+    if ((length < E131_SYNC_SIZE) || (get16(p) != 0x0010) || (memcmp(p + 4, e131Identifier, sizeof(e131Identifier)) != 0)) {
+        atomic_fetch_add_explicit(&livefeedstats.rejected, 1, memory_order_relaxed);
+        return;
+    }
+    if ((get32(p + 18) == E131_ROOT_EXTENDED) && (get32(p + 40) == E131_FRAMING_SYNC)) {
+        universeSync(get16(p + 45));
+        return;
+    }
+    if ((get32(p + 18) != E131_ROOT_DATA) || (length < E131_DATA_HEADER) || (get32(p + 40) != E131_FRAMING_DATA) ||
+        (p[117] != E131_DMP_SET_PROPERTY) || (p[118] != 0xa1)) {
+        atomic_fetch_add_explicit(&livefeedstats.rejected, 1, memory_order_relaxed);
+        return;
+    }
+    count = get16(p + 123);
+    if ((count == 0) || (length < E131_DATA_HEADER - 1 + count)) {
+        atomic_fetch_add_explicit(&livefeedstats.rejected, 1, memory_order_relaxed);
+        return;
+    }
+    /* only null start code dimmer data is LED colors, a terminated stream leaves it to the hold time */
+    if ((p[125] != 0) || (p[112] & (E131_OPTION_PREVIEW | E131_OPTION_TERMINATED))) return;
+    universe = get16(p + 113);
+    if ((universe >= dmxUniverse) && (universe - dmxUniverse < universeCount) &&
+        !sequenced(&universes[universe - dmxUniverse], p[111])) return;
+    universeData(universe, get16(p + 109), p + E131_DATA_HEADER, count - 1);
+}
+
+static void artnetPacket(const uint8_t *p, size_t length)
+{
+    uint32_t universe;
+    uint16_t count;
+    uint16_t op;
+
+    if ((length < ARTNET_SYNC_SIZE) || (memcmp(p, artnetIdentifier, sizeof(artnetIdentifier)) != 0)) {
+        atomic_fetch_add_explicit(&livefeedstats.rejected, 1, memory_order_relaxed);
+        return;
+    }
+    op = p[8] | ((uint16_t) p[9] << 8);
+    if (op == ARTNET_OP_SYNC) {
+        artsyncAt = monotonic();
+        universeSync(ARTNET_SYNC);
+        return;
+    }
+    if (op != ARTNET_OP_DMX) return;
+    count = get16(p + 16);
+    if ((length < ARTNET_DATA_HEADER) || (get16(p + 10) < ARTNET_VERSION) || (length < ARTNET_DATA_HEADER + count)) {
+        atomic_fetch_add_explicit(&livefeedstats.rejected, 1, memory_order_relaxed);
+        return;
+    }
+    universe = (p[14] | ((uint32_t) (p[15] & 0x7f) << 8)) + 1;
+    /* sequence 0 means the sender does not number its packets */
+    if ((p[12] != 0) && (universe >= dmxUniverse) && (universe - dmxUniverse < universeCount) &&
+        !sequenced(&universes[universe - dmxUniverse], p[12])) return;
+    if ((artsyncAt != 0) && (monotonic() - artsyncAt > DMXFEED_ARTSYNC_MS * 1000000LL)) artsyncAt = 0;
+    universeData(universe, (artsyncAt != 0) ? ARTNET_SYNC : 0, p + ARTNET_DATA_HEADER, count);
+}
+
+static int udpSocket(uint16_t port)
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY)};
+    int on = 1;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fprintf(stderr, "unable to create a DMX socket: %s\n", strerror(errno));
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "unable to listen for DMX on port %u: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * @brief dmxfeed_open(const ledgeometry_t *geometry, int *e131, int *artnet) opens both sockets
+ * and joins the E1.31 multicast group of every universe the strip takes
+ * @param[out] e131 - E1.31 socket for the caller to poll
+ * @param[out] artnet - Art-Net socket for the caller to poll
+ * @return 0 or -1 on failure
+ */
+int dmxfeed_open(const ledgeometry_t *active, int *e131, int *artnet)
+{
+    struct ip_mreq mreq;
+    bool joined = true;
+
+    geometry = *active;
+    universeCount = (geometry.count + DMXFEED_LEDS - 1) / DMXFEED_LEDS;
+    if ((dmxUniverse == 0) || (dmxUniverse + universeCount - 1 > DMXFEED_UNIVERSE_MAX)) {
+        fprintf(stderr, "DMX universes %u to %u are out of range\n", dmxUniverse, dmxUniverse + universeCount - 1);
+        return -1;
+    }
+    universes = (dmxuniverse_t *) calloc(universeCount, sizeof(dmxuniverse_t));
+    building = (uint32_t *) aligned_alloc(LEDFRAME_ALIGN, geometry.stride * sizeof(uint32_t));
+    finished = (uint32_t *) aligned_alloc(LEDFRAME_ALIGN, geometry.stride * sizeof(uint32_t));
+    if ((universes == NULL) || (building == NULL) || (finished == NULL)) {
+        fprintf(stderr, "Out of memory for the DMX universes\n");
+        dmxfeed_close();
+        return -1;
+    }
+    memset(building, 0, geometry.stride * sizeof(uint32_t));
+    receivedCount = 0;
+    artsyncAt = 0;
+    e131fd = udpSocket(DMXFEED_E131_PORT);
+    artnetfd = udpSocket(DMXFEED_ARTNET_PORT);
+    if ((e131fd < 0) || (artnetfd < 0)) {
+        dmxfeed_close();
+        return -1;
+    }
+    for (uint32_t u = dmxUniverse; u < dmxUniverse + universeCount; u++) {
+        mreq.imr_multiaddr.s_addr = htonl(0xEFFF0000 | u);    /* 239.255.hi.lo */
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(e131fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) joined = false;
+    }
+    if (!joined) fprintf(stderr, "unable to join the E1.31 multicast groups, only unicast will be received\n");
+    fprintf(stdout, "DMX universes %u to %u on E1.31 and Art-Net\n", dmxUniverse, dmxUniverse + universeCount - 1);
+    *e131 = e131fd;
+    *artnet = artnetfd;
+    return 0;
+}
+
+/*
+ * @brief dmxfeed_receive(int fd) reads every packet queued on one of the sockets
+ * @return the newest frame finished by them, valid until the next call, or NULL
+ */
+const uint32_t *dmxfeed_receive(int fd)
+{
+    static uint8_t packets[DMXFEED_BATCH][DMXFEED_PACKET];
+    struct mmsghdr msgs[DMXFEED_BATCH];
+    struct iovec iov[DMXFEED_BATCH];
+    int n;
+
+    for (int i = 0; i < DMXFEED_BATCH; i++) {
+        iov[i].iov_base = packets[i];
+        iov[i].iov_len = DMXFEED_PACKET;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    done = false;
+    do {
+        n = recvmmsg(fd, msgs, DMXFEED_BATCH, MSG_DONTWAIT, NULL);
+        for (int i = 0; i < n; i++) {
+            if (fd == e131fd) {
+                e131Packet(packets[i], msgs[i].msg_len);
+            } else {
+                artnetPacket(packets[i], msgs[i].msg_len);
+            }
+        }
+    } while (n == DMXFEED_BATCH);
+    return done ? finished : NULL;
+}
+
+void dmxfeed_close(void)
+{
+    if (e131fd >= 0) close(e131fd);
+    if (artnetfd >= 0) close(artnetfd);
+    e131fd = -1;
+    artnetfd = -1;
+    free(universes);
+    free(building);
+    free(finished);
+    universes = NULL;
+    building = NULL;
+    finished = NULL;
+}
+
+/*
+ * @brief dmxfeed_e131 builds an E1.31 data packet of length channels for universe
+ * @param[in] sync - synchronization address the receiver holds the universe for, 0 to show it now
+ */
+size_t dmxfeed_e131(uint8_t *p, uint16_t universe, uint8_t sequence, uint16_t sync, const uint8_t *data, uint16_t length)
+{
+    size_t size = E131_DATA_HEADER + length;
+
+    memset(p, 0, E131_DATA_HEADER);
+    put16(p, 0x0010);
+    memcpy(p + 4, e131Identifier, sizeof(e131Identifier));
+    put16(p + 16, 0x7000 | (size - 16));
+    put32(p + 18, E131_ROOT_DATA);
+    memcpy(p + 22, "pixie-dmxgen", 12);             /* CID */
+    put16(p + 38, 0x7000 | (size - 38));
+    put32(p + 40, E131_FRAMING_DATA);
+    strcpy((char *) p + 44, "pixie-dmxgen");        /* source name */
+    p[108] = 100;                                   /* default priority */
+    put16(p + 109, sync);
+    p[111] = sequence;
+    put16(p + 113, universe);
+    put16(p + 115, 0x7000 | (size - 115));
+    p[117] = E131_DMP_SET_PROPERTY;
+    p[118] = 0xa1;
+    put16(p + 121, 1);
+    put16(p + 123, length + 1);
+    memcpy(p + E131_DATA_HEADER, data, length);
+    return size;
+}
+
+size_t dmxfeed_e131sync(uint8_t *p, uint16_t sync, uint8_t sequence)
+{
+    memset(p, 0, E131_SYNC_SIZE);
+    put16(p, 0x0010);
+    memcpy(p + 4, e131Identifier, sizeof(e131Identifier));
+    put16(p + 16, 0x7000 | (E131_SYNC_SIZE - 16));
+    put32(p + 18, E131_ROOT_EXTENDED);
+    memcpy(p + 22, "pixie-dmxgen", 12);
+    put16(p + 38, 0x7000 | (E131_SYNC_SIZE - 38));
+    put32(p + 40, E131_FRAMING_SYNC);
+    p[44] = sequence;
+    put16(p + 45, sync);
+    return E131_SYNC_SIZE;
+}
+
+/*
+ * @brief dmxfeed_artnet builds an ArtDmx packet, universe 1 is port address 0, length is rounded
+ * up to even as Art-Net requires
+ */
+size_t dmxfeed_artnet(uint8_t *p, uint16_t universe, uint8_t sequence, const uint8_t *data, uint16_t length)
+{
+    uint16_t port = universe - 1;
+
+    memcpy(p, artnetIdentifier, sizeof(artnetIdentifier));
+    p[8] = ARTNET_OP_DMX & 0xff;
+    p[9] = ARTNET_OP_DMX >> 8;
+    put16(p + 10, ARTNET_VERSION);
+    p[12] = sequence;
+    p[13] = 0;
+    p[14] = port;
+    p[15] = (port >> 8) & 0x7f;
+    memcpy(p + ARTNET_DATA_HEADER, data, length);
+    if (length & 1) p[ARTNET_DATA_HEADER + length++] = 0;
+    put16(p + 16, length);
+    return ARTNET_DATA_HEADER + length;
+}
+
+size_t dmxfeed_artsync(uint8_t *p)
+{
+    memcpy(p, artnetIdentifier, sizeof(artnetIdentifier));
+    p[8] = ARTNET_OP_SYNC & 0xff;
+    p[9] = ARTNET_OP_SYNC >> 8;
+    put16(p + 10, ARTNET_VERSION);
+    p[12] = 0;
+    p[13] = 0;
+    return ARTNET_SYNC_SIZE;
+}
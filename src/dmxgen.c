@@ -0,0 +1,197 @@
+/*
+ * @file dmxgen.c
+ * @brief pixie-dmxgen, sends a moving test pattern as E1.31 or Art-Net DMX
+ * @details for raspberry pi 3B+
+ * For trying the daemon's DMX input (pixied -u) without a lighting console, on the Pi itself over
+ * loopback or from another machine. Frames are paced on CLOCK_MONOTONIC, every universe of a frame
+ * goes out back to back and with -s the sync packet follows them. The time to send each frame is
+ * reported at the end, pixie-bench measures packets to render through the daemon's receiver.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "nixieclock.h"
+#include "dmxfeed.h"
+
+#define DMXGEN_LEDS 256
+#define DMXGEN_FPS 40
+#define DMXGEN_HOST "127.0.0.1"
+
+/* globals the shared headers expect main.c to provide */
+terminate_t terminate = {.kill = false, .fd = -1};
+bool nixieTest = false;
+
+static inline int64_t nsnow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-a] [-s] [-u universe] [-c leds] [-f fps] [-n frames] [host]\n", name);
+    fprintf(stderr, "  -a  send Art-Net instead of E1.31\n");
+    fprintf(stderr, "  -s  synchronize the universes of a frame\n");
+    fprintf(stderr, "  -u  first universe, 1 by default\n");
+    fprintf(stderr, "  -c  LEDs, %d by default\n", DMXGEN_LEDS);
+    fprintf(stderr, "  -f  frames per second, %d by default\n", DMXGEN_FPS);
+    fprintf(stderr, "  -n  frames to send, 0 runs until killed\n");
+    fprintf(stderr, "  the host defaults to %s\n", DMXGEN_HOST);
+}
+
+/*
+ * @brief pattern fills the channels with a rainbow that moves one LED a frame
+ */
+static void pattern(uint8_t *channels, int leds, uint32_t frame)
+{
+    for (int i = 0; i < leds; i++) {
+        uint32_t hue = ((i + frame) * 6 * 256 / leds) % (6 * 256);
+        uint8_t up = hue & 0xff;
+        uint8_t down = 0xff - up;
+        uint8_t *p = &channels[i * 3];
+        switch (hue >> 8) {
+        case 0: p[0] = 0xff; p[1] = up; p[2] = 0; break;
+        case 1: p[0] = down; p[1] = 0xff; p[2] = 0; break;
+        case 2: p[0] = 0; p[1] = 0xff; p[2] = up; break;
+        case 3: p[0] = 0; p[1] = down; p[2] = 0xff; break;
+        case 4: p[0] = up; p[1] = 0; p[2] = 0xff; break;
+        default: p[0] = 0xff; p[1] = 0; p[2] = down; break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET};
+    uint8_t packet[DMXFEED_PACKET];
+    uint8_t *channels;
+    bool artnet = false;
+    bool sync = false;
+    int universe = 1;
+    int leds = DMXGEN_LEDS;
+    int fps = DMXGEN_FPS;
+    long frames = 0;
+    int universes;
+    int64_t at, start, worst = 0, sum = 0;
+    uint8_t sequence = 0;
+    size_t size;
+    long sent;
+    int opt;
+    int fd;
+
+    while ((opt = getopt(argc, argv, "asu:c:f:n:h")) != -1) {
+        switch (opt) {
+        case 'a':
+            artnet = true;
+            break;
+        case 's':
+            sync = true;
+            break;
+        case 'u':
+            universe = atoi(optarg);
+            break;
+        case 'c':
+            leds = atoi(optarg);
+            break;
+        case 'f':
+            fps = atoi(optarg);
+            break;
+        case 'n':
+            frames = atol(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : 1;
+        }
+    }
+    universes = (leds + DMXFEED_LEDS - 1) / DMXFEED_LEDS;
+    if ((leds <= 0) || (fps <= 0) || (frames < 0) || (universe < 1) || (universe + universes - 1 > DMXFEED_UNIVERSE_MAX)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (inet_pton(AF_INET, (optind < argc) ? argv[optind] : DMXGEN_HOST, &addr.sin_addr) != 1) {
+        fprintf(stderr, "%s is not an IPv4 address\n", argv[optind]);
+        return 1;
+    }
+    addr.sin_port = htons(artnet ? DMXFEED_ARTNET_PORT : DMXFEED_E131_PORT);
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    channels = (uint8_t *) calloc(universes, DMXFEED_CHANNELS);
+    if ((fd < 0) || (channels == NULL)) {
+        fprintf(stderr, "unable to set up: %s\n", strerror(errno));
+        return 1;
+    }
+    fprintf(stdout, "%d LEDs on universes %d to %d, %s%s at %d frames/s\n", leds, universe, universe + universes - 1,
+        artnet ? "Art-Net" : "E1.31", sync ? " synchronized" : "", fps);
+    at = nsnow();
+    for (sent = 0; (frames == 0) || (sent < frames); sent++) {
+        struct timespec deadline = {.tv_sec = at / 1000000000LL, .tv_nsec = at % 1000000000LL};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+        pattern(channels, leds, sent);
+        start = nsnow();
+        sequence = (sequence == 255) ? 1 : sequence + 1;
+        for (int u = 0; u < universes; u++) {
+            int count = ((u == universes - 1) ? leds - (u * DMXFEED_LEDS) : DMXFEED_LEDS) * 3;
+            uint8_t *data = &channels[u * DMXFEED_LEDS * 3];
+            if (artnet) {
+                size = dmxfeed_artnet(packet, universe + u, sequence, data, count);
+            } else {
+                size = dmxfeed_e131(packet, universe + u, sequence, sync ? universe : 0, data, count);
+            }
+            sendto(fd, packet, size, 0, (struct sockaddr *) &addr, sizeof(addr));
+        }
+        if (sync) {
+            size = artnet ? dmxfeed_artsync(packet) : dmxfeed_e131sync(packet, universe, sequence);
+            sendto(fd, packet, size, 0, (struct sockaddr *) &addr, sizeof(addr));
+        }
+        start = nsnow() - start;
+        sum += start;
+        if (start > worst) worst = start;
+        at += 1000000000LL / fps;
+        if ((sent + 1) % (fps * 10) == 0) {
+            fprintf(stdout, "%ld frames, send avg %.1f us worst %.1f us\n", sent + 1, (double) sum / (sent + 1) / 1000,
+                (double) worst / 1000);
+        }
+    }
+    fprintf(stdout, "%ld frames, send avg %.1f us worst %.1f us\n", sent, (sent > 0) ? (double) sum / sent / 1000 : 0.0,
+        (double) worst / 1000);
+    close(fd);
+    free(channels);
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * @file framesched.c
+ * @brief absolute deadline frame scheduler for the LED roll
+ * @details for raspberry pi 3B+
+ * Sleeping a relative step after each render adds the render and DMA time to every frame, so a
+ * 3 second fade took noticeably longer and the LEDs drifted against the clock. Deadlines here are
+ * nanoseconds from the start of the roll on CLOCK_MONOTONIC, which a wall clock step can not move.
+ * The sleep is a poll on a timerfd and the stop fd, a 3 second record no longer holds off SIGTERM.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "framesched.h"
+
+#define NSEC_PER_SEC 1000000000LL
+
+/*
+ * @brief framesched_open(framesched_t *fs, int stopfd)
+ * creates the deadline timer
+ * @param[out] fs - scheduler state
+ * @param[in] stopfd - framesched_wait() returns FRAMESCHED_STOP once this fd is readable, -1 for none
+ * @return 0 on success, -1 on failure
+ */
+int framesched_open(framesched_t *fs, int stopfd)
+{
+    memset(fs, 0, sizeof(framesched_t));
+    fs->stopfd = stopfd;
+    for (int i = 0; i < FRAMESCHED_WAKEFDS; i++) fs->wakefd[i] = -1;
+    fs->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fs->fd < 0) {
+        fprintf(stderr, "unable to create frame timer: %s\n", strerror(errno));
+        return -1;
+    }
+    framesched_start(fs);
+    return 0;
+}
+
+void framesched_start(framesched_t *fs)
+{
+    clock_gettime(CLOCK_MONOTONIC, &fs->start);
+    fs->late = 0;
+    fs->maxLate = 0;
+    fs->frames = 0;
+    fs->dropped = 0;
+    fs->lateFrames = 0;
+    fs->rendered = 0;
+    fs->suppressed = 0;
+}
+
+/*
+ * @brief framesched_now(const framesched_t *fs)
+ * @return nanoseconds since framesched_start()
+ */
+int64_t framesched_now(const framesched_t *fs)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t) (now.tv_sec - fs->start.tv_sec) * NSEC_PER_SEC) + (now.tv_nsec - fs->start.tv_nsec);
+}
+
+/*
+ * @brief framesched_arm(framesched_t *fs, int64_t deadline)
+ * sets the timer to fire deadline nanoseconds after the start, FRAMESCHED_NEVER disarms it
+ * @return 0, or -1 if the timer could not be set
+ */
+int framesched_arm(framesched_t *fs, int64_t deadline)
+{
+    struct itimerspec its = {0};
+    int64_t ns = fs->start.tv_nsec + (deadline % NSEC_PER_SEC);
+
+    if (deadline != FRAMESCHED_NEVER) {
+        its.it_value.tv_sec = fs->start.tv_sec + (deadline / NSEC_PER_SEC) + (ns / NSEC_PER_SEC);
+        its.it_value.tv_nsec = ns % NSEC_PER_SEC;
+    }
+    return timerfd_settime(fs->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/*
+ * @brief framesched_wait(framesched_t *fs, int64_t deadline)
+ * @details sleeps until deadline nanoseconds after the start and counts the frame about to be shown,
+ * a deadline already passed does not sleep at all, FRAMESCHED_NEVER sleeps until the stop or a wake fd
+ * @return nanoseconds since the start on waking, FRAMESCHED_STOP if the stop fd became readable first,
+ * FRAMESCHED_WAKE if a wake fd did
+ */
+int64_t framesched_wait(framesched_t *fs, int64_t deadline)
+{
+    struct pollfd fds[2 + FRAMESCHED_WAKEFDS] = {{.fd = fs->fd, .events = POLLIN}, {.fd = fs->stopfd, .events = POLLIN},
+        {.fd = fs->wakefd[0], .events = POLLIN}, {.fd = fs->wakefd[1], .events = POLLIN},
+        {.fd = fs->wakefd[2], .events = POLLIN}};
+    bool woken = false;
+    struct timespec at;
+    int64_t ns = fs->start.tv_nsec + (deadline % NSEC_PER_SEC);
+    uint64_t expirations;
+
+    if (framesched_now(fs) < deadline) {
+        if (framesched_arm(fs, deadline) == 0) {
+            while ((poll(fds, 2 + FRAMESCHED_WAKEFDS, -1) < 0) && (errno == EINTR));
+            if (fds[1].revents & POLLIN) return FRAMESCHED_STOP;
+            for (int i = 0; (i < FRAMESCHED_WAKEFDS) && !(fds[0].revents & POLLIN); i++) {
+                if (!(fds[2 + i].revents & POLLIN)) continue;
+                if (read(fs->wakefd[i], &expirations, sizeof(expirations)) < 0) expirations = 0;
+                woken = true;
+            }
+            if (woken) return FRAMESCHED_WAKE;
+            if (read(fs->fd, &expirations, sizeof(expirations)) < 0) expirations = 0;
+        } else if (deadline != FRAMESCHED_NEVER) {
+            at.tv_sec = fs->start.tv_sec + (deadline / NSEC_PER_SEC) + (ns / NSEC_PER_SEC);
+            at.tv_nsec = ns % NSEC_PER_SEC;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL) == EINTR);
+        }
+    }
+    return framesched_due(fs, deadline);
+}
+
+/*
+ * @brief framesched_due(framesched_t *fs, int64_t deadline) counts the frame due at deadline, for a
+ * caller that waits on fs->fd itself
+ * @return nanoseconds since the start
+ */
+int64_t framesched_due(framesched_t *fs, int64_t deadline)
+{
+    int64_t now = framesched_now(fs);
+
+    fs->late = now - deadline;
+    if (fs->late > fs->maxLate) fs->maxLate = fs->late;
+    if (fs->late > FRAMESCHED_LATE) fs->lateFrames++;
+    fs->frames++;
+    return now;
+}
+
+void framesched_close(framesched_t *fs)
+{
+    if (fs->fd >= 0) close(fs->fd);
+    fs->fd = -1;
+}
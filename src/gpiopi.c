@@ -21,51 +21,39 @@ void *gpio_open(void) {
     return map;
 }
 
+/*
+ * @brief gpio_set_event(void *base, uint8_t pin, EVENT_TYPE_e event, bool async_edge)
+ * sets what the edge detect status register latches for pin, the other pins keep theirs.
+ * NO_EDGE turns detection off. A latched event of the pin is cleared.
+ */
 void gpio_set_event(void *base, uint8_t pin, EVENT_TYPE_e event, bool async_edge) 
 {
-    int re0 = GPREN0;
-    int re1 = GPREN1;
-    int fe0 = GPFEN0;
-    int fe1 = GPFEN1;
-    if (async_edge) {
-        re0 = GPAREN0;
-        re1 = GPAREN1;
-        fe0 = GPAFEN0;
-        fe1 = GPAFEN1;
-    }
-    if (pin > 31) {
-       *((uint32_t *) (base + GPEDS1)) = 1 << (pin - 32);
-    } else {
-       *((uint32_t *) (base + GPEDS0)) = 1 << pin;
-    }
-    if ((event == POSITIVE_EDGE) || (event == BOTH_EDGES)) {
-        if (pin > 31) {
-           *((uint32_t *) (base + re1)) = 1 << (pin - 32);
-        } else {
-           *((uint32_t *) (base + re0)) = 1 << pin;
-        }
-    }
-    if ((event == NEGATIVE_EDGE) || (event == BOTH_EDGES)) {
-        if (pin > 31) {
-           *((uint32_t *) (base + fe1)) = 1 << (pin - 32);
-        } else {
-           *((uint32_t *) (base + fe0)) = 1 << pin;
-        }
-    }
-    if (event == HIGH_LEVEL) {
-        if (pin > 31) {
-           *((uint32_t *) (base + GPHEN1)) = 1 << (pin - 32);
-        } else {
-           *((uint32_t *) (base + GPHEN0)) = 1 << pin;
-        }
-    }
-    if (event == LOW_LEVEL) {
-        if (pin > 31) {
-           *((uint32_t *) (base + GPLEN1)) = 1 << (pin - 32);
-        } else {
-           *((uint32_t *) (base + GPLEN0)) = 1 << pin;
-        }
-    }
-    
-        
-}    
\ No newline at end of file
+    int re = async_edge ? GPAREN0 : GPREN0;
+    int fe = async_edge ? GPAFEN0 : GPFEN0;
+    int bank = (pin > 31) ? 4 : 0;
+    uint32_t bit = 1 << (pin & 31);
+
+    *((volatile uint32_t *) (base + GPEDS0 + bank)) = bit;
+    gpio_set_enable(base, re + bank, bit, (event == POSITIVE_EDGE) || (event == BOTH_EDGES));
+    gpio_set_enable(base, fe + bank, bit, (event == NEGATIVE_EDGE) || (event == BOTH_EDGES));
+    gpio_set_enable(base, GPHEN0 + bank, bit, event == HIGH_LEVEL);
+    gpio_set_enable(base, GPLEN0 + bank, bit, event == LOW_LEVEL);
+}
+
+/*
+ * @brief gpio_set_pull(void *base, uint8_t pin, uint32_t pull)
+ * turns the pull up or down of pin on or off with the BCM2835 to BCM2837 clocked sequence,
+ * the control signal has to be held 150 cycles before and after it is clocked into the pin
+ */
+void gpio_set_pull(void *base, uint8_t pin, uint32_t pull)
+{
+    volatile uint32_t *pud = (volatile uint32_t *) (base + GPPUD);
+    volatile uint32_t *clk = (volatile uint32_t *) (base + ((pin > 31) ? GPPUDCLK1 : GPPUDCLK0));
+
+    *pud = pull;
+    usleep(1);
+    *clk = 1 << (pin & 31);
+    usleep(1);
+    *pud = PULL_DISABLED;
+    *clk = 0;
+}
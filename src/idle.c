@@ -0,0 +1,163 @@
+/*
+ * @file idle.c
+ * @brief decides when nobody is there and parks the clock and the LEDs until somebody is
+ * @details for raspberry pi 3B+
+ * A clock in a room nobody is in still flips its tubes every second and sends LED frames forty
+ * times a second. Parked it blanks the tubes once, sends one black frame, and both threads sleep
+ * on file descriptors with no timer armed, so nothing runs until the sensor, a button or the end
+ * of the idle window wakes them.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+
+#include "nixieclock.h"
+#include "input.h"
+#include "idle.h"
+
+idleconfig_t idleconfig = IDLE_OFF;
+static atomic_bool parked = false;
+static int wakefd = -1;
+
+/*
+ * @brief idle_open() creates the eventfd the LED thread waits on for the clock to park or wake
+ * @return 0 on success, -1 on failure
+ */
+int idle_open(void)
+{
+    wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakefd < 0) {
+        fprintf(stderr, "unable to create idle eventfd: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief idle_fd() readable when the clock has parked or woken, -1 if idle is not open
+ */
+int idle_fd(void)
+{
+    return wakefd;
+}
+
+bool idle_enabled(void)
+{
+    return (idleconfig.presence > 0) || (idleconfig.from >= 0);
+}
+
+/*
+ * @brief idle_input(idlestate_t *state, const inputevent_t *event, time_t now) notes who is there
+ * from an input event of the display queue
+ */
+void idle_input(idlestate_t *state, const inputevent_t *event, time_t now)
+{
+    if (event->line == INPUT_IR) {
+        if ((event->type != INPUT_HIGH) && (event->type != INPUT_LOW)) return;
+        state->present = (event->type == INPUT_HIGH);
+    } else if ((event->line == INPUT_LS) || ((event->type != INPUT_PRESS) && (event->type != INPUT_REPEAT))) {
+        return;
+    }
+    state->seen = now;
+}
+
+/*
+ * @brief window(int minute) is the local minute of the day inside the idle window, a window
+ * that ends before it starts runs over midnight
+ */
+static bool window(int minute)
+{
+    if (idleconfig.from < idleconfig.until) return (minute >= idleconfig.from) && (minute < idleconfig.until);
+    return (minute >= idleconfig.from) || (minute < idleconfig.until);
+}
+
+/*
+ * @brief idle_due(const idlestate_t *state, time_t now, int minute)
+ * @param[in] state - who the clock thread has seen
+ * @param[in] now - UTC second
+ * @param[in] minute - local minute of the day of now
+ * @return true if the clock should be parked
+ */
+bool idle_due(const idlestate_t *state, time_t now, int minute)
+{
+    time_t hold = (idleconfig.presence > 0) ? idleconfig.presence : IDLE_HOLD;
+
+    if (!idle_enabled() || state->present || (now - state->seen < hold)) return false;
+    if (idleconfig.from >= 0) return window(minute);
+    return true;
+}
+
+/*
+ * @brief idle_until(time_t now, int minute, int seconds)
+ * @param[in] now - UTC second
+ * @param[in] minute, seconds - local minute of the day and second of the minute of now
+ * @return UTC second the idle window ends, 0 if only the sensor or a button can wake the clock
+ */
+time_t idle_until(time_t now, int minute, int seconds)
+{
+    time_t left;
+
+    if (idleconfig.from < 0) return 0;
+    left = ((((idleconfig.until - minute) + IDLE_MINUTES) % IDLE_MINUTES) * 60) - seconds;
+    if (left <= 0) left += IDLE_MINUTES * 60;
+    return now + left;
+}
+
+/*
+ * @brief idle_park(bool park) tells the LED thread the clock has parked or woken
+ */
+void idle_park(bool park)
+{
+    uint64_t one = 1;
+
+    atomic_store(&parked, park);
+    if ((wakefd >= 0) && (write(wakefd, &one, sizeof(one)) < 0)) {
+        fprintf(stderr, "idle wake failed: %s\n", strerror(errno));
+    }
+}
+
+bool idle_parked(void)
+{
+    return atomic_load(&parked);
+}
+
+void idle_close(void)
+{
+    if (wakefd >= 0) close(wakefd);
+    wakefd = -1;
+    atomic_store(&parked, false);
+}
@@ -0,0 +1,462 @@
+/*
+ * @file input.c
+ * @brief reads the buttons and sensor lines and queues debounced events for the tasks
+ * @details for raspberry pi 3B+
+ * One thread waits in epoll on a line request for each line, the terminate eventfd and a timer
+ * that is only armed while a line is settling or a button is held. The buttons are active low
+ * with the pull ups on. Without the v2 GPIO character device (kernels before 5.10) the level
+ * register is read every INPUT_POLL_MS instead. With the simulated backend the lines are a pipe
+ * written by input_sim_edge().
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <linux/gpio.h>
+
+#include "nixieclock.h"
+#include "gpiopi.h"
+#include "backend.h"
+#include "input.h"
+
+#define NSEC_PER_MSEC 1000000LL
+/* what woke the epoll, the low half of the data is the fd */
+#define TAG_TERMINATE 1
+#define TAG_TIMER 2
+#define TAG_EDGES 3
+#define TAG_POLL 4
+#define TAG(tag, fd) (((uint64_t) (tag) << 32) | (uint32_t) (fd))
+/* line events read at once */
+#define INPUT_BATCH 16
+
+typedef struct {
+    uint8_t pin;
+    bool button;                /* active low with the pull up on, otherwise a sensor passed on as it is */
+    const char *name;
+} inputline_t;
+
+static const inputline_t lines[INPUT_LINES] = {
+    {UP, true, "up"}, {DOWN, true, "down"}, {MODE, true, "mode"}, {LS, false, "ls"}, {IR, false, "ir"},
+};
+
+typedef struct {
+    int fd;                     /* line request on the character device, -1 without one */
+    bool raw;                   /* level after the last edge */
+    bool level;                 /* level last passed on */
+    int64_t settle;             /* end of the debounce time, 0 once settled */
+    int64_t pressed;            /* when the button was pressed */
+    int64_t next;               /* next INPUT_LONG or INPUT_REPEAT, 0 for none */
+    uint32_t held;              /* long and repeat events so far */
+} inputstate_t;
+
+/* single producer, single consumer ring for each consumer */
+typedef struct {
+    _Alignas(64) atomic_uint head;      /* written by the input thread */
+    _Alignas(64) atomic_uint tail;      /* written by the consumer */
+    int fd;                             /* eventfd written after each event */
+    inputevent_t event[INPUT_QUEUE];
+} inputqueue_t;
+
+inputstats_t inputstats;
+static inputqueue_t queues[INPUT_CONSUMERS];
+static inputstate_t state[INPUT_LINES];
+static bool opened = false;
+/* edges written by input_sim_edge() in line event layout, read like the character device */
+static int simfd[2] = {-1, -1};
+
+static inline int64_t monotonic(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+int input_open(void)
+{
+    for (int c = 0; c < INPUT_CONSUMERS; c++) {
+        atomic_store(&queues[c].head, 0);
+        atomic_store(&queues[c].tail, 0);
+        queues[c].fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (queues[c].fd < 0) {
+            fprintf(stderr, "unable to create the input eventfd: %s\n", strerror(errno));
+            while (c-- > 0) close(queues[c].fd);
+            return -1;
+        }
+    }
+    if ((backend == &backend_sim) && (pipe2(simfd, O_CLOEXEC | O_NONBLOCK) < 0)) {
+        fprintf(stderr, "unable to create the simulated input lines: %s\n", strerror(errno));
+        for (int c = 0; c < INPUT_CONSUMERS; c++) close(queues[c].fd);
+        return -1;
+    }
+    opened = true;
+    return 0;
+}
+
+/*
+ * @brief input_fd(inputConsumerEnum_t consumer)
+ * @return eventfd that is readable once events are queued for consumer, -1 when input is off
+ */
+int input_fd(inputConsumerEnum_t consumer)
+{
+    return opened ? queues[consumer].fd : -1;
+}
+
+/*
+ * @brief input_take(inputConsumerEnum_t consumer, inputevent_t *event) called by the consumer,
+ * never waits. The consumer reads its eventfd empty before taking so no event is left behind.
+ * @return true with the oldest queued event in event, false if there is none
+ */
+bool input_take(inputConsumerEnum_t consumer, inputevent_t *event)
+{
+    inputqueue_t *q = &queues[consumer];
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    if (!opened || (tail == atomic_load_explicit(&q->head, memory_order_acquire))) return false;
+    *event = q->event[tail & (INPUT_QUEUE - 1)];
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static void queue(inputLineEnum_t line, inputEventEnum_t type, uint32_t arg, int64_t ns)
+{
+    inputevent_t event = {.ns = ns, .line = line, .type = type, .arg = arg};
+    uint64_t one = 1;
+
+    for (int c = 0; c < INPUT_CONSUMERS; c++) {
+        inputqueue_t *q = &queues[c];
+        unsigned head = atomic_load_explicit(&q->head, memory_order_relaxed);
+        if (head - atomic_load_explicit(&q->tail, memory_order_acquire) >= INPUT_QUEUE) {
+            atomic_fetch_add_explicit(&inputstats.dropped, 1, memory_order_relaxed);
+            continue;
+        }
+        q->event[head & (INPUT_QUEUE - 1)] = event;
+        atomic_store_explicit(&q->head, head + 1, memory_order_release);
+        if (write(q->fd, &one, sizeof(one)) < 0) continue; /* already at the eventfd maximum */
+    }
+    atomic_fetch_add_explicit(&inputstats.events, 1, memory_order_relaxed);
+}
+
+/*
+ * @brief change passes on a new level of a line and starts its debounce time
+ */
+static void change(inputLineEnum_t line, bool level, int64_t ns)
+{
+    inputstate_t *s = &state[line];
+
+    s->level = level;
+    s->settle = ns + (INPUT_DEBOUNCE_MS * NSEC_PER_MSEC);
+    if (!lines[line].button) {
+        queue(line, level ? INPUT_HIGH : INPUT_LOW, 0, ns);
+    } else if (!level) {
+        s->pressed = ns;
+        s->next = ns + (INPUT_LONG_MS * NSEC_PER_MSEC);
+        s->held = 0;
+        queue(line, INPUT_PRESS, 0, ns);
+    } else {
+        s->next = 0;
+        queue(line, INPUT_RELEASE, (uint32_t) ((ns - s->pressed) / NSEC_PER_MSEC), ns);
+    }
+}
+
+/*
+ * @brief edge takes one edge of a line, the first from a settled line is passed on at once
+ */
+static void edge(inputLineEnum_t line, bool level, int64_t ns)
+{
+    inputstate_t *s = &state[line];
+
+    atomic_fetch_add_explicit(&inputstats.edges, 1, memory_order_relaxed);
+    s->raw = level;
+    if (s->settle != 0) {
+        atomic_fetch_add_explicit(&inputstats.bounces, 1, memory_order_relaxed);
+    } else if (level != s->level) {
+        change(line, level, ns);
+    }
+}
+
+/*
+ * @brief expire settles lines whose debounce time is over and gives held buttons their long and
+ * repeat events
+ * @return the next time anything is due, 0 for nothing
+ */
+static int64_t expire(int64_t now)
+{
+    int64_t due = 0;
+
+    for (int i = 0; i < INPUT_LINES; i++) {
+        inputstate_t *s = &state[i];
+        if ((s->settle != 0) && (s->settle <= now)) {
+            s->settle = 0;
+            /* it bounced back to where it started, or moved again during the debounce time */
+            if (s->raw != s->level) change(i, s->raw, now);
+        }
+        if ((s->next != 0) && (s->next <= now)) {
+            queue(i, (s->held == 0) ? INPUT_LONG : INPUT_REPEAT, s->held, now);
+            s->held++;
+            s->next += INPUT_REPEAT_MS * NSEC_PER_MSEC;
+            if (s->next <= now) s->next = now + (INPUT_REPEAT_MS * NSEC_PER_MSEC);
+        }
+        if ((s->settle != 0) && ((due == 0) || (s->settle < due))) due = s->settle;
+        if ((s->next != 0) && ((due == 0) || (s->next < due))) due = s->next;
+    }
+    return due;
+}
+
+/*
+ * @brief arm sets the timer for the next thing due or disarms it, nothing wakes an idle thread
+ */
+static void arm(int timerfd, int64_t due)
+{
+    struct itimerspec its = {0};
+
+    its.it_value.tv_sec = due / 1000000000LL;
+    its.it_value.tv_nsec = due % 1000000000LL;
+    timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static int lineOf(uint32_t pin)
+{
+    for (int i = 0; i < INPUT_LINES; i++) {
+        if (lines[i].pin == pin) return i;
+    }
+    return -1;
+}
+
+/*
+ * @brief readEdges reads the line events queued on a line request or the simulated lines
+ */
+static void readEdges(int fd)
+{
+    struct gpio_v2_line_event events[INPUT_BATCH];
+    ssize_t length;
+    int line;
+
+    while ((length = read(fd, events, sizeof(events))) > 0) {
+        for (int i = 0; i < length / (ssize_t) sizeof(events[0]); i++) {
+            if ((line = lineOf(events[i].offset)) < 0) continue;
+            edge(line, events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE, (int64_t) events[i].timestamp_ns);
+        }
+        if (length < (ssize_t) sizeof(events)) break;
+    }
+}
+
+/*
+ * @brief requestLines asks the character device for edge events on every line
+ * @return lines requested, -1 if there is no usable character device
+ */
+static int requestLines(int epfd)
+{
+    struct gpio_v2_line_request request;
+    struct gpio_v2_line_values values;
+    struct epoll_event ev = {.events = EPOLLIN};
+    int chip = open(INPUT_CHIP, O_RDWR | O_CLOEXEC);
+    int count = 0;
+
+    if (chip < 0) return -1;
+    for (int i = 0; i < INPUT_LINES; i++) {
+        memset(&request, 0, sizeof(request));
+        request.offsets[0] = lines[i].pin;
+        request.num_lines = 1;
+        strncpy(request.consumer, "pixied", sizeof(request.consumer) - 1);
+        request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING
+            | (lines[i].button ? GPIO_V2_LINE_FLAG_BIAS_PULL_UP : 0);
+        if (ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+            if (errno == ENOTTY) {
+                /* a kernel from before the v2 line uAPI */
+                close(chip);
+                return -1;
+            }
+            fprintf(stderr, "input %s on gpio %u not available: %s\n", lines[i].name, lines[i].pin, strerror(errno));
+            continue;
+        }
+        state[i].fd = request.fd;
+        fcntl(request.fd, F_SETFL, fcntl(request.fd, F_GETFL) | O_NONBLOCK);
+        values.mask = 1;
+        values.bits = lines[i].button ? 1 : 0;
+        ioctl(request.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values);
+        state[i].raw = state[i].level = (values.bits & 1);
+        ev.data.u64 = TAG(TAG_EDGES, request.fd);
+        epoll_ctl(epfd, EPOLL_CTL_ADD, request.fd, &ev);
+        count++;
+    }
+    close(chip);
+    return count;
+}
+
+/*
+ * @brief pollOpen sets the lines up as inputs. Edge detect is left off, the bcm2835 pinctrl
+ * driver owns the GPIO interrupt and an edge it did not ask for is raised again and again.
+ */
+static void pollOpen(void *map)
+{
+    for (int i = 0; i < INPUT_LINES; i++) {
+        gpio_set_function_select(map, lines[i].pin, FSEL_INPUT);
+        if (lines[i].button) gpio_set_pull(map, lines[i].pin, PULL_UP_ENABLE);
+        state[i].raw = state[i].level = gpio_get_value(map, lines[i].pin);
+    }
+}
+
+/*
+ * @brief pollRead looks at the level of every line, a press shorter than INPUT_POLL_MS can be missed
+ */
+static void pollRead(void *map, int64_t now)
+{
+    for (int i = 0; i < INPUT_LINES; i++) {
+        bool level = gpio_get_value(map, lines[i].pin);
+        if (level != state[i].raw) edge(i, level, now);
+    }
+}
+
+/*
+ * @brief input_sim_edge(uint8_t pin, bool level, int64_t ns) drives a simulated line, ns is the
+ * CLOCK_MONOTONIC time of the edge
+ * @return 0 or -1 if the simulated lines are not open
+ */
+int input_sim_edge(uint8_t pin, bool level, int64_t ns)
+{
+    struct gpio_v2_line_event event = {.timestamp_ns = ns, .offset = pin,
+        .id = level ? GPIO_V2_LINE_EVENT_RISING_EDGE : GPIO_V2_LINE_EVENT_FALLING_EDGE};
+
+    if (simfd[1] < 0) return -1;
+    return (write(simfd[1], &event, sizeof(event)) == sizeof(event)) ? 0 : -1;
+}
+
+void input_close(void)
+{
+    for (int c = 0; c < INPUT_CONSUMERS; c++) {
+        if (opened) close(queues[c].fd);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (simfd[i] >= 0) close(simfd[i]);
+        simfd[i] = -1;
+    }
+    opened = false;
+}
+
+/*
+ * @brief inputTask reads the buttons and sensor lines until terminated
+ * @param[in] threadid unused
+ */
+void *inputTask(void *threadid)
+{
+    struct epoll_event events[INPUT_LINES + 3];
+    struct epoll_event ev = {.events = EPOLLIN};
+    struct itimerspec its = {0};
+    void *map = NULL;
+    int levelfd = -1;
+    int timerfd;
+    int epfd;
+    int count;
+    uint64_t expirations;
+    bool done = false;
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if ((epfd < 0) || (timerfd < 0)) {
+        fprintf(stderr, "unable to set up input: %s\n", strerror(errno));
+        if (epfd >= 0) close(epfd);
+        if (timerfd >= 0) close(timerfd);
+        return NULL;
+    }
+    ev.data.u64 = TAG(TAG_TERMINATE, terminate.fd);
+    epoll_ctl(epfd, EPOLL_CTL_ADD, terminate.fd, &ev);
+    ev.data.u64 = TAG(TAG_TIMER, timerfd);
+    epoll_ctl(epfd, EPOLL_CTL_ADD, timerfd, &ev);
+    for (int i = 0; i < INPUT_LINES; i++) {
+        state[i] = (inputstate_t) {.fd = -1, .raw = lines[i].button, .level = lines[i].button};
+    }
+    if (simfd[0] >= 0) {
+        ev.data.u64 = TAG(TAG_EDGES, simfd[0]);
+        epoll_ctl(epfd, EPOLL_CTL_ADD, simfd[0], &ev);
+        fprintf(stdout, "buttons and sensors simulated\n");
+    } else if ((count = requestLines(epfd)) >= 0) {
+        fprintf(stdout, "%d buttons and sensors on %s\n", count, INPUT_CHIP);
+    } else if ((map = gpio_open()) != NULL) {
+        pollOpen(map);
+        levelfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        its.it_value.tv_nsec = its.it_interval.tv_nsec = INPUT_POLL_MS * NSEC_PER_MSEC;
+        if ((levelfd >= 0) && (timerfd_settime(levelfd, 0, &its, NULL) == 0)) {
+            ev.data.u64 = TAG(TAG_POLL, levelfd);
+            epoll_ctl(epfd, EPOLL_CTL_ADD, levelfd, &ev);
+            fprintf(stdout, "buttons and sensors polled every %d ms\n", INPUT_POLL_MS);
+        }
+    } else {
+        fprintf(stderr, "no GPIO for the buttons and sensors, input is off\n");
+    }
+    while (!done && !isTerminate()) {
+        count = epoll_wait(epfd, events, INPUT_LINES + 3, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "input epoll failed: %s\n", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            int fd = (int) (uint32_t) events[i].data.u64;
+            switch (events[i].data.u64 >> 32) {
+            case TAG_TERMINATE:
+                done = true;
+                break;
+            case TAG_EDGES:
+                readEdges(fd);
+                break;
+            case TAG_POLL:
+                if (read(fd, &expirations, sizeof(expirations)) < 0) expirations = 0;
+                pollRead(map, monotonic());
+                break;
+            case TAG_TIMER:
+                if (read(fd, &expirations, sizeof(expirations)) < 0) expirations = 0;
+                break;
+            }
+        }
+        arm(timerfd, expire(monotonic()));
+    }
+#ifdef DEBUG
+    fprintf(stdout, "input edges %llu bounces %llu events %llu dropped %llu\n",
+        (unsigned long long) inputstats.edges, (unsigned long long) inputstats.bounces,
+        (unsigned long long) inputstats.events, (unsigned long long) inputstats.dropped);
+#endif
+    for (int i = 0; i < INPUT_LINES; i++) {
+        if (state[i].fd >= 0) close(state[i].fd);
+    }
+    if (levelfd >= 0) close(levelfd);
+    close(timerfd);
+    close(epfd);
+    return NULL;
+}
@@ -0,0 +1,259 @@
+/*
+ * @file interpolate.c
+ * @brief batch LED frame interpolation
+ * @details for raspberry pi 3B+ and x86 test hosts
+ * interpolateColor() is (color * (max - pos) + nextcolor * pos) / max. Every channel of a frame
+ * shares pos and max, so the divide becomes a multiply by ceil(2^shift / max) and a shift. With
+ * shift = 8 + 2 * ceil(log2(max)) the rounding error of the reciprocal times the largest numerator
+ * (255 * max) stays under one part in max, so the quotient is the same as the integer divide.
+ * The weights are 16 bit multiplies and the reciprocal a 32 x 32 to 64 bit multiply, NEON and
+ * SSE2 do four pixels at a time, AVX2 eight. Anything over INTERPOLATE_VECTOR_MAX steps divides.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define INTERPOLATE_NEON
+#endif
+
+#include "interpolate.h"
+
+#define COLOR_MASK 0x00FFFFFF
+
+/*
+ * @brief interpolate_weight(interpolateweight_t *w, int pos, int max)
+ * @details weights and reciprocal for step pos of max, recip is 0 when the steps are too many for
+ * the vector paths and the kernels fall back to dividing
+ */
+void interpolate_weight(interpolateweight_t *w, int pos, int max)
+{
+    uint32_t bits = (max > 1) ? 32 - __builtin_clz((uint32_t) max - 1) : 0;
+
+    w->from = max - pos;
+    w->to = pos;
+    w->max = max;
+    w->shift = 8 + (2 * bits);
+    w->recip = (max <= INTERPOLATE_VECTOR_MAX) ? (uint32_t) (((1ULL << w->shift) + max - 1) / max) : 0;
+}
+
+static void blend_scalar(uint32_t *out, const uint32_t *from, const uint32_t *to, uint32_t count,
+    const interpolateweight_t *w)
+{
+    if (w->recip == 0) {
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t pixel = 0;
+            for (int c = 0; c < 24; c += 8) {
+                uint32_t n = (((from[i] >> c) & 0xFF) * w->from) + (((to[i] >> c) & 0xFF) * w->to);
+                pixel |= (n / w->max) << c;
+            }
+            out[i] = pixel;
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t pixel = 0;
+        for (int c = 0; c < 24; c += 8) {
+            uint32_t n = (((from[i] >> c) & 0xFF) * w->from) + (((to[i] >> c) & 0xFF) * w->to);
+            pixel |= (uint32_t) ((n * (uint64_t) w->recip) >> w->shift) << c;
+        }
+        out[i] = pixel;
+    }
+}
+
+#if defined(__SSE2__)
+/* one pixel, channels interleaved from/to as 16 bit pairs, returns the four channels as 32 bits */
+static inline __m128i sse2_scale(__m128i pairs, __m128i weight, __m128i recip, __m128i shift)
+{
+    __m128i n = _mm_madd_epi16(pairs, weight);
+    __m128i even = _mm_srl_epi64(_mm_mul_epu32(n, recip), shift);
+    __m128i odd = _mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(n, 32), recip), shift);
+    return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+}
+
+static void blend_sse2(uint32_t *out, const uint32_t *from, const uint32_t *to, uint32_t count,
+    const interpolateweight_t *w)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weight = _mm_set1_epi32((int32_t) ((w->to << 16) | w->from));
+    const __m128i recip = _mm_set1_epi32((int32_t) w->recip);
+    const __m128i shift = _mm_cvtsi32_si128((int) w->shift);
+    const __m128i mask = _mm_set1_epi32(COLOR_MASK);
+    uint32_t i = 0;
+
+    if (w->recip != 0) {
+        for (; i + 4 <= count; i += 4) {
+            __m128i f = _mm_loadu_si128((const __m128i *) &from[i]);
+            __m128i t = _mm_loadu_si128((const __m128i *) &to[i]);
+            __m128i flo = _mm_unpacklo_epi8(f, zero);
+            __m128i fhi = _mm_unpackhi_epi8(f, zero);
+            __m128i tlo = _mm_unpacklo_epi8(t, zero);
+            __m128i thi = _mm_unpackhi_epi8(t, zero);
+            __m128i p0 = sse2_scale(_mm_unpacklo_epi16(flo, tlo), weight, recip, shift);
+            __m128i p1 = sse2_scale(_mm_unpackhi_epi16(flo, tlo), weight, recip, shift);
+            __m128i p2 = sse2_scale(_mm_unpacklo_epi16(fhi, thi), weight, recip, shift);
+            __m128i p3 = sse2_scale(_mm_unpackhi_epi16(fhi, thi), weight, recip, shift);
+            __m128i q = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+            _mm_storeu_si128((__m128i *) &out[i], _mm_and_si128(q, mask));
+        }
+    }
+    blend_scalar(&out[i], &from[i], &to[i], count - i, w);
+}
+
+/* the same again eight pixels wide, unpack and pack stay within each 128 bit lane so order holds */
+__attribute__((target("avx2")))
+static inline __m256i avx2_scale(__m256i pairs, __m256i weight, __m256i recip, __m128i shift)
+{
+    __m256i n = _mm256_madd_epi16(pairs, weight);
+    __m256i even = _mm256_srl_epi64(_mm256_mul_epu32(n, recip), shift);
+    __m256i odd = _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(n, 32), recip), shift);
+    return _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+}
+
+__attribute__((target("avx2")))
+static void blend_avx2(uint32_t *out, const uint32_t *from, const uint32_t *to, uint32_t count,
+    const interpolateweight_t *w)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i weight = _mm256_set1_epi32((int32_t) ((w->to << 16) | w->from));
+    const __m256i recip = _mm256_set1_epi32((int32_t) w->recip);
+    const __m128i shift = _mm_cvtsi32_si128((int) w->shift);
+    const __m256i mask = _mm256_set1_epi32(COLOR_MASK);
+    uint32_t i = 0;
+
+    if (w->recip != 0) {
+        for (; i + 8 <= count; i += 8) {
+            __m256i f = _mm256_loadu_si256((const __m256i *) &from[i]);
+            __m256i t = _mm256_loadu_si256((const __m256i *) &to[i]);
+            __m256i flo = _mm256_unpacklo_epi8(f, zero);
+            __m256i fhi = _mm256_unpackhi_epi8(f, zero);
+            __m256i tlo = _mm256_unpacklo_epi8(t, zero);
+            __m256i thi = _mm256_unpackhi_epi8(t, zero);
+            __m256i p0 = avx2_scale(_mm256_unpacklo_epi16(flo, tlo), weight, recip, shift);
+            __m256i p1 = avx2_scale(_mm256_unpackhi_epi16(flo, tlo), weight, recip, shift);
+            __m256i p2 = avx2_scale(_mm256_unpacklo_epi16(fhi, thi), weight, recip, shift);
+            __m256i p3 = avx2_scale(_mm256_unpackhi_epi16(fhi, thi), weight, recip, shift);
+            __m256i q = _mm256_packus_epi16(_mm256_packs_epi32(p0, p1), _mm256_packs_epi32(p2, p3));
+            _mm256_storeu_si256((__m256i *) &out[i], _mm256_and_si256(q, mask));
+        }
+    }
+    blend_sse2(&out[i], &from[i], &to[i], count - i, w);
+}
+#endif
+
+#if defined(INTERPOLATE_NEON)
+/* four channels of one pixel, widened to 32 bits for the weights and 64 bits for the reciprocal */
+static inline uint16x4_t neon_scale(uint16x4_t f, uint16x4_t t, const interpolateweight_t *w, int64x2_t shift)
+{
+    uint32x4_t n = vmlal_n_u16(vmull_n_u16(f, (uint16_t) w->from), t, (uint16_t) w->to);
+    uint64x2_t lo = vshlq_u64(vmull_n_u32(vget_low_u32(n), w->recip), shift);
+    uint64x2_t hi = vshlq_u64(vmull_n_u32(vget_high_u32(n), w->recip), shift);
+    return vmovn_u32(vcombine_u32(vmovn_u64(lo), vmovn_u64(hi)));
+}
+
+static void blend_neon(uint32_t *out, const uint32_t *from, const uint32_t *to, uint32_t count,
+    const interpolateweight_t *w)
+{
+    const int64x2_t shift = vdupq_n_s64(-(int64_t) w->shift);
+    const uint32x4_t mask = vdupq_n_u32(COLOR_MASK);
+    uint32_t i = 0;
+
+    if (w->recip != 0) {
+        for (; i + 4 <= count; i += 4) {
+            uint8x16_t f = vreinterpretq_u8_u32(vld1q_u32(&from[i]));
+            uint8x16_t t = vreinterpretq_u8_u32(vld1q_u32(&to[i]));
+            uint16x8_t flo = vmovl_u8(vget_low_u8(f));
+            uint16x8_t fhi = vmovl_u8(vget_high_u8(f));
+            uint16x8_t tlo = vmovl_u8(vget_low_u8(t));
+            uint16x8_t thi = vmovl_u8(vget_high_u8(t));
+            uint16x4_t p0 = neon_scale(vget_low_u16(flo), vget_low_u16(tlo), w, shift);
+            uint16x4_t p1 = neon_scale(vget_high_u16(flo), vget_high_u16(tlo), w, shift);
+            uint16x4_t p2 = neon_scale(vget_low_u16(fhi), vget_low_u16(thi), w, shift);
+            uint16x4_t p3 = neon_scale(vget_high_u16(fhi), vget_high_u16(thi), w, shift);
+            uint8x16_t q = vcombine_u8(vmovn_u16(vcombine_u16(p0, p1)), vmovn_u16(vcombine_u16(p2, p3)));
+            vst1q_u32(&out[i], vandq_u32(vreinterpretq_u32_u8(q), mask));
+        }
+    }
+    blend_scalar(&out[i], &from[i], &to[i], count - i, w);
+}
+#endif
+
+/* kernels this cpu can run, best last */
+static interpolatekernel_t kernels[4];
+static int kernelCount;
+static pthread_once_t kernelOnce = PTHREAD_ONCE_INIT;
+
+static void selectKernels(void)
+{
+    kernels[kernelCount++] = (interpolatekernel_t) {.name = "scalar", .blend = blend_scalar};
+#if defined(INTERPOLATE_NEON)
+    kernels[kernelCount++] = (interpolatekernel_t) {.name = "neon", .blend = blend_neon};
+#endif
+#if defined(__SSE2__)
+    kernels[kernelCount++] = (interpolatekernel_t) {.name = "sse2", .blend = blend_sse2};
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels[kernelCount++] = (interpolatekernel_t) {.name = "avx2", .blend = blend_avx2};
+    }
+#endif
+}
+
+/*
+ * @brief interpolate_kernels(const interpolatekernel_t **list)
+ * @return number of kernels in list, the last is the one interpolate_frame() uses
+ */
+int interpolate_kernels(const interpolatekernel_t **list)
+{
+    pthread_once(&kernelOnce, selectKernels);
+    *list = kernels;
+    return kernelCount;
+}
+
+const interpolatekernel_t *interpolate_kernel(void)
+{
+    pthread_once(&kernelOnce, selectKernels);
+    return &kernels[kernelCount - 1];
+}
+
+/*
+ * @brief interpolate_frame(out, from, to, count, pos, max)
+ * @details out[i] = interpolateRGB(from[i], to[i], pos, max) for count pixels, the top byte is 0
+ */
+void interpolate_frame(uint32_t *out, const uint32_t *from, const uint32_t *to, uint32_t count, int pos, int max)
+{
+    interpolateweight_t w;
+    interpolate_weight(&w, pos, max);
+    interpolate_kernel()->blend(out, from, to, count, &w);
+}
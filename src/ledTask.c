@@ -51,6 +51,18 @@
 #include "nixieclock.h"
 
 #include "ws2811.h"
+#include "backend.h"
+#include "timeline.h"
+#include "interpolate.h"
+#include "framesched.h"
+#include "reload.h"
+#include "livefeed.h"
+#include "metrics.h"
+#include "trace.h"
+#include "realtime.h"
+#include "input.h"
+#include "idle.h"
+#include "tasks.h"
 
 ws2811_t ledmodule = {
     .freq = WS2811_TARGET_FREQ,
@@ -58,7 +70,7 @@ ws2811_t ledmodule = {
     .channel = {
         [0] = {
             .gpionum = PWM1,
-            .count = LEDCOUNT,
+            .count = 0,     /* channels are set from the configured geometry */
             .invert = 0,
             .brightness = 255,
             .strip_type = SK6812_STRIP,
@@ -86,67 +98,437 @@ int32_t interpolateRGB(uint32_t color, uint32_t nextcolor, int pos, int max)
     return ((((uint32_t) r) << 16) | (((uint32_t) g) << 8) | (((uint32_t) b) << 0));
 }
 
-void *ledTask(void *threadid)
+/*
+ * @brief setChannels(const ledgeometry_t *geometry) configures the PWM channels before ws2811_init
+ */
+static void setChannels(const ledgeometry_t *geometry)
+{
+    for (int c = 0; c < LEDCHANNELS; c++) {
+        ws2811_channel_t *channel = &ledmodule.channel[c];
+        const ledchannel_t *config = &geometry->channel[c];
+        channel->gpionum = (config->count > 0) ? config->gpio : 0;
+        channel->count = config->count;
+        channel->invert = 0;
+        channel->brightness = config->brightness;
+        channel->strip_type = config->strip;
+    }
+}
+
+/*
+ * @brief brightnessInput() takes the input queued for the LEDs, UP and DOWN step the brightness
+ * of every strip by LEDBRIGHTNESS_STEP
+ * @return true if the brightness changed and the strips have to be sent again
+ */
+static bool brightnessInput(void)
+{
+    inputevent_t event;
+    bool changed = false;
+    int step;
+
+    while (input_take(INPUT_LED, &event)) {
+        if ((event.type != INPUT_PRESS) && (event.type != INPUT_REPEAT)) continue;
+        if (event.line == INPUT_UP) {
+            step = LEDBRIGHTNESS_STEP;
+        } else if (event.line == INPUT_DOWN) {
+            step = -LEDBRIGHTNESS_STEP;
+        } else {
+            continue;
+        }
+        for (int c = 0; c < LEDCHANNELS; c++) {
+            ws2811_channel_t *channel = &ledmodule.channel[c];
+            int brightness = channel->brightness + step;
+            if (channel->count == 0) continue;
+            if (brightness < 0) brightness = 0;
+            if (brightness > 255) brightness = 255;
+            if (brightness != channel->brightness) changed = true;
+            channel->brightness = brightness;
+        }
+    }
+    return changed;
+}
+
+/*
+ * @brief copyFrame(const uint32_t *frame) splits a frame across the channels, the first channel
+ * takes the first LEDs. Both are filled before the one ws2811_render() that sends them.
+ * @return true if any LED differs from the frame already on the strips
+ */
+static bool copyFrame(const uint32_t *frame)
 {
+    bool changed = false;
+    for (int c = 0; c < LEDCHANNELS; c++) {
+        ws2811_channel_t *channel = &ledmodule.channel[c];
+        size_t size = channel->count * sizeof(ws2811_led_t);
+        if (channel->count == 0) continue;
+        if (memcmp(channel->leds, frame, size) != 0) {
+            memcpy(channel->leds, frame, size);
+            changed = true;
+        }
+        frame += channel->count;
+    }
+    return changed;
+}
+
+/*
+ * @brief clearLeds() turns every LED off
+ * @return WS2811_SUCCESS or the render failure
+ */
+static ws2811_return_t clearLeds(void)
+{
+    for (int c = 0; c < LEDCHANNELS; c++) {
+        if (ledmodule.channel[c].count > 0) memset(ledmodule.channel[c].leds, 0, ledmodule.channel[c].count * sizeof(ws2811_led_t));
+    }
+    return backend->led_render(&ledmodule);
+}
+
+/* where the roll is, either stepping through the records or through the compiled timeline */
+typedef struct {
+    const ledrollhead_t *roll;
+    const ledtimeline_t *timeline;  /* NULL to interpolate each step */
+    uint32_t *scratch;              /* one frame, fades are blended here and compared to the strips */
+    int record;                     /* record, or timeline frame, being shown */
+    uint32_t step;                  /* step of a slow record */
+    int64_t start;                  /* start of the record, nanoseconds from the start of the roll */
+    int64_t at;                     /* deadline of this frame */
+    int64_t until;                  /* deadline of the frame after it */
+} ledplayer_t;
+
+static void playerDeadline(ledplayer_t *pl)
+{
+    if (pl->timeline != NULL) {
+        const ledtimeline_t *tl = pl->timeline;
+        pl->at = pl->start + tl->offset[pl->record];
+        pl->until = pl->start + ((pl->record + 1 < tl->count) ? tl->offset[pl->record + 1] : tl->period);
+    } else {
+        const ledroll_t *p = &pl->roll->roll[pl->record];
+        pl->at = pl->start + ledroll_offset(p, pl->step);
+        pl->until = pl->start + ledroll_offset(p, pl->step + 1);
+    }
+}
+
+static int playerStart(ledplayer_t *pl, const ledrollhead_t *roll)
+{
+    pl->roll = roll;
+    pl->timeline = roll->timeline;
+    pl->scratch = (uint32_t *) aligned_alloc(LEDFRAME_ALIGN, roll->geometry.stride * sizeof(uint32_t));
+    if (pl->scratch == NULL) return -1;
+    pl->record = 0;
+    pl->step = 0;
+    pl->start = 0;
+    playerDeadline(pl);
+    return 0;
+}
+
+/*
+ * @brief playerSwap(ledplayer_t *pl, const ledrollhead_t *roll) starts a reloaded roll from its
+ * first record on the deadline the frame after this one would have had, the geometry is the same
+ */
+static void playerSwap(ledplayer_t *pl, const ledrollhead_t *roll)
+{
+    pl->roll = roll;
+    pl->timeline = roll->timeline;
+    pl->record = 0;
+    pl->step = 0;
+    pl->start = pl->at;
+    playerDeadline(pl);
+}
+
+/*
+ * @brief playerRestart(ledplayer_t *pl, int64_t now) starts the roll over from its first record now
+ */
+static void playerRestart(ledplayer_t *pl, int64_t now)
+{
+    pl->record = 0;
+    pl->step = 0;
+    pl->start = now;
+    playerDeadline(pl);
+}
+
+/*
+ * @brief playerNext(ledplayer_t *pl) moves on to the next frame of the looping roll
+ */
+static void playerNext(ledplayer_t *pl)
+{
+    if (pl->timeline != NULL) {
+        if (++pl->record >= pl->timeline->count) {
+            pl->record = 0;
+            pl->start += pl->timeline->period;
+        }
+    } else {
+        const ledroll_t *p = &pl->roll->roll[pl->record];
+        if (++pl->step >= p->steps) {
+            pl->step = 0;
+            pl->start += ledroll_offset(p, p->steps);
+            if (++pl->record >= pl->roll->count) pl->record = 0;
+        }
+    }
+    playerDeadline(pl);
+}
+
+/*
+ * @brief playerShow(const ledplayer_t *pl) fills the channels with the current frame
+ * @return true if the frame is different from the last one sent
+ */
+static bool playerShow(const ledplayer_t *pl)
+{
+    const ledrollhead_t *roll = pl->roll;
+    const ledroll_t *p;
+    int next;
+
+    if (pl->timeline != NULL) return copyFrame(timeline_frame(pl->timeline, pl->record));
+    p = &roll->roll[pl->record];
+    if (p->isFast) return copyFrame(ledroll_color(roll, pl->record));
+    next = (pl->record + 1 < roll->count) ? pl->record + 1 : 0;
+    interpolate_frame(pl->scratch, ledroll_color(roll, pl->record), ledroll_color(roll, next), roll->geometry.count,
+        pl->step, p->steps);
+    return copyFrame(pl->scratch);
+}
+
+/* the roll being played and what is on the strips */
+struct ledstate {
+    ledrollhead_t *roll;
+    ledplayer_t player;
+    bool first;                     /* nothing has been sent yet, or the clock has just woken */
+    bool parked;                    /* the strips are black while the clock is idle */
+    const uint32_t *live;           /* live frame waiting for its presentation time */
+    int64_t liveAt;
+    int64_t liveUntil;              /* the roll is not shown before this */
+    int64_t origin;                 /* CLOCK_MONOTONIC time of the start */
+};
+
+/*
+ * @brief renderFailed(ws2811_return_t rv) reports a render that did not go and asks everything to stop
+ * @return -1
+ */
+static int renderFailed(ws2811_return_t rv)
+{
+    fprintf(stderr,"ws2811_render failed: %s\n", backend->led_error(rv));
+    notifyToTerminate();
+    return -1;
+}
+
+/*
+ * @brief ledtask_open(ledrollhead_t *roll, framesched_t *fs) sets up the strips for the roll and
+ * starts it from its first record
+ * @return the roll being played, NULL if it could not start and termination was asked for
+ */
+ledstate_t *ledtask_open(ledrollhead_t *roll, framesched_t *fs)
+{
+    ledstate_t *ls;
     int rv;
-    bool done = false;
-    ledroll_t *p;
-    ledroll_t *nextp;
-    int max;
-    struct timespec stepDelay = {.tv_sec = 0, .tv_nsec = (INTERPOLATE_STEP * 1000000L) }; 
-    struct timespec delay;
-    ledrollhead_t *ledrollhead;
-    
-    if ((rv = ws2811_init(&ledmodule)) != WS2811_SUCCESS) {
-        fprintf(stderr,"ws2811_init failed: %s\n", ws2811_get_return_t_str(rv));
+
+    fs->fd = -1;
+    setChannels(&roll->geometry);
+    if ((rv = backend->led_init(&ledmodule)) != WS2811_SUCCESS) {
+        fprintf(stderr,"ws2811_init failed: %s\n", backend->led_error(rv));
+        freeconfig(roll);
         notifyToTerminate();
-        pthread_exit((void *)EXIT_FAILURE);
+        return NULL;
     } 
-	ledrollhead = parseconfig();
-    if (ledrollhead == NULL) {
-        fprintf(stderr,"configuration file not valid\n");
+	setColon(roll->colon);
+    reload_ready(roll);
+    livefeed_ready(&roll->geometry);
+    ls = calloc(1, sizeof(ledstate_t));
+    if ((ls == NULL) || (framesched_open(fs, terminate.fd) < 0) || (playerStart(&ls->player, roll) < 0)) {
+        fprintf(stderr, "LED roll could not start\n");
+        framesched_close(fs);
+        free(ls);
+        backend->led_fini(&ledmodule);
+        freeconfig(roll);
         notifyToTerminate();
-        pthread_exit((void *)EXIT_FAILURE);   
+        return NULL;
+    }
+    fs->wakefd[0] = livefeed_fd();
+    fs->wakefd[1] = input_fd(INPUT_LED);
+    fs->wakefd[2] = idle_fd();
+    ls->roll = roll;
+    ls->first = true;
+    framesched_start(fs);
+    ls->origin = -framesched_since(fs, 0);
+    return ls;
+}
+
+/*
+ * @brief ledtask_deadline(const ledstate_t *ls)
+ * @return nanoseconds from the start of the next frame, a live one or the roll's, FRAMESCHED_NEVER
+ * while the strips are parked
+ */
+int64_t ledtask_deadline(const ledstate_t *ls)
+{
+    if (ls->parked) return FRAMESCHED_NEVER;
+    return ((ls->live != NULL) && (ls->liveAt < ls->player.at)) ? ls->liveAt : ls->player.at;
+}
+
+/*
+ * @brief ledtask_frame shows the roll, each frame at its deadline from the start
+ * @details when a render runs past the slot of the next frame, that frame is dropped rather than
+ * the whole roll running late. A frame the same as the one on the strips is not sent again.
+ * A reloaded roll replaces the one playing between frames. A live frame wakes it too and is shown
+ * at its presentation time, the roll keeps its place without being shown until the feed has been
+ * quiet for LIVEFEED_HOLD_MS. UP and DOWN wake it as well to change the brightness. While the clock
+ * is idle the strips are black and nothing is scheduled, the roll starts over when it wakes.
+ * @param[in] now - what framesched_wait() or framesched_due() returned, FRAMESCHED_WAKE for a wake fd
+ * @return 0, -1 if a render failed and termination was asked for
+ */
+int ledtask_frame(ledstate_t *ls, framesched_t *fs, int64_t now)
+{
+    ws2811_return_t rv;
+    ledplayer_t *player = &ls->player;
+    ledrollhead_t *reloaded;
+    const uint32_t *frame;
+    inputevent_t event;
+    int64_t present;
+    int64_t start, end;
+    bool changed;
+
+    if (idle_parked() && !ls->parked) {
+        ls->parked = true;
+        if ((rv = clearLeds()) != WS2811_SUCCESS) return renderFailed(rv);
+        fs->rendered++;
+        return 0;
+    }
+    if (ls->parked) {
+        if (idle_parked()) return 0;
+        /* the presses that woke the clock are not brightness steps */
+        while (input_take(INPUT_LED, &event));
+        ls->parked = false;
+        ls->live = NULL;
+        ls->liveUntil = 0;
+        ls->first = true;
+        playerRestart(player, framesched_now(fs));
+        return 0;
+    }
+    if (now == FRAMESCHED_WAKE) {
+        now = framesched_now(fs);
+        trace_event(TRACE_WAKE, 0);
+    } else {
+        trace_event(TRACE_WAKE, trace_ns(fs->late));
+        metric_record(&metrics.frame, fs->late);
+        metric_set(&metrics.framesLate, fs->lateFrames);
+    }
+    if (brightnessInput()) {
+        /* brightness is applied as the frame is sent, send the one on the strips again */
+        start = metric_now();
+        trace_at(TRACE_RENDER, 0, start);
+        if ((rv = backend->led_render(&ledmodule)) != WS2811_SUCCESS) return renderFailed(rv);
+        end = metric_now();
+        trace_at(TRACE_RENDER_END, 0, end);
+        metric_record(&metrics.render, end - start);
+        fs->rendered++;
     }
-	setColon(ledrollhead->colon);
-    while(!done) {
-        p = &(ledrollhead->roll[ledrollhead->pos++]);
-        if (ledrollhead->pos >= ledrollhead->count) ledrollhead->pos = 0; /* looping roll */
-        nextp = &(ledrollhead->roll[ledrollhead->pos]);
-        if (p->isFast) {
-            delay.tv_sec = p->delay/1000;
-            delay.tv_nsec = (p->delay % 1000) * 1000000L;
-            for (int i = 0; i < LEDCOUNT; i++) ledmodule.channel[0].leds[i] = p->color[i];
-            if ((rv = ws2811_render(&ledmodule)) != WS2811_SUCCESS) {
-    	        fprintf(stderr,"ws2811_render failed: %s\n", ws2811_get_return_t_str(rv));
-                notifyToTerminate();
-                break;
-            }
-            nanosleep(&delay, NULL);
+    if ((livefeed_fd() >= 0) && livefeed_take(ls->origin + now, &frame, &present)) {
+        /* the frame held for later is the feed thread's again, even when the new one came too late */
+        ls->live = frame;
+        if (frame != NULL) {
+            ls->liveAt = framesched_since(fs, present);
+            trace_event(TRACE_LIVE, 0);
+        }
+    }
+    if ((ls->live != NULL) && (ls->liveAt <= now)) {
+        if (copyFrame(ls->live)) {
+            start = metric_now();
+            trace_at(TRACE_RENDER, 0, start);
+            if ((rv = backend->led_render(&ledmodule)) != WS2811_SUCCESS) return renderFailed(rv);
+            end = metric_now();
+            trace_at(TRACE_RENDER_END, 0, end);
+            metric_record(&metrics.render, end - start);
+            fs->rendered++;
         } else {
-            max = p->delay/INTERPOLATE_STEP;
-            for (int i = 0; i < max; i++) {
-                for (int j = 0; j < LEDCOUNT; j++) {
-                    ledmodule.channel[0].leds[j] = interpolateRGB(p->color[j], nextp->color[j], i, max);
-                }
-                if ((rv = ws2811_render(&ledmodule)) != WS2811_SUCCESS) {
-    	            fprintf(stderr,"ws2811_render failed: %s\n", ws2811_get_return_t_str(rv));
-                    notifyToTerminate();
-                    break;
-                }
-                nanosleep(&stepDelay, NULL);
-            }
+            fs->suppressed++;
         }
-        done = isTerminate();
+        atomic_fetch_add_explicit(&livefeedstats.shown, 1, memory_order_relaxed);
+        ls->live = NULL;
+        ls->liveUntil = now + (LIVEFEED_HOLD_MS * 1000000LL);
+        ls->first = false;
     }
+    if (now < player->at) return 0;
+    while (player->until <= now) {
+        framesched_drop(fs);
+        playerNext(player);
+    }
+    metric_set(&metrics.framesDropped, fs->dropped);
+    if (now < ls->liveUntil) {
+        fs->suppressed++;
+    } else {
+        start = metric_now();
+        trace_at(TRACE_BUILD, 0, start);
+        changed = playerShow(player);
+        end = metric_now();
+        trace_at(TRACE_BUILD_END, changed, end);
+        metric_record(&metrics.build, end - start);
+        if (changed || ls->first) {
+            /* always send the first frame, the strips power up in an unknown state */
+            start = end;
+            trace_at(TRACE_RENDER, 0, start);
+            if ((rv = backend->led_render(&ledmodule)) != WS2811_SUCCESS) return renderFailed(rv);
+            end = metric_now();
+            trace_at(TRACE_RENDER_END, 0, end);
+            metric_record(&metrics.render, end - start);
+            fs->rendered++;
+            ls->first = false;
+        } else {
+            fs->suppressed++;
+        }
+    }
+    playerNext(player);
+    if ((reloaded = reload_take(ls->roll)) != NULL) {
+        ls->roll = reloaded;
+        playerSwap(player, reloaded);
+        setColon(reloaded->colon);
+    }
+    return 0;
+}
+
+/*
+ * @brief ledtask_close(ledstate_t *ls, framesched_t *fs) turns the strips off and lets the roll go
+ */
+void ledtask_close(ledstate_t *ls, framesched_t *fs)
+{
+    ws2811_return_t rv;
+
+    framesched_close(fs);
+    if (ls == NULL) return;
+#ifdef DEBUG
+    fprintf(stdout, "LED frames %llu rendered %llu suppressed %llu dropped %llu late %llu worst %lld usec\n",
+        (unsigned long long) fs->frames, (unsigned long long) fs->rendered, (unsigned long long) fs->suppressed,
+        (unsigned long long) fs->dropped, (unsigned long long) fs->lateFrames, (long long) fs->maxLate / 1000);
+    if (livefeed_fd() >= 0) {
+        fprintf(stdout, "live frames %llu shown %llu superseded %llu late %llu stale %llu rejected messages %llu\n",
+            (unsigned long long) livefeedstats.frames, (unsigned long long) livefeedstats.shown,
+            (unsigned long long) livefeedstats.superseded, (unsigned long long) livefeedstats.late,
+            (unsigned long long) livefeedstats.stale, (unsigned long long) livefeedstats.rejected);
+    }
+#endif
     /* to finish, turn off all LEDs */
-    for (int i = 0; i < LEDCOUNT; i++) ledmodule.channel[0].leds[i] = 0;
-    if ((rv = ws2811_render(&ledmodule)) != WS2811_SUCCESS) {
-    	fprintf(stderr,"ws2811_render failed: %s\n", ws2811_get_return_t_str(rv));
+    if ((rv = clearLeds()) != WS2811_SUCCESS) renderFailed(rv);
+    backend->led_fini(&ledmodule);
+    free(ls->player.scratch);
+    freeconfig(ls->roll);
+    free(ls);
+}
+
+void *ledTask(void *threadid)
+{
+    ledrollhead_t *ledrollhead;
+    framesched_t sched;
+    ledstate_t *ls;
+    int64_t now;
+    
+    trace_thread("led");
+    realtime_thread(RT_LED);
+    /* the strip length comes from the configuration, main has usually read it already */
+	ledrollhead = (threadid != NULL) ? (ledrollhead_t *) threadid : loadconfig();
+    if (ledrollhead == NULL) {
+        fprintf(stderr,"configuration file not valid\n");
         notifyToTerminate();
+        pthread_exit((void *)EXIT_FAILURE);   
+    }
+    if ((ls = ledtask_open(ledrollhead, &sched)) == NULL) pthread_exit((void *)EXIT_FAILURE);
+    while (!isTerminate()) {
+        trace_event(TRACE_SLEEP, 0);
+        now = framesched_wait(&sched, ledtask_deadline(ls));
+        if (now == FRAMESCHED_STOP) break;
+        if (ledtask_frame(ls, &sched, now) < 0) break;
     }
-    ws2811_fini(&ledmodule);
-    free(ledrollhead->roll);
-    free(ledrollhead);
+    ledtask_close(ls, &sched);
     return NULL;
-}
\ No newline at end of file
+}
@@ -0,0 +1,405 @@
+/*
+ * @file livefeed.c
+ * @brief receives live LED frames on a unix socket and hands them to the render loop
+ * @details for raspberry pi 3B+
+ * One thread accepts producers and reads their messages LIVEFEED_BATCH at a time with recvmmsg.
+ * Pixel ranges are written into the producer's own frame in strip order. When a batch completes one
+ * or more frames only the newest is copied into the back buffer and published, the ones before it
+ * were already out of date. The render loop swaps the ready buffer for its own with one atomic
+ * exchange, neither side ever waits for the other. Backpressure is the socket itself, a unix socket
+ * charges queued messages to the sender's send buffer and a producer that fills it blocks in send().
+ * The same thread reads the E1.31 and Art-Net sockets when DMX input is on, see dmxfeed.c.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "nixieclock.h"
+#include "livefeed.h"
+#include "reload.h"
+#include "dmxfeed.h"
+#include "realtime.h"
+
+/* poll slots of the feed thread, the producers follow */
+#define FEED_LISTEN 0
+#define FEED_TERMINATE 1
+#define FEED_E131 2
+#define FEED_ARTNET 3
+#define FEED_CLIENTS 4
+
+/* exchange holds the index of the ready buffer, LIVEFEED_FRESH while the render loop has not taken it */
+#define LIVEFEED_FRESH 4U
+#define LIVEFEED_INDEX 3U
+
+const char *livefeedPath = NULL;
+livefeedstats_t livefeedstats;
+
+static int wakefd = -1;
+static atomic_bool ready = false;
+static ledgeometry_t geometry;          /* written once before ready is set */
+
+static uint32_t *frames[3];
+static int64_t presents[3];
+static atomic_uint exchange = 1;
+static unsigned back = 0;               /* owned by the feed thread */
+static unsigned front = 2;              /* owned by the render loop */
+
+typedef struct {
+    int fd;
+    uint32_t *frame;                    /* ranges are assembled here, LEDs not sent keep their color */
+    uint32_t sequence;                  /* last frame published from this producer */
+    bool started;                       /* sequence is valid */
+} livefeedclient_t;
+
+static inline int64_t monotonic(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+/*
+ * @brief livefeed_open() creates the eventfd that wakes the render loop for a new frame
+ * @return 0, or -1 if the feed is on and the eventfd can not be made
+ */
+int livefeed_open(void)
+{
+    if ((livefeedPath == NULL) && (dmxUniverse == 0)) return 0;
+    wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakefd < 0) {
+        fprintf(stderr, "unable to create the live feed eventfd: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief livefeed_fd() for the frame scheduler to wait on along with its deadline
+ * @return eventfd that becomes readable when a frame is published, -1 if the feed is off
+ */
+int livefeed_fd(void)
+{
+    return wakefd;
+}
+
+/*
+ * @brief livefeed_ready(const ledgeometry_t *geometry) called by ledTask once the strips are set up,
+ * the feed thread sizes its frames from it and starts listening
+ */
+void livefeed_ready(const ledgeometry_t *active)
+{
+    geometry = *active;
+    atomic_store_explicit(&ready, true, memory_order_release);
+}
+
+/*
+ * @brief livefeed_take(int64_t now, const uint32_t **frame, int64_t *present) called by the render loop
+ * @details takes the newest published frame, the frame taken before it goes back to the feed thread
+ * and must not be used any more. A frame more than LIVEFEED_LATE past its presentation time is dropped,
+ * the one before it has still gone back.
+ * @param[in] now - CLOCK_MONOTONIC nanoseconds
+ * @param[out] frame - the frame in strip order, NULL if it was too late
+ * @param[out] present - CLOCK_MONOTONIC nanoseconds to show the frame at, now if it is due
+ * @return true if a new frame was taken, false if nothing new was published and the frame taken
+ * before can still be used
+ */
+bool livefeed_take(int64_t now, const uint32_t **frame, int64_t *present)
+{
+    unsigned old;
+
+    if (!(atomic_load_explicit(&exchange, memory_order_relaxed) & LIVEFEED_FRESH)) return false;
+    old = atomic_exchange_explicit(&exchange, front, memory_order_acq_rel);
+    front = old & LIVEFEED_INDEX;
+    *frame = frames[front];
+    *present = presents[front];
+    if (*present == 0 || *present < now) {
+        if ((*present != 0) && (now - *present > LIVEFEED_LATE)) {
+            atomic_fetch_add_explicit(&livefeedstats.late, 1, memory_order_relaxed);
+            *frame = NULL;
+        }
+        *present = now;
+    }
+    return true;
+}
+
+/*
+ * @brief publish copies the assembled frame into the back buffer and makes it the ready one
+ */
+static void publish(const uint32_t *frame, int64_t present)
+{
+    uint64_t one = 1;
+    unsigned old;
+
+    memcpy(frames[back], frame, geometry.stride * sizeof(uint32_t));
+    presents[back] = present;
+    old = atomic_exchange_explicit(&exchange, back | LIVEFEED_FRESH, memory_order_acq_rel);
+    back = old & LIVEFEED_INDEX;
+    if (old & LIVEFEED_FRESH) atomic_fetch_add_explicit(&livefeedstats.superseded, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&livefeedstats.frames, 1, memory_order_relaxed);
+    if (write(wakefd, &one, sizeof(one)) < 0) return; /* already readable */
+}
+
+/*
+ * @brief validate copies out the header of a message
+ * @return 0 or -1 if the message is not valid for this geometry
+ */
+static int validate(livefeedheader_t *h, const struct mmsghdr *msg)
+{
+    size_t length = msg->msg_len;
+
+    if ((msg->msg_hdr.msg_flags & MSG_TRUNC) || (length < sizeof(*h))) return -1;
+    memcpy(h, msg->msg_hdr.msg_iov->iov_base, sizeof(*h));
+    if (h->magic != LIVEFEED_MAGIC || h->version != LIVEFEED_VERSION || h->format > LIVEFEED_GRB) return -1;
+    if ((uint64_t) h->start + h->count > geometry.count || length != sizeof(*h) + ((size_t) h->count * 3)) return -1;
+    return 0;
+}
+
+/*
+ * @brief decode writes one message's pixel range into frame
+ */
+static void decode(uint32_t *frame, const livefeedheader_t *h, const uint8_t *message)
+{
+    const uint8_t *p = message + sizeof(*h);
+
+    if (h->format == LIVEFEED_RGB) {
+        for (uint32_t i = h->start; i < h->start + h->count; i++, p += 3) {
+            frame[ledposition(&geometry, i)] = ((uint32_t) p[0] << 16) | ((uint32_t) p[1] << 8) | p[2];
+        }
+    } else {
+        for (uint32_t i = h->start; i < h->start + h->count; i++, p += 3) {
+            frame[ledposition(&geometry, i)] = ((uint32_t) p[1] << 16) | ((uint32_t) p[0] << 8) | p[2];
+        }
+    }
+}
+
+static inline bool newer(const livefeedclient_t *client, uint32_t sequence)
+{
+    return !client->started || ((int32_t) (sequence - client->sequence) > 0);
+}
+
+/*
+ * @brief superseded looks further into the batch for a later frame that replaces this one
+ */
+static bool superseded(const struct mmsghdr *msgs, int from, int n, uint32_t sequence)
+{
+    livefeedheader_t h;
+
+    for (int i = from; i < n; i++) {
+        if ((msgs[i].msg_len == 0) || (validate(&h, &msgs[i]) < 0)) continue;
+        if ((h.flags & LIVEFEED_END) && ((int32_t) (h.sequence - sequence) > 0)) return true;
+    }
+    return false;
+}
+
+/*
+ * @brief receive reads everything queued on a producer, a batch of messages per system call
+ * @return 0, or -1 when the producer has gone
+ */
+static int receive(livefeedclient_t *client, uint8_t *buffers, size_t size)
+{
+    struct mmsghdr msgs[LIVEFEED_BATCH];
+    struct iovec iov[LIVEFEED_BATCH];
+    livefeedheader_t h;
+    int n;
+
+    for (int i = 0; i < LIVEFEED_BATCH; i++) {
+        iov[i].iov_base = buffers + (i * size);
+        iov[i].iov_len = size;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    do {
+        n = recvmmsg(client->fd, msgs, LIVEFEED_BATCH, MSG_DONTWAIT, NULL);
+        if (n < 0) return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) ? 0 : -1;
+        for (int i = 0; i < n; i++) {
+            /* an empty message on a seqpacket socket is the producer closing it */
+            if (msgs[i].msg_len == 0) return -1;
+            if (validate(&h, &msgs[i]) < 0) {
+                atomic_fetch_add_explicit(&livefeedstats.rejected, 1, memory_order_relaxed);
+                continue;
+            }
+            /* every range of an old frame is dropped, not just the one that ends it */
+            if (!newer(client, h.sequence)) {
+                if (h.flags & LIVEFEED_END) atomic_fetch_add_explicit(&livefeedstats.stale, 1, memory_order_relaxed);
+                continue;
+            }
+            decode(client->frame, &h, iov[i].iov_base);
+            atomic_fetch_add_explicit(&livefeedstats.messages, 1, memory_order_relaxed);
+            if (!(h.flags & LIVEFEED_END)) continue;
+            client->sequence = h.sequence;
+            client->started = true;
+            /* published before the ranges of the next frame go into it, unless that frame is here too */
+            if (superseded(msgs, i + 1, n, h.sequence)) {
+                atomic_fetch_add_explicit(&livefeedstats.superseded, 1, memory_order_relaxed);
+            } else {
+                publish(client->frame, h.present);
+            }
+        }
+    } while (n == LIVEFEED_BATCH);
+    return 0;
+}
+
+static int listenfeed(void)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(livefeedPath) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "live feed socket path %s is too long\n", livefeedPath);
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fprintf(stderr, "unable to create the live feed socket: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, livefeedPath);
+    unlink(livefeedPath);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, LIVEFEED_CLIENTS) < 0) {
+        fprintf(stderr, "unable to listen on %s: %s\n", livefeedPath, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    /* the owner and group can feed frames, chgrp the socket to let a user's visualizer in */
+    chmod(livefeedPath, 0660);
+    return fd;
+}
+
+void *livefeedTask(void *threadid)
+{
+    struct pollfd fds[FEED_CLIENTS + LIVEFEED_CLIENTS];
+    const uint32_t *dmx;
+    livefeedclient_t clients[LIVEFEED_CLIENTS];
+    size_t size;
+    uint8_t *buffers = NULL;
+    uint32_t *assembly = NULL;
+    int fd;
+
+    while (!atomic_load_explicit(&ready, memory_order_acquire)) {
+        if (terminateWait(RELOAD_POLL_MS)) return NULL;
+    }
+    realtime_thread(RT_FEED);
+    for (int i = 0; i < FEED_CLIENTS + LIVEFEED_CLIENTS; i++) {
+        fds[i].fd = -1;
+        fds[i].events = POLLIN;
+    }
+    for (int i = 0; i < LIVEFEED_CLIENTS; i++) clients[i].fd = -1;
+    size = sizeof(livefeedheader_t) + ((size_t) geometry.count * 3);
+    buffers = (uint8_t *) malloc(LIVEFEED_BATCH * size);
+    /* stride is a multiple of LEDFRAME_ALIGN so every producer's frame stays aligned */
+    assembly = (uint32_t *) aligned_alloc(LEDFRAME_ALIGN, LIVEFEED_CLIENTS * geometry.stride * sizeof(uint32_t));
+    for (int i = 0; i < 3; i++) frames[i] = (uint32_t *) aligned_alloc(LEDFRAME_ALIGN, geometry.stride * sizeof(uint32_t));
+    if (buffers == NULL || assembly == NULL || frames[0] == NULL || frames[1] == NULL || frames[2] == NULL) {
+        fprintf(stderr, "Out of memory for the live feed\n");
+        goto done;
+    }
+    fds[FEED_TERMINATE].fd = terminate.fd;
+    if (dmxUniverse != 0) {
+        if (dmxfeed_open(&geometry, &fds[FEED_E131].fd, &fds[FEED_ARTNET].fd) < 0) goto done;
+    }
+    if (livefeedPath != NULL) {
+        if ((fds[FEED_LISTEN].fd = listenfeed()) < 0) goto done;
+        fprintf(stdout, "live LED frames on %s\n", livefeedPath);
+    }
+    while (!isTerminate()) {
+        if (poll(fds, FEED_CLIENTS + LIVEFEED_CLIENTS, -1) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "live feed poll failed: %s\n", strerror(errno));
+            break;
+        }
+        if (fds[FEED_TERMINATE].revents & POLLIN) break;
+        for (int i = FEED_E131; i <= FEED_ARTNET; i++) {
+            if ((fds[i].revents & POLLIN) && ((dmx = dmxfeed_receive(fds[i].fd)) != NULL)) publish(dmx, 0);
+        }
+        for (int i = 0; i < LIVEFEED_CLIENTS; i++) {
+            livefeedclient_t *client = &clients[i];
+            if ((client->fd < 0) || (fds[FEED_CLIENTS + i].revents == 0)) continue;
+            if ((receive(client, buffers, size) < 0) || (fds[FEED_CLIENTS + i].revents & (POLLHUP | POLLERR))) {
+                close(client->fd);
+                client->fd = -1;
+                fds[FEED_CLIENTS + i].fd = -1;
+            }
+        }
+        if (fds[FEED_LISTEN].revents & POLLIN) {
+            while ((fd = accept4(fds[FEED_LISTEN].fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                int i;
+                for (i = 0; (i < LIVEFEED_CLIENTS) && (clients[i].fd >= 0); i++);
+                if (i == LIVEFEED_CLIENTS) {
+                    close(fd);
+                    continue;
+                }
+                /* a new producer starts from black, not from what the last one on this slot sent */
+                clients[i] = (livefeedclient_t) {.fd = fd, .frame = assembly + (i * geometry.stride),
+                    .sequence = 0, .started = false};
+                memset(clients[i].frame, 0, geometry.stride * sizeof(uint32_t));
+                fds[FEED_CLIENTS + i].fd = fd;
+            }
+        }
+    }
+    for (int i = 0; i < LIVEFEED_CLIENTS; i++) {
+        if (clients[i].fd >= 0) close(clients[i].fd);
+    }
+done:
+    if (fds[FEED_LISTEN].fd >= 0) {
+        close(fds[FEED_LISTEN].fd);
+        unlink(livefeedPath);
+    }
+    dmxfeed_close();
+    free(buffers);
+    free(assembly);
+    return NULL;
+}
+
+/*
+ * @brief livefeed_close() after every thread has been joined
+ */
+void livefeed_close(void)
+{
+    for (int i = 0; i < 3; i++) {
+        free(frames[i]);
+        frames[i] = NULL;
+    }
+    if (wakefd >= 0) close(wakefd);
+    wakefd = -1;
+}
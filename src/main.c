@@ -26,6 +26,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sys/eventfd.h>
 
 #include "nixieclock.h"
 
@@ -33,66 +34,204 @@
 #include "nixieclock.h"
 #include "spipi.h"
 
+#include "tzcache.h"
+#include "backend.h"
+#include "reload.h"
+#include "livefeed.h"
+#include "dmxfeed.h"
+#include "metrics.h"
+#include "trace.h"
+#include "realtime.h"
+#include "idle.h"
+#include "tubefx.h"
+#include "input.h"
+#include "reactor.h"
+
 #include "ws2811.h"
 
 #define PID_FILENAME "/run/pixie.pid"
-/* CONSIDERATE_SLEEP is the time in nanoseconds that this daemon should yield before waking up again. 
- * it needs to wake up prior to next second or the clock misses a beat
- * I measured about 130usec is actually how long a raspberry pi took to wake up so this should be a healthy margin
- * your mileage may vary. If it skips seconds, this may be adjusted down. 
+/* the time conversion self test starts this many years back and runs TZTEST_YEARS by default */
+#define TZTEST_BACK 2
+#define TZTEST_YEARS 8
+/* The clock no longer sleeps short of the second and spins for it to change, timeTask blocks on a
+ * realtime timerfd armed on the second boundary (see ticker.c) and gets re-armed if the clock is stepped.
  */
  /* global - not to be change anywhere except in main */
-terminate_t terminate = {.mutex = PTHREAD_MUTEX_INITIALIZER, .kill = false};
+terminate_t terminate = {.kill = false, .fd = -1};
 static struct sigaction new_action, old_action;
 
-colonEnum_t colon = COLON_ON;
-void setColon(bool thisColon) {
-    colon = thisColon;
-}
-
-bool nextColon(bool thisColon) 
-{
-    if (colon == COLON_ON) return true;
-    if (colon == COLON_BLINK) return !thisColon;
-    return false;
-}
+bool nixieTest = true;
+const backend_t *backend = &backend_hw;
 
 /* non-global */
 pthread_attr_t attributes;
 pthread_t timeThread;
 pthread_t ledThread;
+pthread_t reloadThread;
+pthread_t livefeedThread;
+pthread_t metricsThread;
+pthread_t inputThread;
+pthread_t tubeThread;
+/* the clock and the LEDs on one thread instead of two, see reactor.h */
+static bool reactorMode = false;
     
 void terminator_handler(int signum)
 {
     notifyToTerminate();
 }
 
+/* SIGHUP reads LEDcolor.json again without restarting, see reload.c */
+void reload_handler(int signum)
+{
+    reload_request();
+}
+
 static struct sigaction new_action, old_action;
 
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n] [-s] [-e] [-t[years]] [-l[socket]] [-u[universe]] [-m[file]]\n", name);
+    fprintf(stderr, "  -n  skip the startup tube test\n");
+    fprintf(stderr, "  -s  simulate the SPI, GPIO and LED hardware instead of driving it\n");
+    fprintf(stderr, "  -e  run the clock and the LEDs from one thread on a single epoll set\n");
+    fprintf(stderr, "  -t  check the time conversion cache against localtime() and exit\n");
+    fprintf(stderr, "  -l  show live LED frames sent to the socket, %s by default\n", LIVEFEED_PATH);
+    fprintf(stderr, "  -u  show E1.31 and Art-Net DMX from this universe on, 1 by default\n");
+    fprintf(stderr, "  -m  write Prometheus metrics to the file every second, %s by default\n", METRICS_PATH);
+}
+
 int main(int argc, char *argv[])
 {	 
- 	new_action.sa_handler = terminator_handler;
-    sigemptyset(&new_action.sa_mask);
-    new_action.sa_flags = 0;
-    sigaction (SIGINT, NULL, &old_action);
-    if (old_action.sa_handler != SIG_IGN) sigaction (SIGINT, &new_action, NULL);
-    sigaction (SIGHUP, NULL, &old_action);
-    if (old_action.sa_handler != SIG_IGN) sigaction (SIGHUP, &new_action, NULL);
-    sigaction (SIGTERM, NULL, &old_action);
-    if (old_action.sa_handler != SIG_IGN) sigaction (SIGTERM, &new_action, NULL);
+    int opt;
+    int years;
+    ledrollhead_t *ledrollhead;
+
+    while ((opt = getopt(argc, argv, "nset::l::u::m::h")) != -1) {
+        switch (opt) {
+        case 'n':
+            nixieTest = false;
+            break;
+        case 's':
+            backend = &backend_sim;
+            break;
+        case 'e':
+            reactorMode = true;
+            break;
+        case 't':
+            years = (optarg != NULL) ? atoi(optarg) : TZTEST_YEARS;
+            if (years <= 0) years = TZTEST_YEARS;
+            return (tzcache_selftest(time(NULL) - (TZTEST_BACK * 365L * SECONDS_PER_DAY), years) == 0) ? 0 : 1;
+        case 'l':
+            livefeedPath = (optarg != NULL) ? optarg : LIVEFEED_PATH;
+            break;
+        case 'm':
+            metricsPath = (optarg != NULL) ? optarg : METRICS_PATH;
+            break;
+        case 'u':
+            dmxUniverse = (optarg != NULL) ? atoi(optarg) : 1;
+            if ((dmxUniverse < 1) || (dmxUniverse > DMXFEED_UNIVERSE_MAX)) {
+                fprintf(stderr, "DMX universe must be 1 to %d\n", DMXFEED_UNIVERSE_MAX);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : 1;
+        }
+    }
+    openlog("pixied", LOG_PID, LOG_DAEMON);
+    syslog(LOG_INFO, "%s %s started", APP, REV);
+    /* the tasks block on this together with their timers, see notifyToTerminate() */
+    terminate.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (terminate.fd < 0) {
+        fprintf(stderr, "unable to create terminate event: %s\n", strerror(errno));
+        return 1;
+    }
+    if (reactorMode) {
+        /* the reactor reads the signals from a signalfd, blocked before any thread starts */
+        if (reactor_open() < 0) return 1;
+    } else {
+     	new_action.sa_handler = terminator_handler;
+        sigemptyset(&new_action.sa_mask);
+        new_action.sa_flags = 0;
+        sigaction (SIGINT, NULL, &old_action);
+        if (old_action.sa_handler != SIG_IGN) sigaction (SIGINT, &new_action, NULL);
+        sigaction (SIGTERM, NULL, &old_action);
+        if (old_action.sa_handler != SIG_IGN) sigaction (SIGTERM, &new_action, NULL);
+    }
+    if (reload_open() < 0) return 1;
+    if (livefeed_open() < 0) return 1;
+    if (input_open() < 0) return 1;
+    if (!reactorMode) {
+        new_action.sa_handler = reload_handler;
+        sigaction (SIGHUP, NULL, &old_action);
+        if (old_action.sa_handler != SIG_IGN) sigaction (SIGHUP, &new_action, NULL);
+        /* SIGUSR1 writes the event rings to /run/pixie.trace, see trace.h */
+        new_action.sa_handler = trace_signal;
+        sigaction (SIGUSR1, NULL, &old_action);
+        if (old_action.sa_handler != SIG_IGN) sigaction (SIGUSR1, &new_action, NULL);
+    }
+       
+    /* the LED config is read before the threads start, its realtime settings decide how they run */
+    ledrollhead = loadconfig();
+    if (ledrollhead == NULL) {
+        fprintf(stderr,"configuration file not valid\n");
+        return 1;
+    }
+    realtime = ledrollhead->realtime;
+    realtime_lock();
+    /* and whether the clock parks while nobody is there */
+    idleconfig = ledrollhead->idle;
+    if (idle_enabled() && (idle_open() < 0)) return 1;
+    /* and whether the tubes fade and dim, the tube thread takes them over from the clock */
+    tubeconfig = ledrollhead->tubes;
+    if (tubefx_enabled() && (tubefx_open() < 0)) return 1;
        
     pthread_attr_init(&attributes);
     pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_JOINABLE);
-    if (pthread_create(&timeThread, &attributes, timeTask, NULL)) {
+    /* locked, every byte of every stack is resident */
+    if (realtime.lock) pthread_attr_setstacksize(&attributes, REALTIME_THREAD_STACK);
+    if (tubefx_enabled() && pthread_create(&tubeThread, &attributes, tubefxTask, NULL)) {
+        fprintf(stderr,"tube effects unable to create thread\n");
+        return 1;
+  	} else if (reactorMode && pthread_create(&timeThread, &attributes, reactorTask, ledrollhead)) {
+        fprintf(stderr,"clock reactor unable to create thread\n");
+        return 1;
+  	} else if (!reactorMode && pthread_create(&timeThread, &attributes, timeTask, NULL)) {
         fprintf(stderr,"clock time unable to create thread\n");
         return 1;
-  	} else if (pthread_create(&ledThread, &attributes, ledTask, NULL)) {
+  	} else if (!reactorMode && pthread_create(&ledThread, &attributes, ledTask, ledrollhead)) {
         fprintf(stderr,"clock LED unable to create thread\n");
         return 1;
+  	} else if (pthread_create(&reloadThread, &attributes, reloadTask, NULL)) {
+        fprintf(stderr,"LED config reload unable to create thread\n");
+        return 1;
+  	} else if ((livefeed_fd() >= 0) && pthread_create(&livefeedThread, &attributes, livefeedTask, NULL)) {
+        fprintf(stderr,"live LED feed unable to create thread\n");
+        return 1;
+  	} else if ((metricsPath != NULL) && pthread_create(&metricsThread, &attributes, metricsTask, NULL)) {
+        fprintf(stderr,"metrics unable to create thread\n");
+        return 1;
+  	} else if (pthread_create(&inputThread, &attributes, inputTask, NULL)) {
+        fprintf(stderr,"buttons unable to create thread\n");
+        return 1;
   	} else {
 		pthread_join(timeThread, NULL);
-    	pthread_join(ledThread, NULL);
+    	if (!reactorMode) pthread_join(ledThread, NULL);
+    	pthread_join(reloadThread, NULL);
+        if (livefeed_fd() >= 0) pthread_join(livefeedThread, NULL);
+        if (metricsPath != NULL) pthread_join(metricsThread, NULL);
+        pthread_join(inputThread, NULL);
+        if (tubefx_enabled()) pthread_join(tubeThread, NULL);
   	}
+    reload_close();
+    livefeed_close();
+    input_close();
+    idle_close();
+    tubefx_close();
+    reactor_close();
+    close(terminate.fd);
+    realtime_unlock();
     closelog();
     pthread_attr_destroy(&attributes);
     return 0;
@@ -0,0 +1,161 @@
+/*
+ * @file metrics.c
+ * @brief writes the hot path metrics as Prometheus text once a second
+ * @details for raspberry pi 3B+
+ * The file is written beside itself and renamed over the old one, a reader never sees half of it.
+ * Seconds the clock missed since the last write go to syslog as well, that is the one a customer
+ * sees, the rest are for spotting a regression before it gets that far.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "nixieclock.h"
+#include "metrics.h"
+#include "livefeed.h"
+#include "tubefx.h"
+
+const char *metricsPath = NULL;
+metrics_t metrics;
+
+/*
+ * @brief metric_quantile(const metrichist_t *h, double q)
+ * @return upper bound in nanoseconds of the bucket holding quantile q, the max for the last bucket
+ */
+int64_t metric_quantile(const metrichist_t *h, double q)
+{
+    uint64_t count = atomic_load_explicit(&h->count, memory_order_acquire);
+    uint64_t rank = (uint64_t) (q * count);
+    uint64_t seen = 0;
+
+    if (count == 0) return 0;
+    for (int b = 0; b < METRIC_BUCKETS - 1; b++) {
+        seen += atomic_load_explicit(&h->bucket[b], memory_order_relaxed);
+        if (seen > rank) return 1LL << (METRIC_SHIFT + b);
+    }
+    return atomic_load_explicit(&h->max, memory_order_relaxed);
+}
+
+static void writeHist(FILE *fp, const char *name, const char *help, const metrichist_t *h)
+{
+    uint64_t count = atomic_load_explicit(&h->count, memory_order_acquire);
+    uint64_t cumulative = 0;
+
+    fprintf(fp, "# HELP pixie_%s_seconds %s\n# TYPE pixie_%s_seconds histogram\n", name, help, name);
+    for (int b = 0; b < METRIC_BUCKETS - 1; b++) {
+        cumulative += atomic_load_explicit(&h->bucket[b], memory_order_relaxed);
+        /* a bucket can run ahead of count while it is being recorded */
+        if (cumulative > count) cumulative = count;
+        fprintf(fp, "pixie_%s_seconds_bucket{le=\"%g\"} %llu\n", name, (double) (1LL << (METRIC_SHIFT + b)) / 1e9,
+            (unsigned long long) cumulative);
+    }
+    fprintf(fp, "pixie_%s_seconds_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long) count);
+    fprintf(fp, "pixie_%s_seconds_sum %.9f\n", name, (double) atomic_load_explicit(&h->sum, memory_order_relaxed) / 1e9);
+    fprintf(fp, "pixie_%s_seconds_count %llu\n", name, (unsigned long long) count);
+    fprintf(fp, "# HELP pixie_%s_max_seconds worst since start\n# TYPE pixie_%s_max_seconds gauge\n", name, name);
+    fprintf(fp, "pixie_%s_max_seconds %.9f\n", name, (double) atomic_load_explicit(&h->max, memory_order_relaxed) / 1e9);
+}
+
+static void writeCounter(FILE *fp, const char *name, const char *help, uint64_t value)
+{
+    fprintf(fp, "# HELP pixie_%s_total %s\n# TYPE pixie_%s_total counter\npixie_%s_total %llu\n", name, help, name, name,
+        (unsigned long long) value);
+}
+
+/*
+ * @brief metrics_write(const char *path) writes every metric to path
+ * @return 0 or -1 if the file could not be written
+ */
+int metrics_write(const char *path)
+{
+    char tmp[PATH_MAX];
+    FILE *fp;
+    int rv;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fp = fopen(tmp, "w");
+    if (fp == NULL) return -1;
+    writeHist(fp, "flip_lateness", "second boundary to the nixie latch", &metrics.flip);
+    writeHist(fp, "spi_transfer", "nixie frame SPI transfer", &metrics.spi);
+    writeHist(fp, "frame_build", "LED frame interpolation and copy to the strips", &metrics.build);
+    writeHist(fp, "led_render", "ws2811 render call", &metrics.render);
+    writeHist(fp, "frame_lateness", "LED frame start after its deadline", &metrics.frame);
+    writeCounter(fp, "seconds_missed", "second boundaries the clock did not wake for", atomic_load(&metrics.secondsMissed));
+    writeCounter(fp, "clock_steps", "wall clock steps", atomic_load(&metrics.clockSteps));
+    writeCounter(fp, "frames_late", "LED frames started more than 2 ms after their deadline", atomic_load(&metrics.framesLate));
+    writeCounter(fp, "frames_dropped", "LED frames skipped to catch up", atomic_load(&metrics.framesDropped));
+    writeCounter(fp, "live_frames", "live frames received", atomic_load(&livefeedstats.frames));
+    writeCounter(fp, "live_frames_shown", "live frames shown", atomic_load(&livefeedstats.shown));
+    writeCounter(fp, "live_frames_superseded", "live frames replaced before they were shown", atomic_load(&livefeedstats.superseded));
+    writeCounter(fp, "live_frames_late", "live frames past their presentation time", atomic_load(&livefeedstats.late));
+    writeCounter(fp, "live_rejected", "malformed live messages and packets", atomic_load(&livefeedstats.rejected));
+    writeCounter(fp, "cathode_refreshes", "cathode refreshes started", atomic_load(&tubefxstats.refreshes));
+    fprintf(fp, "# HELP pixie_cathode_lit_seconds_total time each tube cathode has been lit\n"
+        "# TYPE pixie_cathode_lit_seconds_total counter\n");
+    for (int s = 0; s < NIXIE_TUBES; s++) {
+        for (int d = 0; d < NIXIE_DIGITS; d++) {
+            fprintf(fp, "pixie_cathode_lit_seconds_total{tube=\"%d\",digit=\"%d\"} %.3f\n", s, d,
+                (double) atomic_load_explicit(&tubefxstats.cathode[s][d], memory_order_relaxed) / 1e9);
+        }
+    }
+    rv = ferror(fp) ? -1 : 0;
+    if (fclose(fp) != 0) rv = -1;
+    if ((rv == 0) && (rename(tmp, path) < 0)) rv = -1;
+    if (rv < 0) unlink(tmp);
+    return rv;
+}
+
+void *metricsTask(void *threadid)
+{
+    uint64_t missed = 0;
+    uint64_t now;
+    bool failed = false;
+
+    while (!terminateWait(METRICS_INTERVAL_MS)) {
+        if (metrics_write(metricsPath) < 0) {
+            if (!failed) syslog(LOG_ERR, "unable to write metrics to %s: %s", metricsPath, strerror(errno));
+            failed = true;
+        } else {
+            failed = false;
+        }
+        now = atomic_load_explicit(&metrics.secondsMissed, memory_order_relaxed);
+        if (now > missed) syslog(LOG_WARNING, "clock missed %llu seconds", (unsigned long long) (now - missed));
+        missed = now;
+    }
+    /* a file left behind would keep reporting the daemon as up */
+    unlink(metricsPath);
+    return NULL;
+}
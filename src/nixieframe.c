@@ -0,0 +1,112 @@
+/*
+ * @file nixieframe.c
+ * @brief precomputed bit fields for the nixie HV driver word
+ * @details for raspberry pi 3B+
+ * Before byte swapping, the word shifted into the HV drivers is laid out from bit 0 as
+ * tube 0 (bits 0-9), tube 1 (10-19), tube 2 (20-29), colon (30-31), tube 3 (32-41),
+ * tube 4 (42-51), tube 5 (52-61), colon (62-63) with digit n on bit n of its tube.
+ * The table holds every field already byte swapped so no per frame shifting or bswap is needed.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nixieframe.h"
+
+/* bit b of the unswapped word as it lands after bswap_64 */
+#define SWAPBIT(b) (1ULL << (((7 - ((b) >> 3)) << 3) | ((b) & 7)))
+#define TUBE_DIGITS(pos) { SWAPBIT(pos), SWAPBIT(pos + 1), SWAPBIT(pos + 2), SWAPBIT(pos + 3), \
+    SWAPBIT(pos + 4), SWAPBIT(pos + 5), SWAPBIT(pos + 6), SWAPBIT(pos + 7), SWAPBIT(pos + 8), \
+    SWAPBIT(pos + 9), 0 }
+#define TUBE_MASK(pos) (SWAPBIT(pos) | SWAPBIT(pos + 1) | SWAPBIT(pos + 2) | SWAPBIT(pos + 3) | \
+    SWAPBIT(pos + 4) | SWAPBIT(pos + 5) | SWAPBIT(pos + 6) | SWAPBIT(pos + 7) | SWAPBIT(pos + 8) | \
+    SWAPBIT(pos + 9))
+
+const nixielut_t nixielut = {
+    .digit = {
+        TUBE_DIGITS(0), TUBE_DIGITS(10), TUBE_DIGITS(20),
+        TUBE_DIGITS(32), TUBE_DIGITS(42), TUBE_DIGITS(52),
+    },
+    .slot = {
+        TUBE_MASK(0), TUBE_MASK(10), TUBE_MASK(20),
+        TUBE_MASK(32), TUBE_MASK(42), TUBE_MASK(52),
+    },
+    .colon = SWAPBIT(30) | SWAPBIT(31) | SWAPBIT(62) | SWAPBIT(63),
+};
+
+/*
+ * @brief nixie_frame_init(nixieframe_t *frame)
+ * all tubes and colons off
+ */
+void nixie_frame_init(nixieframe_t *frame)
+{
+    frame->word.ll = 0;
+    memset(frame->digit, NIXIE_BLANK, sizeof(frame->digit));
+    frame->colon = false;
+}
+
+/*
+ * @brief nixie_frame_set_digits(nixieframe_t *frame, const uint8_t digit[], bool colon)
+ * @param[in,out] frame - frame to patch
+ * @param[in] digit - six digit values 0-9 left to right, anything else blanks the tube
+ * @param[in] colon - true if colon is displayed, false they are off
+ */
+void nixie_frame_set_digits(nixieframe_t *frame, const uint8_t digit[NIXIE_TUBES], bool colon)
+{
+    for (int i = 0; i < NIXIE_TUBES; i++) nixie_frame_set_digit(frame, i, digit[i]);
+    nixie_frame_set_colon(frame, colon);
+}
+
+/*
+ * @brief nixie_frame_set_hms(nixieframe_t *frame, int hours, int minutes, int seconds, bool colon)
+ * hours, minutes and seconds are 0-99, typically 0-23, 0-59 and 0-60
+ */
+void nixie_frame_set_hms(nixieframe_t *frame, int hours, int minutes, int seconds, bool colon)
+{
+    nixie_frame_set_digit(frame, 0, hours / 10);
+    nixie_frame_set_digit(frame, 1, hours % 10);
+    nixie_frame_set_digit(frame, 2, minutes / 10);
+    nixie_frame_set_digit(frame, 3, minutes % 10);
+    nixie_frame_set_digit(frame, 4, seconds / 10);
+    nixie_frame_set_digit(frame, 5, seconds % 10);
+    nixie_frame_set_colon(frame, colon);
+}
+
+/*
+ * @brief nixie_frame_set_bcd(nixieframe_t *frame, uint32_t bcd, bool colon)
+ * @param[in] bcd - 0xHHMMSS, nibbles above 9 blank their tube
+ */
+void nixie_frame_set_bcd(nixieframe_t *frame, uint32_t bcd, bool colon)
+{
+    for (int i = 0; i < NIXIE_TUBES; i++) {
+        nixie_frame_set_digit(frame, i, (bcd >> ((NIXIE_TUBES - 1 - i) * 4)) & 0xF);
+    }
+    nixie_frame_set_colon(frame, colon);
+}
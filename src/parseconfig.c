@@ -47,28 +47,452 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+/* without parent links jsmn walks back over every closed token to find the open parent, which
+ * makes a roll of many records quadratic */
+#define JSMN_PARENT_LINKS
 #include "jsmn.h"
+#include "ws2811.h"
 #include "nixieclock.h"
-
-#define INITIAL_TOKEN_COUNT 128
-#define TOKEN_COUNT_INCREMENT 128
+#include "timeline.h"
+#include "rollfile.h"
+#include "realtime.h"
+#include "idle.h"
+#include "tubefx.h"
 
 static bool jsoneq(const char *json, jsmntok_t *tok, const char *s) {
-  return (tok->type == JSMN_STRING && strncmp(json + tok->start, s, tok->end - tok->start) == 0);
+  return (tok->type == JSMN_STRING && strlen(s) == (size_t) (tok->end - tok->start) && strncmp(json + tok->start, s, tok->end - tok->start) == 0);
+}
+
+/*
+ * @brief member is true while tidx is still inside the object that ends at end
+ * @details objects are walked by position instead of by their size. With parent links jsmn does
+ * not count a key that follows a closing bracket without a comma, which older configs have.
+ */
+static inline bool member(const jsmntok_t *tokenp, int tidx, int tokencount, int end)
+{
+    return (tidx < tokencount) && (tokenp[tidx].start < end);
+}
+
+static const struct {
+    const char *name;
+    uint32_t strip;
+} stripnames[] = {
+    {"rgb", WS2811_STRIP_RGB}, {"rbg", WS2811_STRIP_RBG}, {"grb", WS2811_STRIP_GRB},
+    {"gbr", WS2811_STRIP_GBR}, {"brg", WS2811_STRIP_BRG}, {"bgr", WS2811_STRIP_BGR},
+    {"rgbw", SK6812_STRIP_RGBW}, {"rbgw", SK6812_STRIP_RBGW}, {"grbw", SK6812_STRIP_GRBW},
+    {"gbrw", SK6812_STRIP_GBRW}, {"brgw", SK6812_STRIP_BRGW}, {"bgrw", SK6812_STRIP_BGRW},
+    {"ws2812", WS2812_STRIP}, {"sk6812", SK6812_STRIP}, {"sk6812w", SK6812W_STRIP},
+};
+
+/* gpio pins each PWM channel can be routed to */
+static const uint8_t pwmpins[LEDCHANNELS][5] = {{12, 18, 40, 52, 0}, {13, 19, 41, 45, 53}};
+
+static bool pwmpin(int channel, long gpio)
+{
+    for (int i = 0; i < sizeof(pwmpins[0]); i++) {
+        if (pwmpins[channel][i] != 0 && pwmpins[channel][i] == gpio) return true;
+    }
+    return false;
+}
+
+/*
+ * @brief parsechannel reads one object of the system channels array
+ * @details "gpio" and "count" are required, "brightness" defaults to 255 and "strip" to sk6812
+ * @return 0 or -1 if the object is not valid
+ */
+static int parsechannel(const char *filebuffer, jsmntok_t *tokenp, int tokencount, int *tidx, int index, ledchannel_t *channel)
+{
+    int end;
+    long value;
+    char *endp;
+    bool found;
+
+    if (tokenp[*tidx].type != JSMN_OBJECT) {
+        fprintf(stderr, "channel #%d must be an object\n", index+1);
+        return -1;
+    }
+    end = tokenp[(*tidx)++].end;
+    channel->gpio = 0;
+    channel->count = 0;
+    channel->brightness = 255;
+    channel->strip = SK6812_STRIP;
+    while (member(tokenp, *tidx, tokencount, end)) {
+        if (jsoneq(filebuffer, &tokenp[*tidx], "strip") && tokenp[*tidx].size == 1) {
+            (*tidx)++;
+            found = false;
+            for (int j = 0; j < sizeof(stripnames)/sizeof(stripnames[0]); j++) {
+                if (jsoneq(filebuffer, &tokenp[*tidx], stripnames[j].name)) {
+                    channel->strip = stripnames[j].strip;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                fprintf(stderr, "channel #%d has an unknown strip type\n", index+1);
+                return -1;
+            }
+            (*tidx)++;
+        } else if ((jsoneq(filebuffer, &tokenp[*tidx], "gpio") || jsoneq(filebuffer, &tokenp[*tidx], "count")
+            || jsoneq(filebuffer, &tokenp[*tidx], "brightness")) && tokenp[*tidx].size == 1) {
+            const char *key = jsoneq(filebuffer, &tokenp[*tidx], "gpio") ? "gpio" :
+                jsoneq(filebuffer, &tokenp[*tidx], "count") ? "count" : "brightness";
+            (*tidx)++;
+            value = strtol(&filebuffer[tokenp[*tidx].start], &endp, 10);
+            if (tokenp[*tidx].type != JSMN_PRIMITIVE || &filebuffer[tokenp[*tidx].start] == endp) {
+                fprintf(stderr, "channel #%d has an invalid %s value\n", index+1, key);
+                return -1;
+            }
+            if (key[0] == 'g') {
+                if (!pwmpin(index, value)) {
+                    fprintf(stderr, "channel #%d can not use gpio %ld, it is not a PWM%d pin\n", index+1, value, index);
+                    return -1;
+                }
+                channel->gpio = value;
+            } else if (key[0] == 'c') {
+                if (value < 1 || value > LEDMAX) {
+                    fprintf(stderr, "channel #%d count should be 1 to %d\n", index+1, LEDMAX);
+                    return -1;
+                }
+                channel->count = value;
+            } else {
+                if (value < 0 || value > 255) {
+                    fprintf(stderr, "channel #%d brightness should be 0 to 255\n", index+1);
+                    return -1;
+                }
+                channel->brightness = value;
+            }
+            (*tidx)++;
+        } else {
+            fprintf(stderr, "invalid key for channel #%d\n", index+1);
+            return -1;
+        }
+    }
+    if (channel->gpio == 0 || channel->count == 0) {
+        fprintf(stderr, "channel #%d needs gpio and count\n", index+1);
+        return -1;
+    }
+    return 0;
 }
 
-static uint32_t levelAdjust(uint32_t value, uint32_t level) 
+/*
+ * @brief parseflag reads a true or false primitive
+ * @return 0 or -1 if the token is neither
+ */
+static int parseflag(const char *json, const jsmntok_t *tok, uint32_t *flag)
 {
-    uint32_t r, g, b;
-    r = (value >> 16) & 0xFF;
-    g = (value >> 8) & 0xFF;
-    b = value & 0xFF;
-    r = (r * level) / 100;
-    g = (g * level) / 100;
-    b = (b * level) / 100;
-    return ((r << 16) | (g << 8) | b);
+    int length = tok->end - tok->start;
+
+    if (tok->type != JSMN_PRIMITIVE) return -1;
+    if ((length == 4) && (strncmp(json + tok->start, "true", 4) == 0)) {
+        *flag = 1;
+    } else if ((length == 5) && (strncmp(json + tok->start, "false", 5) == 0)) {
+        *flag = 0;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief parserealtime reads the realtime object of the system block
+ * @details "lock" is true or false, "clock", "led" and "feed" are objects of a SCHED_FIFO
+ * "priority" and the "cpu" to pin the thread to. Anything left out stays as it is without the object.
+ * @return 0 or -1 if the object is not valid
+ */
+static int parserealtime(const char *filebuffer, jsmntok_t *tokenp, int tokencount, int *tidx, realtime_t *realtime)
+{
+    static const char *names[RT_THREADS] = REALTIME_NAMES;
+    rtthread_t *thread;
+    int end, threadend;
+    long value;
+    char *endp;
+    int t;
+
+    if (tokenp[*tidx].type != JSMN_OBJECT) {
+        fprintf(stderr, "realtime must be an object\n");
+        return -1;
+    }
+    end = tokenp[(*tidx)++].end;
+    while (member(tokenp, *tidx, tokencount, end)) {
+        if (jsoneq(filebuffer, &tokenp[*tidx], "lock") && tokenp[*tidx].size == 1) {
+            (*tidx)++;
+            if (parseflag(filebuffer, &tokenp[*tidx], &realtime->lock) < 0) {
+                fprintf(stderr, "realtime lock should be true or false\n");
+                return -1;
+            }
+            (*tidx)++;
+            continue;
+        }
+        for (t = 0; t < RT_THREADS; t++) {
+            if (jsoneq(filebuffer, &tokenp[*tidx], names[t])) break;
+        }
+        if ((t == RT_THREADS) || (tokenp[*tidx].size != 1) || (tokenp[*tidx + 1].type != JSMN_OBJECT)) {
+            fprintf(stderr, "invalid key for realtime, should be lock, clock, led or feed objects\n");
+            return -1;
+        }
+        thread = &realtime->thread[t];
+        (*tidx)++;
+        threadend = tokenp[(*tidx)++].end;
+        while (member(tokenp, *tidx, tokencount, threadend)) {
+            bool priority = jsoneq(filebuffer, &tokenp[*tidx], "priority");
+            if ((!priority && !jsoneq(filebuffer, &tokenp[*tidx], "cpu")) || tokenp[*tidx].size != 1) {
+                fprintf(stderr, "invalid key for realtime %s, should be priority or cpu\n", names[t]);
+                return -1;
+            }
+            (*tidx)++;
+            value = strtol(&filebuffer[tokenp[*tidx].start], &endp, 10);
+            if (tokenp[*tidx].type != JSMN_PRIMITIVE || &filebuffer[tokenp[*tidx].start] == endp) {
+                fprintf(stderr, "invalid realtime %s %s value\n", names[t], priority ? "priority" : "cpu");
+                return -1;
+            }
+            if (priority) {
+                if (value < 0 || value > REALTIME_PRIORITY_MAX) {
+                    fprintf(stderr, "realtime %s priority should be 0 to %d\n", names[t], REALTIME_PRIORITY_MAX);
+                    return -1;
+                }
+                thread->priority = value;
+            } else {
+                if (value < REALTIME_ANY || value > REALTIME_CPU_MAX) {
+                    fprintf(stderr, "realtime %s cpu should be %d to %d, %d for any\n", names[t], 0, REALTIME_CPU_MAX, REALTIME_ANY);
+                    return -1;
+                }
+                thread->cpu = value;
+            }
+            (*tidx)++;
+        }
+    }
+    return 0;
+}
+
+/*
+ * @brief parseidle reads the idle object of the system block
+ * @details "presence" is the seconds the clock stays on after the sensor last saw someone, "from"
+ * and "until" are "HH:MM" local times the clock stays off between unless someone is there.
+ * @return 0 or -1 if the object is not valid
+ */
+static int parseidle(const char *filebuffer, jsmntok_t *tokenp, int tokencount, int *tidx, idleconfig_t *idle)
+{
+    int end, hours, minutes, length;
+    int32_t *at;
+    long value;
+    char *endp;
+
+    if (tokenp[*tidx].type != JSMN_OBJECT) {
+        fprintf(stderr, "idle must be an object\n");
+        return -1;
+    }
+    end = tokenp[(*tidx)++].end;
+    while (member(tokenp, *tidx, tokencount, end)) {
+        if (jsoneq(filebuffer, &tokenp[*tidx], "presence") && tokenp[*tidx].size == 1) {
+            (*tidx)++;
+            value = strtol(&filebuffer[tokenp[*tidx].start], &endp, 10);
+            if (tokenp[*tidx].type != JSMN_PRIMITIVE || &filebuffer[tokenp[*tidx].start] == endp
+                || value < 0 || value > IDLE_PRESENCE_MAX) {
+                fprintf(stderr, "idle presence should be 0 to %d seconds\n", IDLE_PRESENCE_MAX);
+                return -1;
+            }
+            idle->presence = value;
+        } else if ((jsoneq(filebuffer, &tokenp[*tidx], "from") || jsoneq(filebuffer, &tokenp[*tidx], "until"))
+                   && tokenp[*tidx].size == 1) {
+            at = jsoneq(filebuffer, &tokenp[*tidx], "from") ? &idle->from : &idle->until;
+            (*tidx)++;
+            length = tokenp[*tidx].end - tokenp[*tidx].start;
+            if (tokenp[*tidx].type != JSMN_STRING || length < 4 || length > 5
+                || sscanf(&filebuffer[tokenp[*tidx].start], "%2d:%2d", &hours, &minutes) != 2
+                || hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+                fprintf(stderr, "idle %s should be a time \"HH:MM\"\n", (at == &idle->from) ? "from" : "until");
+                return -1;
+            }
+            *at = hours * 60 + minutes;
+        } else {
+            fprintf(stderr, "invalid key for idle, should be presence, from or until\n");
+            return -1;
+        }
+        (*tidx)++;
+    }
+    if ((idle->from < 0) != (idle->until < 0)) {
+        fprintf(stderr, "idle needs both from and until\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief parserefresh reads the refresh object of the tubes object
+ * @details "every" is the minutes of the day a cathode refresh starts on, divisible by it, "at" a
+ * "HH:MM" local time it starts every day, "seconds" how long it runs.
+ * @return 0 or -1 if the object is not valid
+ */
+static int parserefresh(const char *filebuffer, jsmntok_t *tokenp, int tokencount, int *tidx, tubeconfig_t *tubes)
+{
+    int end, hours, minutes, length;
+    long value;
+    char *endp;
+
+    if (tokenp[*tidx].type != JSMN_OBJECT) {
+        fprintf(stderr, "refresh must be an object\n");
+        return -1;
+    }
+    end = tokenp[(*tidx)++].end;
+    while (member(tokenp, *tidx, tokencount, end)) {
+        if (jsoneq(filebuffer, &tokenp[*tidx], "every") && tokenp[*tidx].size == 1) {
+            (*tidx)++;
+            value = strtol(&filebuffer[tokenp[*tidx].start], &endp, 10);
+            if (tokenp[*tidx].type != JSMN_PRIMITIVE || &filebuffer[tokenp[*tidx].start] == endp
+                || value < 1 || value > TUBEFX_EVERY_MAX) {
+                fprintf(stderr, "refresh every should be 1 to %d minutes\n", TUBEFX_EVERY_MAX);
+                return -1;
+            }
+            tubes->refreshEvery = value;
+        } else if (jsoneq(filebuffer, &tokenp[*tidx], "seconds") && tokenp[*tidx].size == 1) {
+            (*tidx)++;
+            value = strtol(&filebuffer[tokenp[*tidx].start], &endp, 10);
+            if (tokenp[*tidx].type != JSMN_PRIMITIVE || &filebuffer[tokenp[*tidx].start] == endp
+                || value < 1 || value > TUBEFX_REFRESH_MAX) {
+                fprintf(stderr, "refresh seconds should be 1 to %d\n", TUBEFX_REFRESH_MAX);
+                return -1;
+            }
+            tubes->refreshSeconds = value;
+        } else if (jsoneq(filebuffer, &tokenp[*tidx], "at") && tokenp[*tidx].size == 1) {
+            (*tidx)++;
+            length = tokenp[*tidx].end - tokenp[*tidx].start;
+            if (tokenp[*tidx].type != JSMN_STRING || length < 4 || length > 5
+                || sscanf(&filebuffer[tokenp[*tidx].start], "%2d:%2d", &hours, &minutes) != 2
+                || hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+                fprintf(stderr, "refresh at should be a time \"HH:MM\"\n");
+                return -1;
+            }
+            tubes->refreshAt = hours * 60 + minutes;
+        } else {
+            fprintf(stderr, "invalid key for refresh, should be every, at or seconds\n");
+            return -1;
+        }
+        (*tidx)++;
+    }
+    if (((tubes->refreshEvery > 0) || (tubes->refreshAt >= 0)) != (tubes->refreshSeconds > 0)) {
+        fprintf(stderr, "refresh needs seconds and every or at\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief parsetubes reads the tubes object of the system block
+ * @details "fade" is the milliseconds the digits crossfade over after each flip, "brightness" the
+ * percent of the time the tubes are lit, "refresh" when the cathodes are refreshed.
+ * @return 0 or -1 if the object is not valid
+ */
+static int parsetubes(const char *filebuffer, jsmntok_t *tokenp, int tokencount, int *tidx, tubeconfig_t *tubes)
+{
+    bool fade;
+    long value;
+    char *endp;
+    int end;
+
+    if (tokenp[*tidx].type != JSMN_OBJECT) {
+        fprintf(stderr, "tubes must be an object\n");
+        return -1;
+    }
+    end = tokenp[(*tidx)++].end;
+    while (member(tokenp, *tidx, tokencount, end)) {
+        if ((jsoneq(filebuffer, &tokenp[*tidx], "fade") || jsoneq(filebuffer, &tokenp[*tidx], "brightness"))
+            && tokenp[*tidx].size == 1) {
+            fade = jsoneq(filebuffer, &tokenp[*tidx], "fade");
+            (*tidx)++;
+            value = strtol(&filebuffer[tokenp[*tidx].start], &endp, 10);
+            if (tokenp[*tidx].type != JSMN_PRIMITIVE || &filebuffer[tokenp[*tidx].start] == endp
+                || (fade && ((value < 0) || (value > TUBEFX_FADE_MAX)))
+                || (!fade && ((value < 1) || (value > 100)))) {
+                if (fade) fprintf(stderr, "tubes fade should be 0 to %d milliseconds\n", TUBEFX_FADE_MAX);
+                else fprintf(stderr, "tubes brightness should be 1 to 100 percent\n");
+                return -1;
+            }
+            if (fade) tubes->fade = value;
+            else tubes->brightness = value;
+        } else if (jsoneq(filebuffer, &tokenp[*tidx], "refresh") && tokenp[*tidx].size == 1) {
+            (*tidx)++;
+            if (parserefresh(filebuffer, tokenp, tokencount, tidx, tubes) < 0) return -1;
+            continue;
+        } else {
+            fprintf(stderr, "invalid key for tubes, should be fade, brightness or refresh\n");
+            return -1;
+        }
+        (*tidx)++;
+    }
+    return 0;
+}
+
+/*
+ * @brief levelTable fills scale with each 8 bit color component at level percent
+ */
+static void levelTable(uint8_t scale[256], uint32_t level)
+{
+    for (uint32_t i = 0; i < 256; i++) scale[i] = (i * level) / 100;
+}
+
+static inline uint32_t levelAdjust(uint32_t value, const uint8_t scale[256])
+{
+    return ((uint32_t) scale[(value >> 16) & 0xFF] << 16) | ((uint32_t) scale[(value >> 8) & 0xFF] << 8) | scale[value & 0xFF];
+}
+
+/*
+ * @brief hexcolor decodes #RRGGBB or 0xRRGGBB from the color string tok
+ * @details the digits are read up to the end of the token, the file is mapped and not terminated
+ * @return true if the string is one to eight hexadecimal digits after the optional prefix
+ */
+static bool hexcolor(const char *json, const jsmntok_t *tok, uint32_t *value)
+{
+    const char *p = json + tok->start;
+    const char *end = json + tok->end;
+    uint32_t v = 0;
+    uint32_t d;
+
+    if ((p < end) && (*p == '#')) {
+        p++;
+    } else if ((end - p > 2) && (p[0] == '0') && ((p[1] | 0x20) == 'x')) {
+        p += 2;
+    }
+    if ((p == end) || (end - p > 8)) return false;
+    for (; p < end; p++) {
+        d = (uint32_t) (*p - '0');
+        if (d > 9) {
+            d = (uint32_t) ((*p | 0x20) - 'a');
+            if (d > 5) return false;
+            d += 10;
+        }
+        v = (v << 4) | d;
+    }
+    *value = v;
+    return true;
+}
+
+/*
+ * @brief rollarena allocates a roll's head, records and frames as one block
+ * @details the frames come first to keep LEDFRAME_ALIGN, they are cleared so a record without a
+ * color array and the padding at the end of each frame are black. freeconfig() frees the block.
+ */
+static ledrollhead_t *rollarena(int recordcount, uint32_t stride)
+{
+    size_t pixelsize = (size_t) recordcount * stride * sizeof(uint32_t);
+    size_t size = pixelsize + sizeof(ledrollhead_t) + ((size_t) recordcount * sizeof(ledroll_t));
+    uint8_t *arena;
+    ledrollhead_t *ledrollhead;
+
+    size = (size + LEDFRAME_ALIGN - 1) & ~((size_t) LEDFRAME_ALIGN - 1);
+    arena = (uint8_t *) aligned_alloc(LEDFRAME_ALIGN, size);
+    if (arena == NULL) return NULL;
+    memset(arena, 0, pixelsize);
+    ledrollhead = (ledrollhead_t *) (arena + pixelsize);
+    ledrollhead->pixels = (uint32_t *) arena;
+    ledrollhead->roll = (ledroll_t *) (ledrollhead + 1);
+    return ledrollhead;
 }
     
 const char *tokentypestring(jsmntype_t type) {
@@ -82,112 +506,88 @@ const char *tokentypestring(jsmntype_t type) {
 }
     
 const char *pathfilename[] = {"/etc/LEDcolor.json", "/usr/local/etc/LEDcolor.json", "./LEDcolor.json"};
+/* pixie-compile output for each of pathfilename */
+const char *rollfilename[] = {"/etc/LEDcolor.pxr", "/usr/local/etc/LEDcolor.pxr", "./LEDcolor.pxr"};
 
-ledrollhead_t *parseconfig(void)
+/*
+ * @brief parsejson builds the roll from a json config
+ * @details jsmn runs once without tokens to count them, then once more into an array of exactly
+ * that size. Colors are decoded straight into the roll arena.
+ * @param[in] filebuffer - the config, not terminated
+ * @param[in] filesize - bytes in filebuffer
+ * @param[in] path - file the config came from, kept in the roll so it has to outlive it
+ * @return the roll or NULL if the config is not valid
+ */
+static ledrollhead_t *parsejson(const char *filebuffer, size_t filesize, const char *path)
 {
-    FILE *fin = NULL;
-    long int filesize;
-    char *filebuffer;
-    int fileindex = -1;
     jsmn_parser jsonparser;
-    jsmntok_t *tokenp;
+    jsmntok_t *tokenp = NULL;
     int tidx;
-    int tokencount = INITIAL_TOKEN_COUNT;
-    bool done = false;
+    int tokencount;
     int rv;
     int recordcount;
-    int itemcount;
+    int end;
     int level = 100;
-    ledroll_t *ledroll;
+    uint8_t scale[256];
+    ledroll_t *ledroll = NULL;
     bool fast;
     int32_t delay;
+    uint32_t color;
     char *endp;
-    char *p;
     int errcount = 0;
-    ledrollhead_t *ledrollhead;
+    ledrollhead_t *ledrollhead = NULL;
     colonEnum_t col = COLON_ON;
-    
-    for (int i = 0; i < sizeof(pathfilename)/sizeof(char *); i++) {
-        fin = fopen(pathfilename[i], "r");
-        if (fin != NULL) {
-            if (fseek(fin, 0, SEEK_END) < 0) {
-                fprintf(stderr, "failed to seek the open file %s\n", pathfilename[i]);
-                return NULL;
-            }
-            filesize = ftell(fin);
-            if (filesize < 0) {
-                fprintf(stderr, "bad file size returned for file: %s\n", pathfilename[i]);
-                return NULL;
-            }
-            if (fseek(fin, 0L, SEEK_SET) < 0) {
-                fprintf(stderr, "unable to reset the open file %s\n", pathfilename[i]);
-                return NULL;
-            }
-            fileindex = i;
-            break;
-        }
-    }
-    if (fin == NULL) {
-        fprintf(stderr, "unable to find a valid configuration file\n");
-        return NULL;
-    }
-    filebuffer = (char *) malloc((filesize * sizeof(char)) + 1);
-    if (filebuffer < 0) {
-        fprintf(stderr, "unable to allocate memory for file %s\n", pathfilename[fileindex]);
-        return NULL;
-    }    
-    if (fread(filebuffer, filesize, sizeof(char), fin) < 0) {
-        fprintf(stderr, "unable to read config file %s\n", pathfilename[fileindex]);
-        return NULL;
-    }
-    filebuffer[filesize] = '\0';
-    fclose(fin);
+    long timeline = TIMELINE_LIMIT;
+    long fps = LEDFPS;
+    long width = LEDWIDTH;
+    long height = LEDHEIGHT;
+    ledgeometry_t geometry = {.layout = LAYOUT_ROWS};
+    realtime_t realtime = REALTIME_OFF;
+    idleconfig_t idle = IDLE_OFF;
+    tubeconfig_t tubes = TUBEFX_OFF;
+    int channels = 0;
+    uint32_t channelcount;
+
+    /* counting pass, no tokens are stored */
     jsmn_init(&jsonparser);
-    tokenp = (jsmntok_t *) malloc(INITIAL_TOKEN_COUNT * sizeof(jsmntok_t));
-    tokencount = INITIAL_TOKEN_COUNT;
-    if (tokenp == NULL) {
-        fprintf(stderr, "out of memory - config file to large\n");
-        free(filebuffer);
-        return NULL;
-    }
-    while(!done) {
-        rv = jsmn_parse(&jsonparser, filebuffer, filesize, tokenp, tokencount);
-        if (rv == JSMN_ERROR_NOMEM) {
-            tokencount += TOKEN_COUNT_INCREMENT;
-            tokenp = realloc(tokenp, tokencount * sizeof(jsmntok_t));
-            if (tokenp == NULL) {
-                fprintf(stderr, "out of memory - config file to large\n");
-                done = true;
-            }
-        } else {
-            done = true;
-            if (rv == JSMN_ERROR_INVAL) {
-                fprintf(stderr, "Invalid character in json\n");
-            } else if (rv == JSMN_ERROR_PART) {
-                fprintf(stderr, "Incomplete or invalid json structure %d\n", rv);
-            }
+    tokencount = jsmn_parse(&jsonparser, filebuffer, filesize, NULL, 0);
+    if (tokencount > 0) {
+        tokenp = (jsmntok_t *) malloc(tokencount * sizeof(jsmntok_t));
+        if (tokenp == NULL) {
+            fprintf(stderr, "out of memory - config file to large\n");
+            return NULL;
         }
+        jsmn_init(&jsonparser);
+        rv = jsmn_parse(&jsonparser, filebuffer, filesize, tokenp, tokencount);
+    } else {
+        rv = (tokencount == 0) ? JSMN_ERROR_PART : tokencount;
     }
-    if (tokenp[0].type != JSMN_OBJECT) {
+    if (rv == JSMN_ERROR_INVAL) {
+        fprintf(stderr, "Invalid character in json\n");
+    } else if (rv == JSMN_ERROR_PART) {
+        fprintf(stderr, "Incomplete or invalid json structure %d\n", rv);
+    } else if (rv < 0) {
+        fprintf(stderr, "json parse failed %d\n", rv);
+    } else if (tokenp[0].type != JSMN_OBJECT) {
         fprintf(stderr, "Invalid json - must start as an object\n");
         rv = -1;
     }
     if (rv < 0) {
-        free(filebuffer);
-        if (tokenp != NULL) free(tokenp);
+        free(tokenp);
         return NULL;
     }
     tidx = 1;
-    for (int topobj = 0; topobj < tokenp[0].size; topobj++) {
+    while (member(tokenp, tidx, tokencount, tokenp[0].end)) {
 //        fprintf(stdout, "encountered at %d '%.*s' type %s\n", tidx, tokenp[tidx].end - tokenp[tidx].start, &filebuffer[tokenp[tidx].start], tokentypestring(tokenp[tidx].type));
         if (jsoneq(filebuffer, &tokenp[tidx], "system")) {
             tidx++;
             if (tokenp[tidx].type != JSMN_OBJECT || tokenp[tidx].size == 0) {
                 fprintf(stderr, "Expected object for system key\n");
-                return NULL;
+                errcount++;
+                break;
             }
-            recordcount = tokenp[tidx++].size;
-            for (int i = 0; i < recordcount; i++) {
+            end = tokenp[tidx++].end;
+            while (member(tokenp, tidx, tokencount, end)) {
                 if (jsoneq(filebuffer, &tokenp[tidx], "level") && tokenp[tidx].size == 1) {
                     tidx++;
                     level = strtol(&filebuffer[tokenp[tidx].start], &endp, 10);
@@ -211,36 +611,140 @@ ledrollhead_t *parseconfig(void)
                         break;
                     }
                     tidx++;
+                } else if (jsoneq(filebuffer, &tokenp[tidx], "timeline") && tokenp[tidx].size == 1) {
+                    tidx++;
+                    timeline = strtol(&filebuffer[tokenp[tidx].start], &endp, 10);
+                    if (tokenp[tidx].type != JSMN_PRIMITIVE || &filebuffer[tokenp[tidx].start] == endp || timeline < 0 || timeline > (UINT32_MAX / 1024)) {
+                        fprintf(stderr, "invalid system timeline value\n");
+                        errcount++;
+                        break;
+                    }
+                    tidx++;
+                } else if ((jsoneq(filebuffer, &tokenp[tidx], "width") || jsoneq(filebuffer, &tokenp[tidx], "height")) && tokenp[tidx].size == 1) {
+                    long *dimension = jsoneq(filebuffer, &tokenp[tidx], "width") ? &width : &height;
+                    tidx++;
+                    *dimension = strtol(&filebuffer[tokenp[tidx].start], &endp, 10);
+                    if (tokenp[tidx].type != JSMN_PRIMITIVE || &filebuffer[tokenp[tidx].start] == endp || *dimension < 1 || *dimension > LEDMAX) {
+                        fprintf(stderr, "invalid system %s value\n", (dimension == &width) ? "width" : "height");
+                        errcount++;
+                        break;
+                    }
+                    tidx++;
+                } else if (jsoneq(filebuffer, &tokenp[tidx], "fps") && tokenp[tidx].size == 1) {
+                    tidx++;
+                    fps = strtol(&filebuffer[tokenp[tidx].start], &endp, 10);
+                    if (tokenp[tidx].type != JSMN_PRIMITIVE || &filebuffer[tokenp[tidx].start] == endp || fps < 1 || fps > LEDFPS_MAX) {
+                        fprintf(stderr, "invalid system fps value, should be 1 to %d\n", LEDFPS_MAX);
+                        errcount++;
+                        break;
+                    }
+                    tidx++;
+                } else if (jsoneq(filebuffer, &tokenp[tidx], "layout") && tokenp[tidx].size == 1) {
+                    tidx++;
+                    if (jsoneq(filebuffer, &tokenp[tidx], "rows")) {
+                        geometry.layout = LAYOUT_ROWS;
+                    } else if (jsoneq(filebuffer, &tokenp[tidx], "serpentine")) {
+                        geometry.layout = LAYOUT_SERPENTINE;
+                    } else {
+                        fprintf(stderr, "invalid layout value, should be rows or serpentine\n");
+                        errcount++;
+                        break;
+                    }
+                    tidx++;
+                } else if (jsoneq(filebuffer, &tokenp[tidx], "channels") && tokenp[tidx].size == 1) {
+                    tidx++;
+                    if (tokenp[tidx].type != JSMN_ARRAY || tokenp[tidx].size == 0 || tokenp[tidx].size > LEDCHANNELS) {
+                        fprintf(stderr, "channels should be an array of one or %d channel objects\n", LEDCHANNELS);
+                        errcount++;
+                        break;
+                    }
+                    channels = tokenp[tidx++].size;
+                    for (int c = 0; c < channels; c++) {
+                        if (parsechannel(filebuffer, tokenp, tokencount, &tidx, c, &geometry.channel[c]) < 0) {
+                            errcount++;
+                            break;
+                        }
+                    }
+                    if (errcount > 0) break;
+                } else if (jsoneq(filebuffer, &tokenp[tidx], "realtime") && tokenp[tidx].size == 1) {
+                    tidx++;
+                    if (parserealtime(filebuffer, tokenp, tokencount, &tidx, &realtime) < 0) {
+                        errcount++;
+                        break;
+                    }
+                } else if (jsoneq(filebuffer, &tokenp[tidx], "idle") && tokenp[tidx].size == 1) {
+                    tidx++;
+                    if (parseidle(filebuffer, tokenp, tokencount, &tidx, &idle) < 0) {
+                        errcount++;
+                        break;
+                    }
+                } else if (jsoneq(filebuffer, &tokenp[tidx], "tubes") && tokenp[tidx].size == 1) {
+                    tidx++;
+                    if (parsetubes(filebuffer, tokenp, tokencount, &tidx, &tubes) < 0) {
+                        errcount++;
+                        break;
+                    }
                 } else {
                     fprintf(stderr, "invalid key for system\n");
                     errcount++;
                     break;
                 }
             }      
+            if (ledrollhead != NULL) {
+                fprintf(stderr, "system must come before roll\n");
+                errcount++;
+            }
         } else if (jsoneq(filebuffer,&tokenp[tidx], "roll")) {
             tidx++; //past LED key (optional)
+            if (ledrollhead != NULL) {
+                fprintf(stderr, "only one roll is allowed\n");
+                errcount++;
+                break;
+            }
             if (tokenp[tidx].type != JSMN_ARRAY || tokenp[tidx].size == 0) {
                 fprintf(stderr, "Expected array for all color records\n");
                 errcount++;
                 break;
             }
             recordcount = tokenp[tidx++].size;
-            ledroll = (ledroll_t *) malloc(recordcount * sizeof(ledroll_t));
-            if (ledroll == NULL) {
-                fprintf(stderr, "Out of memory building config\n");
+            if (width * height > LEDMAX) {
+                fprintf(stderr, "%ld x %ld is more than %d LEDs\n", width, height, LEDMAX);
                 errcount++;
                 break;
             }
-            ledrollhead = (ledrollhead_t *) malloc(sizeof(ledrollhead_t));
+            geometry.width = width;
+            geometry.height = height;
+            geometry.count = width * height;
+            geometry.stride = LEDFRAME_STRIDE(geometry.count);
+            if (channels == 0) {
+                geometry.channel[0] = (ledchannel_t) {.gpio = PWM1, .count = geometry.count, .brightness = 255, .strip = SK6812_STRIP};
+            }
+            channelcount = 0;
+            for (int c = 0; c < LEDCHANNELS; c++) channelcount += geometry.channel[c].count;
+            if (channelcount != geometry.count) {
+                fprintf(stderr, "channels have %u LEDs but width x height is %u\n", channelcount, geometry.count);
+                errcount++;
+                break;
+            }
+            ledrollhead = rollarena(recordcount, geometry.stride);
             if (ledrollhead == NULL) {
                 fprintf(stderr, "Out of memory building config\n");
                 errcount++;
                 break;
             }
-            ledrollhead->roll = ledroll;
-            ledrollhead->pos = 0;
+            ledroll = ledrollhead->roll;
+            levelTable(scale, level);
+            ledrollhead->geometry = geometry;
+            ledrollhead->realtime = realtime;
+            ledrollhead->idle = idle;
+            ledrollhead->tubes = tubes;
             ledrollhead->colon = col;
+            ledrollhead->timelineLimit = timeline;
             ledrollhead->count = recordcount;
+            ledrollhead->timeline = NULL;
+            ledrollhead->path = path;
+            ledrollhead->map = NULL;
+            ledrollhead->mapSize = 0;
             fast = true;
             delay = 1000; // default is 1 second (1000ms)
             for (int i = 0; i < recordcount; i++) {
@@ -249,8 +753,8 @@ ledrollhead_t *parseconfig(void)
                     errcount++;
                     break;
                 }
-                itemcount = tokenp[tidx++].size;
-                for (int j = 0; j < itemcount; j++) {
+                end = tokenp[tidx++].end;
+                while (member(tokenp, tidx, tokencount, end)) {
                     if (jsoneq(filebuffer, &tokenp[tidx], "step") && tokenp[tidx].size == 1) {
                         tidx++;
                         if(jsoneq(filebuffer, &tokenp[tidx], "slow")) {
@@ -271,12 +775,15 @@ ledrollhead_t *parseconfig(void)
                             errcount++;
                             break;
                         }
-                        if (delay < INTERPOLATE_STEP) {
-                            fprintf(stderr, "Record #%d delay is too small, should be >= %dms\n", i+1, INTERPOLATE_STEP);
+                        tidx++;
+                    } else if (jsoneq(filebuffer, &tokenp[tidx], "fps") && tokenp[tidx].size == 1) {
+                        tidx++;
+                        fps = strtol(&filebuffer[tokenp[tidx].start], &endp, 10);
+                        if (tokenp[tidx].type != JSMN_PRIMITIVE || &filebuffer[tokenp[tidx].start] == endp || fps < 1 || fps > LEDFPS_MAX) {
+                            fprintf(stderr, "invalid fps value for record #%d, should be 1 to %d\n", i+1, LEDFPS_MAX);
                             errcount++;
                             break;
                         }
-                         
                         tidx++;
                     } else if (jsoneq(filebuffer, &tokenp[tidx], "color")) {
                         tidx++;
@@ -285,28 +792,39 @@ ledrollhead_t *parseconfig(void)
                             errcount++;
                             break;
                         }
-                        if (tokenp[tidx].size != LEDCOUNT) {
-                            fprintf(stderr, "array size for LED is wrong for record #%d\n", i+1);
+                        if (tokenp[tidx].size != geometry.count) {
+                            fprintf(stderr, "array size for LED is wrong for record #%d, expected %u colors\n", i+1, geometry.count);
                             errcount++;
                             break;
                         }
             
                         tidx++;
-                        for(int k = 0; k < LEDCOUNT; k++) {
-                            if (tokenp[tidx].type != JSMN_STRING) {
+                        for(int k = 0; k < geometry.count; k++) {
+                            if (tokenp[tidx].type != JSMN_STRING || !hexcolor(filebuffer, &tokenp[tidx], &color)) {
                                 fprintf(stderr, "record #%d color array #%d needs to be hexadecimal string\n", i+1, k+1);
                                 errcount++;
                                 break;
                             }
-                            p = &filebuffer[tokenp[tidx].start];
-                            ledroll[i].color[k] = levelAdjust(strtol((*p == '#') ? p+1 : p, &endp, 16), level);
+                            ledroll_color(ledrollhead, i)[ledposition(&geometry, k)] = levelAdjust(color, scale);
                             tidx++;
                         }
+                        if (errcount > 0) break;
+                    } else {
+                        fprintf(stderr, "invalid key for record #%d\n", i+1);
+                        errcount++;
+                        break;
                     }
                     ledroll[i].isFast = fast;
                     ledroll[i].delay = delay;
                 }
                 if (errcount > 0) break;
+                /* a record has to last at least one frame */
+                if (delay < (1000 + fps - 1) / fps) {
+                    fprintf(stderr, "Record #%d delay is too small, should be >= %ldms at %ld fps\n", i+1, (1000 + fps - 1) / fps, fps);
+                    errcount++;
+                    break;
+                }
+                ledroll[i].steps = fast ? 1 : (uint32_t) (((int64_t) delay * fps) / 1000);
             }
         } else {
             fprintf(stderr, "expected roll key or system key\n");
@@ -315,19 +833,124 @@ ledrollhead_t *parseconfig(void)
         }
         if (errcount > 0) break;
     }
-    if (errcount > 0) {
-        if (ledrollhead != NULL) {
-            free(ledrollhead);
-            ledrollhead = NULL;
-        }
-        if (ledroll != NULL) {
-            free(ledroll);
-        }
+    if ((errcount > 0) && (ledrollhead != NULL)) {
+        free(ledrollhead->pixels);
+        ledrollhead = NULL;
     }
-    free(filebuffer);
     free(tokenp);
     return ledrollhead;
 }
+
+/*
+ * @brief parsefd maps the open config file read only and parses it, fd is closed
+ */
+static ledrollhead_t *parsefd(int fd, const char *path)
+{
+    struct stat st;
+    const char *json;
+    ledrollhead_t *ledrollhead;
+
+    if (fstat(fd, &st) < 0) {
+        fprintf(stderr, "unable to read config file %s: %s\n", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size == 0) {
+        fprintf(stderr, "config file %s is empty\n", path);
+        close(fd);
+        return NULL;
+    }
+    json = (const char *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (json == MAP_FAILED) {
+        fprintf(stderr, "unable to map config file %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    madvise((void *) json, st.st_size, MADV_SEQUENTIAL);
+    ledrollhead = parsejson(json, st.st_size, path);
+    munmap((void *) json, st.st_size);
+    return ledrollhead;
+}
+
+/*
+ * @brief parseconfigfile(const char *path)
+ * @param[in] path - json config to load, it has to outlive the roll
+ * @return the roll or NULL if the file can not be read or is not valid
+ */
+ledrollhead_t *parseconfigfile(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open config file %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    return parsefd(fd, path);
+}
+
+static bool newer(const struct timespec *a, const struct timespec *b)
+{
+    return (a->tv_sec > b->tv_sec) || ((a->tv_sec == b->tv_sec) && (a->tv_nsec >= b->tv_nsec));
+}
+
+/*
+ * @brief parseconfig loads the first of pathfilename that can be opened
+ * @details a compiled .pxr beside it is used instead when it is at least as new as the json,
+ * or when there is no json. A .pxr that fails its checks falls back to the json.
+ */
+ledrollhead_t *parseconfig(void)
+{
+    struct stat json, compiled;
+    ledrollhead_t *ledrollhead;
+    bool hasjson, hascompiled;
+    int fd;
+
+    for (int i = 0; i < sizeof(pathfilename)/sizeof(char *); i++) {
+        hasjson = (stat(pathfilename[i], &json) == 0);
+        hascompiled = (stat(rollfilename[i], &compiled) == 0);
+        if (hascompiled && (!hasjson || newer(&compiled.st_mtim, &json.st_mtim))) {
+            ledrollhead = rollfile_load(rollfilename[i]);
+            if (ledrollhead != NULL || !hasjson) return ledrollhead;
+            fprintf(stderr, "using %s instead\n", pathfilename[i]);
+        }
+        fd = open(pathfilename[i], O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) return parsefd(fd, pathfilename[i]);
+    }
+    fprintf(stderr, "unable to find a valid configuration file\n");
+    return NULL;
+}
+
+/*
+ * @brief configslot finds which of pathfilename a loaded roll came from
+ * @param[in] path - the path kept in the roll, either the json or its .pxr
+ * @param[out] json, compiled - the json and .pxr of that slot
+ * @return false if path is not one parseconfig() looks for
+ */
+bool configslot(const char *path, const char **json, const char **compiled)
+{
+    for (int i = 0; i < sizeof(pathfilename)/sizeof(char *); i++) {
+        if ((strcmp(path, pathfilename[i]) == 0) || (strcmp(path, rollfilename[i]) == 0)) {
+            *json = pathfilename[i];
+            *compiled = rollfilename[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * @brief freeconfig frees a roll, a parsed roll is the one arena block, a loaded .pxr is unmapped
+ */
+void freeconfig(ledrollhead_t *ledrollhead)
+{
+    if (ledrollhead == NULL) return;
+    timeline_free(ledrollhead->timeline);
+    if (ledrollhead->map != NULL) {
+        munmap(ledrollhead->map, ledrollhead->mapSize);
+        free(ledrollhead);
+    } else {
+        free(ledrollhead->pixels);
+    }
+}
                 
     
     
@@ -0,0 +1,289 @@
+/*
+ * @file reactor.c
+ * @brief runs the clock and the LED roll from one thread on one epoll set
+ * @details for raspberry pi 3B+
+ * The clock and LED threads each sleep on their own timer and wake on their own, two threads and
+ * two sets of wakeups for what is mostly one second and forty frames. Here one thread waits on
+ * every file descriptor either of them would, takes whatever is ready in priority order and hands
+ * it to the same clocktask and ledtask functions the threads use. Signals are read from a signalfd
+ * on the same set, so nothing runs in a signal handler.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+#include "nixieclock.h"
+#include "ticker.h"
+#include "framesched.h"
+#include "tasks.h"
+#include "reload.h"
+#include "trace.h"
+#include "realtime.h"
+#include "input.h"
+#include "reactor.h"
+
+#define TAG(source, fd) (((uint64_t) (source) << 32) | (uint32_t) (fd))
+
+reactorstats_t reactorstats;
+static int sigfd = -1;
+static sigset_t signals;
+
+/*
+ * @brief reactor_open() takes SIGINT, SIGTERM, SIGHUP and SIGUSR1 off the handlers and onto a
+ * signalfd. Call before any thread starts, they all inherit the blocked signals.
+ * @return 0 on success, -1 on failure
+ */
+int reactor_open(void)
+{
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &signals, NULL) != 0) {
+        fprintf(stderr, "unable to block signals for the reactor\n");
+        return -1;
+    }
+    sigfd = signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (sigfd < 0) {
+        fprintf(stderr, "unable to create signalfd: %s\n", strerror(errno));
+        pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+        return -1;
+    }
+    return 0;
+}
+
+void reactor_close(void)
+{
+    if (sigfd < 0) return;
+    close(sigfd);
+    sigfd = -1;
+    pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+}
+
+/*
+ * @brief takeSignals reads every signal queued on the signalfd and does what the handlers would
+ */
+static void takeSignals(int fd)
+{
+    struct signalfd_siginfo info;
+
+    while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+        switch (info.ssi_signo) {
+        case SIGINT:
+        case SIGTERM:
+            notifyToTerminate();
+            break;
+        case SIGHUP:
+            reload_request();
+            break;
+        case SIGUSR1:
+            trace_dump(tracePath);
+            break;
+        }
+    }
+}
+
+/*
+ * @brief drain empties an eventfd or timerfd that epoll found readable
+ */
+static void drain(int fd)
+{
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0) count = 0;
+}
+
+static int watch(int epfd, reactorSourceEnum_t source, int fd)
+{
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = TAG(source, fd)};
+
+    if (fd < 0) return 0;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        fprintf(stderr, "reactor unable to watch fd %d: %s\n", fd, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief byPriority sorts the ready events, the lower source first, there are only a handful
+ */
+static void byPriority(struct epoll_event *events, int count)
+{
+    for (int i = 1; i < count; i++) {
+        struct epoll_event e = events[i];
+        int j = i;
+        while ((j > 0) && ((events[j - 1].data.u64 >> 32) > (e.data.u64 >> 32))) {
+            events[j] = events[j - 1];
+            j--;
+        }
+        events[j] = e;
+    }
+}
+
+/*
+ * @brief flipNear(const ticker_t *tk) the ticker is due to fire, or has fired and not been taken,
+ * within REACTOR_GUARD of now
+ */
+static bool flipNear(const ticker_t *tk)
+{
+    struct timespec now;
+    int64_t left;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    left = ((int64_t) (tk->second - now.tv_sec) * 1000000000LL) - now.tv_nsec - tk->lead;
+    return (left > -REACTOR_GUARD) && (left < REACTOR_GUARD);
+}
+
+/*
+ * @brief reactorTask runs the clock and the LEDs until terminated
+ * @param[in] threadid the LED roll main read, NULL to read it here
+ */
+void *reactorTask(void *threadid)
+{
+    struct epoll_event events[REACTOR_EVENTS];
+    struct timespec now;
+    ledrollhead_t *roll;
+    clockstate_t *cs;
+    ledstate_t *ls = NULL;
+    ticker_t ticker;
+    framesched_t sched;
+    int64_t deadline;
+    int64_t armed = FRAMESCHED_STOP;    /* deadline the frame timer is set for, none yet */
+    bool stop = false;
+    bool due, defer, woken;
+    int epfd, count;
+    int rv = 0;
+
+    trace_thread("reactor");
+    /* it flips the tubes, so it runs as the clock does */
+    realtime_thread(RT_CLOCK);
+    memset(&reactorstats, 0, sizeof(reactorstats));
+    roll = (threadid != NULL) ? (ledrollhead_t *) threadid : loadconfig();
+    if (roll == NULL) {
+        fprintf(stderr,"configuration file not valid\n");
+        notifyToTerminate();
+        pthread_exit((void *)EXIT_FAILURE);
+    }
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    cs = clocktask_open(&ticker);
+    if (cs != NULL) ls = ledtask_open(roll, &sched);
+    else freeconfig(roll);
+    if ((epfd < 0) || (ls == NULL)
+        || (watch(epfd, REACTOR_TICK, ticker.fd) < 0) || (watch(epfd, REACTOR_STOP, terminate.fd) < 0)
+        || (watch(epfd, REACTOR_SIGNAL, sigfd) < 0) || (watch(epfd, REACTOR_DISPLAY, input_fd(INPUT_DISPLAY)) < 0)
+        || (watch(epfd, REACTOR_FRAME, sched.fd) < 0) || (watch(epfd, REACTOR_LED, sched.wakefd[0]) < 0)
+        || (watch(epfd, REACTOR_LED, sched.wakefd[1]) < 0) || (watch(epfd, REACTOR_LED, sched.wakefd[2]) < 0)) {
+        notifyToTerminate();
+        stop = true;
+    }
+    while (!stop && !isTerminate()) {
+        deadline = ledtask_deadline(ls);
+        due = (framesched_now(&sched) >= deadline);
+        /* the flip goes first, a frame due right around it waits for the tick */
+        defer = due && flipNear(&ticker);
+        if (defer) reactorstats.deferred++;
+        if (!due && (deadline != armed)) {
+            framesched_arm(&sched, deadline);
+            armed = deadline;
+        }
+        trace_event(TRACE_SLEEP, 0);
+        count = epoll_wait(epfd, events, REACTOR_EVENTS, (due && !defer) ? 0 : -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "reactor epoll failed: %s\n", strerror(errno));
+            notifyToTerminate();
+            break;
+        }
+        reactorstats.wakeups++;
+        byPriority(events, count);
+        woken = false;
+        for (int i = 0; (i < count) && !stop; i++) {
+            int fd = (int) (uint32_t) events[i].data.u64;
+            reactorSourceEnum_t source = events[i].data.u64 >> 32;
+            reactorstats.handled[source]++;
+            switch (source) {
+            case REACTOR_TICK:
+                clock_gettime(CLOCK_REALTIME, &now);
+                rv = ticker_read(&ticker, &now);
+                trace_event(TRACE_WAKE, trace_ns(ticker.late));
+                stop = (clocktask_wake(cs, &ticker, rv, &now) < 0);
+                break;
+            case REACTOR_STOP:
+                stop = true;
+                break;
+            case REACTOR_SIGNAL:
+                takeSignals(fd);
+                break;
+            case REACTOR_DISPLAY:
+                drain(fd);
+                clock_gettime(CLOCK_REALTIME, &now);
+                stop = (clocktask_wake(cs, &ticker, TICKER_WAKE, &now) < 0);
+                break;
+            case REACTOR_FRAME:
+                drain(fd);
+                armed = FRAMESCHED_STOP;    /* one shot, it is disarmed now */
+                break;
+            default:
+                drain(fd);
+                woken = true;
+                break;
+            }
+        }
+        if (stop || isTerminate()) break;
+        if ((framesched_now(&sched) >= deadline) && !flipNear(&ticker)) {
+            rv = ledtask_frame(ls, &sched, framesched_due(&sched, deadline));
+        } else if (woken) {
+            rv = ledtask_frame(ls, &sched, FRAMESCHED_WAKE);
+        }
+        if (rv < 0) break;
+    }
+#ifdef DEBUG
+    fprintf(stdout, "reactor wakeups %llu tick %llu display %llu frame %llu led %llu signal %llu deferred %llu\n",
+        (unsigned long long) reactorstats.wakeups, (unsigned long long) reactorstats.handled[REACTOR_TICK],
+        (unsigned long long) reactorstats.handled[REACTOR_DISPLAY], (unsigned long long) reactorstats.handled[REACTOR_FRAME],
+        (unsigned long long) reactorstats.handled[REACTOR_LED], (unsigned long long) reactorstats.handled[REACTOR_SIGNAL],
+        (unsigned long long) reactorstats.deferred);
+#endif
+    if (epfd >= 0) close(epfd);
+    clocktask_close(cs, &ticker);
+    if (ls != NULL) ledtask_close(ls, &sched);
+    return NULL;
+}
@@ -0,0 +1,149 @@
+/*
+ * @file realtime.c
+ * @brief applies the realtime settings of the system block to the daemon and its threads
+ * @details for raspberry pi 3B+
+ * Under the normal scheduler the clock shares the cores with apt, journald and everything else, a
+ * busy moment lands on the flip. SCHED_FIFO runs it ahead of all of them and pinning it to a core
+ * left out of the kernel's load balancing (isolcpus) keeps them off its core entirely. Locked
+ * memory keeps a page fault from ever stalling it. Every step can be refused, none is required.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "nixieclock.h"
+#include "realtime.h"
+
+realtime_t realtime = REALTIME_OFF;
+static bool locked = false;
+
+/*
+ * @brief refused logs a setting the daemon was not allowed, to stderr and syslog
+ */
+static void refused(const char *format, ...)
+{
+    va_list args, copy;
+
+    va_start(args, format);
+    va_copy(copy, args);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    vsyslog(LOG_WARNING, format, copy);
+    va_end(copy);
+    va_end(args);
+}
+
+/*
+ * @brief realtime_lock() locks the daemon's memory when the config asks for it
+ * @details called by main before the threads start, so their stacks are locked and resident as
+ * they are made and no page of the daemon is paged out under memory pressure.
+ * @return 0, or -1 if the lock was refused, the daemon carries on without it
+ */
+int realtime_lock(void)
+{
+    if (!realtime.lock) return 0;
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        int err = errno;
+        refused("memory left unlocked, mlockall refused: %s%s", strerror(err),
+            ((err == EPERM) || (err == ENOMEM)) ? " (needs root, CAP_IPC_LOCK or a larger RLIMIT_MEMLOCK)" : "");
+        return -1;
+    }
+    locked = true;
+    syslog(LOG_INFO, "memory locked");
+    return 0;
+}
+
+void realtime_unlock(void)
+{
+    if (locked) munlockall();
+    locked = false;
+}
+
+/*
+ * @brief prefault touches a page at a time of REALTIME_PREFAULT of stack below the caller
+ */
+static void __attribute__((noinline)) prefault(void)
+{
+    volatile uint8_t stack[REALTIME_PREFAULT];
+    long page = sysconf(_SC_PAGESIZE);
+
+    if (page <= 0) page = 4096;
+    for (size_t i = 0; i < sizeof(stack); i += page) stack[i] = 0;
+}
+
+/*
+ * @brief realtime_thread(rtThreadEnum_t which) called by a thread as it starts, pins it to its
+ * cpu, moves it to SCHED_FIFO and prefaults its stack as its settings ask
+ * @return how many of its settings were refused, those are logged and left as they were
+ */
+int realtime_thread(rtThreadEnum_t which)
+{
+    static const char *names[RT_THREADS] = REALTIME_NAMES;
+    const rtthread_t *t = &realtime.thread[which];
+    struct sched_param param = {.sched_priority = t->priority};
+    cpu_set_t cpus;
+    int refusals = 0;
+    int rv;
+
+    if (t->cpu != REALTIME_ANY) {
+        CPU_ZERO(&cpus);
+        CPU_SET(t->cpu, &cpus);
+        rv = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (rv != 0) {
+            refused("%s thread left on any cpu, cpu %d refused: %s%s", names[which], t->cpu, strerror(rv),
+                (rv == EINVAL) ? " (no such cpu online)" : "");
+            refusals++;
+        }
+    }
+    if (t->priority > 0) {
+        rv = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (rv != 0) {
+            refused("%s thread left on the normal scheduler, SCHED_FIFO %d refused: %s%s", names[which], t->priority,
+                strerror(rv), (rv == EPERM) ? " (needs root, CAP_SYS_NICE or RLIMIT_RTPRIO)" : "");
+            refusals++;
+        }
+    }
+    if (refusals == 0) {
+        if (t->priority > 0) syslog(LOG_INFO, "%s thread SCHED_FIFO %d", names[which], t->priority);
+        if (t->cpu != REALTIME_ANY) syslog(LOG_INFO, "%s thread pinned to cpu %d", names[which], t->cpu);
+    }
+    if (locked) prefault();
+    return refusals;
+}
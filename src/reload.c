@@ -0,0 +1,278 @@
+/*
+ * @file reload.c
+ * @brief background reload of the LED roll
+ * @details for raspberry pi 3B+
+ * SIGHUP writes to an eventfd, which is all a signal handler can safely do, and the directory of the
+ * config file is watched with inotify so saving the json, or compiling it again into its .pxr, is
+ * enough. The reload thread parses and compiles the new roll while the old one keeps playing. A new
+ * roll with different LED geometry or channels is refused, the strips would have to be set up again
+ * which blanks them.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+#include "nixieclock.h"
+#include "timeline.h"
+#include "reload.h"
+
+static int wakefd = -1;
+static _Atomic(ledrollhead_t *) pending = NULL;  /* parsed, waiting for the next frame boundary */
+static _Atomic(ledrollhead_t *) retired = NULL;  /* replaced by the render loop, waiting to be freed */
+static atomic_bool ready = false;
+/* written once before ready is set */
+static ledgeometry_t activeGeometry;
+static char activePath[PATH_MAX];
+
+/*
+ * @brief loadconfig() parses the config file and compiles the timeline if it fits its limit
+ * @return the roll or NULL if the file is not valid
+ */
+ledrollhead_t *loadconfig(void)
+{
+    ledrollhead_t *ledrollhead = parseconfig();
+    if (ledrollhead == NULL) return NULL;
+    if (ledrollhead->timelineLimit > 0) {
+        ledrollhead->timeline = timeline_compile(ledrollhead, (size_t) ledrollhead->timelineLimit * 1024);
+        if (ledrollhead->timeline == NULL) {
+            fprintf(stderr,"LED timeline needs %zu bytes with a %u KB limit, interpolating instead\n",
+                timeline_size(ledrollhead), ledrollhead->timelineLimit);
+        }
+    }
+    return ledrollhead;
+}
+
+int reload_open(void)
+{
+    wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakefd < 0) {
+        fprintf(stderr, "unable to create the reload eventfd: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief reload_request() asks for the config to be read again, safe to call from a signal handler
+ */
+void reload_request(void)
+{
+    uint64_t one = 1;
+    if (wakefd >= 0) {
+        ssize_t rv = write(wakefd, &one, sizeof(one));
+        (void) rv;
+    }
+}
+
+/*
+ * @brief reload_ready(const ledrollhead_t *active) called by ledTask once the strips are set up
+ * with the roll it started with, reloads must keep its geometry
+ */
+void reload_ready(const ledrollhead_t *active)
+{
+    activeGeometry = active->geometry;
+    strncpy(activePath, active->path, sizeof(activePath) - 1);
+    atomic_store_explicit(&ready, true, memory_order_release);
+}
+
+/*
+ * @brief reload_take(ledrollhead_t *current) called by the render loop between frames
+ * @return a newly loaded roll to play instead of current, which is handed back to be freed,
+ * or NULL to carry on with current
+ */
+ledrollhead_t *reload_take(ledrollhead_t *current)
+{
+    ledrollhead_t *next;
+    ledrollhead_t *old;
+
+    if (atomic_load_explicit(&pending, memory_order_relaxed) == NULL) return NULL;
+    next = atomic_exchange_explicit(&pending, NULL, memory_order_acquire);
+    if (next == NULL) return NULL;
+    old = atomic_exchange_explicit(&retired, current, memory_order_release);
+    /* the reload thread collects before it publishes so this should not happen, but never leak */
+    freeconfig(old);
+    return next;
+}
+
+void reload_close(void)
+{
+    freeconfig(atomic_exchange(&pending, NULL));
+    freeconfig(atomic_exchange(&retired, NULL));
+    if (wakefd >= 0) close(wakefd);
+    wakefd = -1;
+}
+
+static bool sameGeometry(const ledgeometry_t *a, const ledgeometry_t *b)
+{
+    if ((a->width != b->width) || (a->height != b->height) || (a->layout != b->layout)) return false;
+    for (int c = 0; c < LEDCHANNELS; c++) {
+        const ledchannel_t *x = &a->channel[c];
+        const ledchannel_t *y = &b->channel[c];
+        if ((x->gpio != y->gpio) || (x->count != y->count) || (x->brightness != y->brightness) || (x->strip != y->strip)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void reload(void)
+{
+    ledrollhead_t *ledrollhead = loadconfig();
+
+    if (ledrollhead == NULL) {
+        fprintf(stderr, "LED config reload failed, keeping the current roll\n");
+        return;
+    }
+    if (!sameGeometry(&ledrollhead->geometry, &activeGeometry)) {
+        fprintf(stderr, "LED geometry or channels changed in %s, restart the daemon to use them\n", ledrollhead->path);
+        freeconfig(ledrollhead);
+        return;
+    }
+    freeconfig(atomic_exchange_explicit(&retired, NULL, memory_order_acquire));
+    /* a roll that was published but never taken is replaced, the render loop never saw it */
+    freeconfig(atomic_exchange_explicit(&pending, ledrollhead, memory_order_acq_rel));
+    fprintf(stdout, "LED roll reloaded from %s\n", ledrollhead->path);
+}
+
+static int64_t msnow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+/*
+ * @brief watchconfig(int fd) adds an inotify watch on the directory of the active config file
+ * @return watch descriptor or -1, reloads still work with SIGHUP without it
+ */
+static int watchconfig(int fd)
+{
+    char dir[PATH_MAX];
+    int wd;
+
+    strncpy(dir, activePath, sizeof(dir) - 1);
+    dir[sizeof(dir) - 1] = '\0';
+    wd = inotify_add_watch(fd, dirname(dir), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) fprintf(stderr, "unable to watch %s for changes: %s\n", activePath, strerror(errno));
+    return wd;
+}
+
+/*
+ * @brief configchanged(int fd, char names[][NAME_MAX + 1], int count)
+ * @return true if any queued inotify event is for one of the count file names
+ */
+static bool configchanged(int fd, char names[][NAME_MAX + 1], int count)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t length;
+
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + length; ) {
+            struct inotify_event *event = (struct inotify_event *) p;
+            for (int n = 0; (event->len > 0) && (n < count); n++) {
+                if (strcmp(event->name, names[n]) == 0) changed = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+
+void *reloadTask(void *threadid)
+{
+    struct pollfd fds[3];
+    char file[PATH_MAX];
+    char names[2][NAME_MAX + 1];
+    const char *paths[2] = {activePath, NULL};
+    int namecount = 1;
+    int64_t settle = -1;
+    int timeout;
+    uint64_t count;
+
+    while (!atomic_load_explicit(&ready, memory_order_acquire)) {
+        if (terminateWait(RELOAD_POLL_MS)) return NULL;
+    }
+    /* saving the json or compiling it again both count, parseconfig() picks the newer of the two */
+    if (configslot(activePath, &paths[0], &paths[1])) namecount = 2;
+    for (int n = 0; n < namecount; n++) {
+        strncpy(file, paths[n], sizeof(file) - 1);
+        file[sizeof(file) - 1] = '\0';
+        strncpy(names[n], basename(file), NAME_MAX);
+        names[n][NAME_MAX] = '\0';
+    }
+    fds[0].fd = wakefd;
+    fds[0].events = POLLIN;
+    fds[1].fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    fds[1].events = POLLIN;
+    if ((fds[1].fd >= 0) && (watchconfig(fds[1].fd) < 0)) {
+        close(fds[1].fd);
+        fds[1].fd = -1;
+    }
+    fds[2].fd = terminate.fd;
+    fds[2].events = POLLIN;
+    while (!isTerminate()) {
+        timeout = -1;
+        if (settle >= 0) {
+            int64_t left = settle - msnow();
+            if (left <= 0) {
+                settle = -1;
+                reload();
+                continue;
+            }
+            timeout = left;
+        }
+        if (poll(fds, 3, timeout) <= 0) continue;
+        if (fds[2].revents & POLLIN) break;
+        if (fds[0].revents & POLLIN) {
+            if (read(wakefd, &count, sizeof(count)) == sizeof(count)) {
+                settle = -1;
+                reload();
+            }
+        }
+        if ((fds[1].fd >= 0) && (fds[1].revents & POLLIN)) {
+            if (configchanged(fds[1].fd, names, namecount)) settle = msnow() + RELOAD_SETTLE_MS;
+        }
+    }
+    if (fds[1].fd >= 0) close(fds[1].fd);
+    return NULL;
+}
@@ -0,0 +1,333 @@
+/*
+ * @file rollfile.c
+ * @brief writes and maps the compiled LED roll file
+ * @details for raspberry pi 3B+
+ * A .pxr holds the roll as parseconfig() leaves it in memory, so loading one is a check of the header
+ * and the CRC, and a check of each record the render loop divides by. Nothing is decoded or copied,
+ * the records and frames are used where they are mapped. A big animation is then clean page cache
+ * the kernel can drop and read back, not anonymous heap.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "nixieclock.h"
+#include "rollfile.h"
+#include "realtime.h"
+#include "idle.h"
+#include "tubefx.h"
+
+_Static_assert(sizeof(rollfileheader_t) == 168, "rollfile header layout changed, bump ROLLFILE_VERSION");
+_Static_assert((sizeof(ledroll_t) == 12) && (offsetof(ledroll_t, isFast) == 8), "ledroll_t layout changed, bump ROLLFILE_VERSION");
+
+#define ROLLFILE_ROLL_ALIGN 8
+
+/* slicing by 8, crctable[k][b] is the CRC of byte b followed by k zero bytes */
+static uint32_t crctable[8][256];
+static pthread_once_t crconce = PTHREAD_ONCE_INIT;
+
+static void crcinit(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+        crctable[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) crctable[k][i] = crctable[0][crctable[k - 1][i] & 0xFF] ^ (crctable[k - 1][i] >> 8);
+    }
+}
+
+/*
+ * @brief rollfile_crc(uint32_t crc, const void *data, size_t length)
+ * CRC-32 (the zip and ethernet one) of data, pass 0 to start or the last result to continue
+ * @details the whole file is checked on every load, eight bytes a step keeps that a few
+ * milliseconds for a roll of megabytes. The loads are little endian like the file.
+ */
+uint32_t rollfile_crc(uint32_t crc, const void *data, size_t length)
+{
+    const uint8_t *p = (const uint8_t *) data;
+    uint32_t lo, hi;
+
+    pthread_once(&crconce, crcinit);
+    crc = ~crc;
+    for (; length >= 8; length -= 8, p += 8) {
+        memcpy(&lo, p, sizeof(lo));
+        memcpy(&hi, p + 4, sizeof(hi));
+        lo ^= crc;
+        crc = crctable[7][lo & 0xFF] ^ crctable[6][(lo >> 8) & 0xFF] ^ crctable[5][(lo >> 16) & 0xFF] ^ crctable[4][lo >> 24]
+            ^ crctable[3][hi & 0xFF] ^ crctable[2][(hi >> 8) & 0xFF] ^ crctable[1][(hi >> 16) & 0xFF] ^ crctable[0][hi >> 24];
+    }
+    while (length--) crc = crctable[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static inline uint64_t alignup(uint64_t n, uint64_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+/*
+ * @brief checkheader makes sure everything the header points at is inside the file and that the
+ * geometry is one parseconfig() could have produced
+ * @return 0 or -1 with the reason printed
+ */
+static int checkheader(const rollfileheader_t *h, uint64_t size, const char *path)
+{
+    uint64_t leds = (uint64_t) h->width * h->height;
+    uint64_t channelcount = 0;
+
+    if (h->headerSize != sizeof(rollfileheader_t) || h->size != size) {
+        fprintf(stderr, "roll file %s is truncated or has a bad header\n", path);
+        return -1;
+    }
+    if (h->count == 0 || h->count > INT32_MAX || h->width == 0 || h->height == 0 || leds > LEDMAX
+        || h->stride != LEDFRAME_STRIDE(leds) || h->layout > LAYOUT_SERPENTINE || h->colon > COLON_ON) {
+        fprintf(stderr, "roll file %s has an invalid geometry\n", path);
+        return -1;
+    }
+    for (int c = 0; c < LEDCHANNELS; c++) channelcount += h->channel[c].count;
+    if (channelcount != leds) {
+        fprintf(stderr, "roll file %s channels have %llu LEDs but width x height is %llu\n", path,
+            (unsigned long long) channelcount, (unsigned long long) leds);
+        return -1;
+    }
+    if ((h->rollOffset % ROLLFILE_ROLL_ALIGN) != 0 || h->rollOffset < sizeof(rollfileheader_t)
+        || h->rollOffset + ((uint64_t) h->count * sizeof(ledroll_t)) > size
+        || (h->pixelOffset % LEDFRAME_ALIGN) != 0 || h->pixelOffset < h->rollOffset
+        || h->pixelOffset + ((uint64_t) h->count * h->stride * sizeof(uint32_t)) > size) {
+        fprintf(stderr, "roll file %s records or frames are outside the file\n", path);
+        return -1;
+    }
+    for (int t = 0; t < RT_THREADS; t++) {
+        if (h->realtime.thread[t].priority < 0 || h->realtime.thread[t].priority > REALTIME_PRIORITY_MAX
+            || h->realtime.thread[t].cpu < REALTIME_ANY || h->realtime.thread[t].cpu > REALTIME_CPU_MAX) {
+            fprintf(stderr, "roll file %s has invalid realtime settings\n", path);
+            return -1;
+        }
+    }
+    if ((h->idle.presence > IDLE_PRESENCE_MAX) || (h->idle.from < -1) || (h->idle.from >= IDLE_MINUTES)
+        || (h->idle.until < -1) || (h->idle.until >= IDLE_MINUTES) || ((h->idle.from < 0) != (h->idle.until < 0))) {
+        fprintf(stderr, "roll file %s has invalid idle settings\n", path);
+        return -1;
+    }
+    if ((h->tubes.fade > TUBEFX_FADE_MAX) || (h->tubes.brightness < 1) || (h->tubes.brightness > 100)
+        || (h->tubes.refreshEvery > TUBEFX_EVERY_MAX) || (h->tubes.refreshAt < -1) || (h->tubes.refreshAt >= TUBEFX_EVERY_MAX)
+        || (h->tubes.refreshSeconds > TUBEFX_REFRESH_MAX)
+        || (((h->tubes.refreshEvery > 0) || (h->tubes.refreshAt >= 0)) != (h->tubes.refreshSeconds > 0))) {
+        fprintf(stderr, "roll file %s has invalid tube settings\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief rollfile_load(const char *path)
+ * maps a .pxr read only and builds a roll head pointing into it
+ * @param[in] path - file to load, it has to outlive the roll
+ * @return the roll or NULL if the file can not be read, is from another version or fails its checks
+ */
+ledrollhead_t *rollfile_load(const char *path)
+{
+    struct stat st;
+    const uint8_t *map;
+    rollfileheader_t h;
+    ledrollhead_t *ledrollhead;
+    const ledroll_t *roll;
+    uint32_t crc;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open roll file %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(rollfileheader_t)) {
+        fprintf(stderr, "roll file %s is too short\n", path);
+        close(fd);
+        return NULL;
+    }
+    /* shared so every reader of the file uses the same page cache */
+    map = (const uint8_t *) mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "unable to map roll file %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    memcpy(&h, map, sizeof(h));
+    if (memcmp(h.magic, ROLLFILE_MAGIC, sizeof(h.magic)) != 0 || h.byteOrder != ROLLFILE_BYTEORDER) {
+        fprintf(stderr, "%s is not a roll file for this machine, run pixie-compile on it again\n", path);
+        goto fail;
+    }
+    if (h.version != ROLLFILE_VERSION) {
+        fprintf(stderr, "roll file %s is version %u, this daemon reads version %u\n", path, h.version, ROLLFILE_VERSION);
+        goto fail;
+    }
+    if (checkheader(&h, st.st_size, path) < 0) goto fail;
+    h.crc = 0;
+    crc = rollfile_crc(0, &h, sizeof(h));
+    crc = rollfile_crc(crc, map + sizeof(h), st.st_size - sizeof(h));
+    if (crc != ((const rollfileheader_t *) map)->crc) {
+        fprintf(stderr, "roll file %s is corrupt, CRC does not match\n", path);
+        goto fail;
+    }
+    /* the render loop divides by steps and reads isFast as a bool */
+    roll = (const ledroll_t *) (map + h.rollOffset);
+    for (uint32_t i = 0; i < h.count; i++) {
+        uint8_t fast = *((const uint8_t *) &roll[i] + offsetof(ledroll_t, isFast));
+        if (roll[i].delay <= 0 || roll[i].steps == 0 || fast > 1) {
+            fprintf(stderr, "roll file %s record #%u is not valid\n", path, i + 1);
+            goto fail;
+        }
+    }
+    ledrollhead = (ledrollhead_t *) calloc(1, sizeof(ledrollhead_t));
+    if (ledrollhead == NULL) {
+        fprintf(stderr, "Out of memory loading %s\n", path);
+        goto fail;
+    }
+    ledrollhead->count = h.count;
+    ledrollhead->colon = h.colon;
+    ledrollhead->timelineLimit = h.timelineLimit;
+    ledrollhead->realtime = h.realtime;
+    ledrollhead->idle = h.idle;
+    ledrollhead->tubes = h.tubes;
+    ledrollhead->geometry.width = h.width;
+    ledrollhead->geometry.height = h.height;
+    ledrollhead->geometry.count = h.width * h.height;
+    ledrollhead->geometry.stride = h.stride;
+    ledrollhead->geometry.layout = h.layout;
+    for (int c = 0; c < LEDCHANNELS; c++) {
+        ledrollhead->geometry.channel[c] = (ledchannel_t) {.gpio = h.channel[c].gpio, .count = h.channel[c].count,
+            .brightness = h.channel[c].brightness, .strip = h.channel[c].strip};
+    }
+    /* the roll is never written, the mapping is read only */
+    ledrollhead->roll = (ledroll_t *) roll;
+    ledrollhead->pixels = (uint32_t *) (map + h.pixelOffset);
+    ledrollhead->timeline = NULL;
+    ledrollhead->path = path;
+    ledrollhead->map = (void *) map;
+    ledrollhead->mapSize = st.st_size;
+    return ledrollhead;
+fail:
+    munmap((void *) map, st.st_size);
+    return NULL;
+}
+
+static int writeblock(FILE *fout, uint32_t *crc, const void *data, size_t length)
+{
+    *crc = rollfile_crc(*crc, data, length);
+    return (fwrite(data, 1, length, fout) == length) ? 0 : -1;
+}
+
+/*
+ * @brief rollfile_write(const ledrollhead_t *ledrollhead, const char *path)
+ * writes the roll as a .pxr next to path and renames it into place, a daemon playing the old file
+ * keeps its mapping of it
+ * @return 0 on success, -1 on failure
+ */
+int rollfile_write(const ledrollhead_t *ledrollhead, const char *path)
+{
+    static const uint8_t zero[LEDFRAME_ALIGN];
+    rollfileheader_t h;
+    uint32_t crc = 0;
+    size_t length = strlen(path);
+    char *tmp;
+    FILE *fout;
+    int rv = 0;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, ROLLFILE_MAGIC, sizeof(h.magic));
+    h.version = ROLLFILE_VERSION;
+    h.headerSize = sizeof(h);
+    h.byteOrder = ROLLFILE_BYTEORDER;
+    h.count = ledrollhead->count;
+    h.colon = ledrollhead->colon;
+    h.timelineLimit = ledrollhead->timelineLimit;
+    h.realtime = ledrollhead->realtime;
+    h.idle = ledrollhead->idle;
+    h.tubes = ledrollhead->tubes;
+    h.width = ledrollhead->geometry.width;
+    h.height = ledrollhead->geometry.height;
+    h.stride = ledrollhead->geometry.stride;
+    h.layout = ledrollhead->geometry.layout;
+    for (int c = 0; c < LEDCHANNELS; c++) {
+        const ledchannel_t *channel = &ledrollhead->geometry.channel[c];
+        h.channel[c] = (rollfilechannel_t) {.gpio = channel->gpio, .count = channel->count,
+            .brightness = channel->brightness, .strip = channel->strip};
+    }
+    h.rollOffset = alignup(sizeof(h), ROLLFILE_ROLL_ALIGN);
+    h.pixelOffset = alignup(h.rollOffset + ((uint64_t) h.count * sizeof(ledroll_t)), LEDFRAME_ALIGN);
+    h.size = h.pixelOffset + ((uint64_t) h.count * h.stride * sizeof(uint32_t));
+
+    tmp = (char *) malloc(length + 5);
+    if (tmp == NULL) return -1;
+    memcpy(tmp, path, length);
+    memcpy(tmp + length, ".tmp", 5);
+    fout = fopen(tmp, "w");
+    if (fout == NULL) {
+        fprintf(stderr, "unable to create %s: %s\n", tmp, strerror(errno));
+        free(tmp);
+        return -1;
+    }
+    rv |= writeblock(fout, &crc, &h, sizeof(h));
+    rv |= writeblock(fout, &crc, zero, h.rollOffset - sizeof(h));
+    for (uint32_t i = 0; i < h.count; i++) {
+        ledroll_t record;
+        /* the padding after isFast is part of the CRC, it has to be zero */
+        memset(&record, 0, sizeof(record));
+        record.delay = ledrollhead->roll[i].delay;
+        record.steps = ledrollhead->roll[i].steps;
+        record.isFast = ledrollhead->roll[i].isFast;
+        rv |= writeblock(fout, &crc, &record, sizeof(record));
+    }
+    rv |= writeblock(fout, &crc, zero, h.pixelOffset - h.rollOffset - ((uint64_t) h.count * sizeof(ledroll_t)));
+    rv |= writeblock(fout, &crc, ledrollhead->pixels, (size_t) h.count * h.stride * sizeof(uint32_t));
+    h.crc = crc;
+    if (fseek(fout, offsetof(rollfileheader_t, crc), SEEK_SET) < 0) rv = -1;
+    if (fwrite(&h.crc, sizeof(h.crc), 1, fout) != 1) rv = -1;
+    if (fflush(fout) != 0 || fsync(fileno(fout)) < 0) rv = -1;
+    if (fclose(fout) != 0) rv = -1;
+    if (rv == 0 && rename(tmp, path) < 0) rv = -1;
+    if (rv < 0) {
+        fprintf(stderr, "unable to write roll file %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+    }
+    free(tmp);
+    return rv;
+}
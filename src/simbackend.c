@@ -0,0 +1,207 @@
+/**
+ * @file simbackend.c
+ * @brief simulated backend that records instead of driving hardware
+ * @details SPI transfers take as long as they would on the wire at SPI_SPEED, GPIO writes go to
+ * a shadow register block and LED renders are hashed. Like rpi_ws281x, a render waits for the
+ * previous frame to finish clocking out, then returns while the new one is on the wire. Everything is logged with a CLOCK_REALTIME
+ * timestamp in simlog so latency can be measured against the second boundary.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date 10/17/2026
+ *
+ **/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gpiopi.h"
+#include "spipi.h"
+#include "backend.h"
+
+/* size of the BCM2837 GPIO register block */
+#define SIM_GPIO_SIZE 180
+/* ws2811 latch time after the last bit of a frame */
+#define SIM_LED_RESET 55000LL
+
+/* when the LED frame being sent is finished, both PWM channels shift out at the same time */
+static int64_t simLedBusy;
+
+simlog_t simlog;
+
+static inline int64_t sim_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+static void sim_record(int64_t ns, uint32_t type, uint32_t arg, uint64_t data)
+{
+    uint64_t idx = atomic_fetch_add_explicit(&simlog.head, 1, memory_order_relaxed);
+    simevent_t *e = &simlog.event[idx & (SIM_EVENTS - 1)];
+    e->ns = ns;
+    e->type = type;
+    e->arg = arg;
+    e->data = data;
+}
+
+void sim_reset(void)
+{
+    atomic_store(&simlog.head, 0);
+}
+
+static int sim_spi_open(void)
+{
+    return open("/dev/null", O_RDWR);
+}
+
+static int sim_spi_transfer(int fd, uint8_t *txbuf, uint8_t *rxbuf, uint32_t length)
+{
+    uint64_t word = 0;
+    int64_t start = sim_now();
+    struct timespec wire;
+    int64_t ns = ((int64_t) length * 8 * 1000000000LL) / SPI_SPEED;
+
+    memcpy(&word, txbuf, (length < sizeof(word)) ? length : sizeof(word));
+    if (rxbuf != NULL) memset(rxbuf, 0, length);
+    sim_record(start, SIM_SPI_WORD, length, word);
+    /* hold the caller for as long as the bits take to clock out */
+    wire.tv_sec = ns / 1000000000LL;
+    wire.tv_nsec = ns % 1000000000LL;
+    nanosleep(&wire, NULL);
+    return length;
+}
+
+/*
+ * each word is logged with the chip select going low as it starts shifting and high as it latches,
+ * spaced as spi_burst() spaces them, the caller is held until the last word has shown as the ioctl
+ * would
+ */
+static int sim_spi_burst(int fd, uint8_t *txbuf, uint32_t length, const uint16_t *show, uint32_t count)
+{
+    int64_t at = sim_now();
+    int64_t shift = ((int64_t) length * 8 * 1000000000LL) / SPI_BURST_SPEED;
+    int64_t gap = SPI_CS_GAP_US * 1000LL;
+    int64_t delay;
+    uint64_t word;
+    struct timespec end;
+
+    if (count > SPI_BURST_MAX - 1) count = SPI_BURST_MAX - 1;
+    for (uint32_t i = 0; i <= count; i++) {
+        delay = (i > 0) ? ((int64_t) show[i - 1] * 1000) - shift - gap : 0;
+        if (i == count) {
+            at += (delay > 0) ? delay : 0;
+            break;
+        }
+        word = 0;
+        memcpy(&word, &txbuf[i * length], (length < sizeof(word)) ? length : sizeof(word));
+        sim_record(at, SIM_GPIO_CLEAR, SPI_CS_PIN, 0);
+        sim_record(at, SIM_SPI_WORD, length, word);
+        at += shift + ((delay > 0) ? delay : 0);
+        sim_record(at, SIM_GPIO_SET, SPI_CS_PIN, 0);
+        at += gap;
+    }
+    end.tv_sec = at / 1000000000LL;
+    end.tv_nsec = at % 1000000000LL;
+    while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &end, NULL) == EINTR) continue;
+    return count * length;
+}
+
+static void *sim_gpio_open(void)
+{
+    return calloc(1, SIM_GPIO_SIZE);
+}
+
+static void sim_gpio_function(void *map, uint8_t pin, uint32_t function)
+{
+    gpio_set_function_select(map, pin, function);
+}
+
+static void sim_gpio_set(void *map, uint8_t pin)
+{
+    int64_t ns = sim_now();
+    gpio_set_value(map, pin, true);
+    sim_record(ns, SIM_GPIO_SET, pin, 0);
+}
+
+static void sim_gpio_clear(void *map, uint8_t pin)
+{
+    int64_t ns = sim_now();
+    gpio_set_value(map, pin, false);
+    sim_record(ns, SIM_GPIO_CLEAR, pin, 0);
+}
+
+static ws2811_return_t sim_led_init(ws2811_t *ws2811)
+{
+    for (int i = 0; i < RPI_PWM_CHANNELS; i++) {
+        ws2811_channel_t *channel = &ws2811->channel[i];
+        channel->leds = NULL;
+        if (channel->count == 0) continue;
+        channel->leds = calloc(channel->count, sizeof(ws2811_led_t));
+        if (channel->leds == NULL) return WS2811_ERROR_OUT_OF_MEMORY;
+    }
+    return WS2811_SUCCESS;
+}
+
+static ws2811_return_t sim_led_render(ws2811_t *ws2811)
+{
+    int64_t ns = sim_now();
+    uint64_t hash = 14695981039346656037ULL;
+    uint32_t count = 0;
+    int64_t wire = 0;
+    struct timespec wait;
+
+    if (ns < simLedBusy) {
+        wait.tv_sec = (simLedBusy - ns) / 1000000000LL;
+        wait.tv_nsec = (simLedBusy - ns) % 1000000000LL;
+        nanosleep(&wait, NULL);
+        ns = sim_now();
+    }
+    for (int i = 0; i < RPI_PWM_CHANNELS; i++) {
+        ws2811_channel_t *channel = &ws2811->channel[i];
+        int64_t bits = (channel->strip_type & SK6812_SHIFT_WMASK) ? 32 : 24;
+        int64_t time = ((int64_t) channel->count * bits * 1000000000LL) / ws2811->freq;
+        for (int j = 0; j < channel->count; j++) {
+            hash = (hash ^ channel->leds[j]) * 1099511628211ULL;
+        }
+        count += channel->count;
+        if (time > wire) wire = time;
+    }
+    sim_record(ns, SIM_LED_FRAME, count, hash);
+    simLedBusy = ns + wire + SIM_LED_RESET;
+    return WS2811_SUCCESS;
+}
+
+static void sim_led_fini(ws2811_t *ws2811)
+{
+    simLedBusy = 0;
+    for (int i = 0; i < RPI_PWM_CHANNELS; i++) {
+        free(ws2811->channel[i].leds);
+        ws2811->channel[i].leds = NULL;
+    }
+}
+
+static const char *sim_led_error(ws2811_return_t state)
+{
+    return (state == WS2811_SUCCESS) ? "Success" : "simulated LED failure";
+}
+
+const backend_t backend_sim = {
+    .name = "simulated",
+    .spi_open = sim_spi_open,
+    .spi_transfer = sim_spi_transfer,
+    .spi_burst = sim_spi_burst,
+    .gpio_open = sim_gpio_open,
+    .gpio_function = sim_gpio_function,
+    .gpio_set = sim_gpio_set,
+    .gpio_clear = sim_gpio_clear,
+    .led_init = sim_led_init,
+    .led_render = sim_led_render,
+    .led_fini = sim_led_fini,
+    .led_error = sim_led_error,
+};
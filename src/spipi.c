@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
@@ -64,8 +65,8 @@ int spi_transfer(int fd, uint8_t *txbuf, uint8_t *rxbuf, uint32_t length)
 
     int rv;
     struct spi_ioc_transfer spi = {
-        .tx_buf = (uint32_t) txbuf,
-        .rx_buf = (uint32_t) rxbuf,
+        .tx_buf = (uintptr_t) txbuf,
+        .rx_buf = (uintptr_t) rxbuf,
         .len = length,
         .delay_usecs = SPI_DELAY,
         .speed_hz = spi_speed,
@@ -77,4 +78,39 @@ int spi_transfer(int fd, uint8_t *txbuf, uint8_t *rxbuf, uint32_t length)
         SPI_ERROR("Unable to do SPI transfer");
     }
     return rv;
+}
+
+/*
+ * @brief spi_burst(int fd, uint8_t *txbuf, uint32_t length, const uint16_t *show, uint32_t count)
+ * sends count words of length bytes from txbuf in one SPI_IOC_MESSAGE. Each transfer ends with
+ * cs_change, so the chip select (LE, see SPI_CS_PIN) rises as its word has shifted in and latches
+ * it. A transfer's delay comes before that edge, so it carries the time the word before shows,
+ * show[i - 1] microseconds, and a last transfer without a word holds the last one for its time.
+ * Returns once the last word has shown. LE has to be low before the call, the spi core skips
+ * lowering a chip select it left asserted.
+ * @return bytes sent, count is capped at SPI_BURST_MAX - 1
+ */
+int spi_burst(int fd, uint8_t *txbuf, uint32_t length, const uint16_t *show, uint32_t count)
+{
+    struct spi_ioc_transfer spi[SPI_BURST_MAX];
+    /* from one edge the next word shifts in SPI_CS_GAP_US later */
+    uint32_t shift = ((length * 8 * 1000000) / SPI_BURST_SPEED) + SPI_CS_GAP_US;
+    int rv;
+
+    if (count > SPI_BURST_MAX - 1) count = SPI_BURST_MAX - 1;
+    memset(spi, 0, (count + 1) * sizeof(struct spi_ioc_transfer));
+    for (uint32_t i = 0; i <= count; i++) {
+        if (i > 0) spi[i].delay_usecs = (show[i - 1] > shift) ? show[i - 1] - shift : 0;
+        if (i == count) break;
+        spi[i].tx_buf = (uintptr_t) &txbuf[i * length];
+        spi[i].len = length;
+        spi[i].speed_hz = SPI_BURST_SPEED;
+        spi[i].bits_per_word = spi_bpw;
+        spi[i].cs_change = 1;
+    }
+    rv = ioctl(fd, SPI_IOC_MESSAGE(count + 1), spi);
+    if (rv < 0) {
+        SPI_ERROR("Unable to do SPI burst");
+    }
+    return rv;
 }
\ No newline at end of file
@@ -0,0 +1,194 @@
+/*
+ * @file ticker.c
+ * @brief second boundary ticker for the nixie clock
+ * @details for raspberry pi 3B+
+ * The timerfd is armed for an absolute whole second with a one second interval, so the kernel
+ * wakes us on the boundary instead of sleeping short and spinning for the second to change.
+ * TFD_TIMER_CANCEL_ON_SET makes read() fail with ECANCELED whenever the realtime clock is set
+ * discontinuously, ticker_wait() then re-arms on the new time and reports TICKER_STEPPED.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+
+#include "ticker.h"
+
+/*
+ * @brief ticker_open(ticker_t *tk, long lead, int stopfd)
+ * creates the timer and arms it for the next second boundary
+ * @param[out] tk - ticker state
+ * @param[in] lead - nanoseconds before each boundary to wake up, 0 wakes on the boundary
+ * @param[in] stopfd - ticker_wait() returns TICKER_STOP once this fd is readable, -1 for none
+ * @return 0 on success, -1 on failure
+ */
+int ticker_open(ticker_t *tk, long lead, int stopfd)
+{
+    memset(tk, 0, sizeof(ticker_t));
+    tk->lead = lead;
+    tk->stopfd = stopfd;
+    tk->wakefd = -1;
+    tk->fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+    if (tk->fd < 0) {
+        fprintf(stderr, "unable to create clock timer: %s\n", strerror(errno));
+        return -1;
+    }
+    if (ticker_arm(tk) < 0) {
+        close(tk->fd);
+        tk->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief ticker_arm(ticker_t *tk)
+ * arms the timer lead nanoseconds ahead of the first whole second after now, repeating every second
+ * @param[in,out] tk - ticker state
+ * @return 0 on success, -1 on failure
+ */
+int ticker_arm(ticker_t *tk)
+{
+    struct timespec now;
+    struct itimerspec its;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    tk->second = now.tv_sec + 1;
+    its.it_value.tv_sec = tk->second;
+    its.it_value.tv_nsec = 0;
+    if (tk->lead > 0) {
+        its.it_value.tv_sec--;
+        its.it_value.tv_nsec = 1000000000L - tk->lead;
+    }
+    its.it_interval.tv_sec = 1;
+    its.it_interval.tv_nsec = 0;
+    if (timerfd_settime(tk->fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL) < 0) {
+        fprintf(stderr, "unable to arm clock timer: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief ticker_park(ticker_t *tk, time_t until)
+ * stops the second ticks, the timer fires once at until or never, ticker_arm() starts them again
+ * @param[in,out] tk - ticker state
+ * @param[in] until - UTC second to wake at, 0 to only wake on the stop and wake fds
+ * @return 0 on success, -1 on failure
+ */
+int ticker_park(ticker_t *tk, time_t until)
+{
+    struct itimerspec its = {0};
+
+    tk->second = until;
+    its.it_value.tv_sec = until;
+    if (timerfd_settime(tk->fd, (until > 0) ? TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET : 0, &its, NULL) < 0) {
+        fprintf(stderr, "unable to park clock timer: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief ticker_wait(ticker_t *tk, struct timespec *now)
+ * blocks until the next second boundary (less the lead), until the clock is stepped or until stopped
+ * @param[in,out] tk - ticker state, boundary/late/maxLate/missed/steps are updated
+ * @param[out] now - realtime clock read right after the wakeup
+ * @return TICKER_TICK on a boundary, TICKER_STEPPED if the clock was set and the timer re-armed,
+ * TICKER_STOP if the stop fd is readable, TICKER_WAKE if the wake fd woke it before the timer, -1 on failure
+ */
+int ticker_wait(ticker_t *tk, struct timespec *now)
+{
+    struct pollfd fds[3] = {{.fd = tk->fd, .events = POLLIN}, {.fd = tk->stopfd, .events = POLLIN},
+        {.fd = tk->wakefd, .events = POLLIN}};
+    uint64_t expirations;
+    int ready;
+
+    do {
+        ready = poll(fds, 3, -1);
+    } while ((ready < 0) && (errno == EINTR));
+    clock_gettime(CLOCK_REALTIME, now);
+    if (ready < 0) {
+        fprintf(stderr, "clock timer poll failed: %s\n", strerror(errno));
+        return -1;
+    }
+    if (fds[1].revents & POLLIN) return TICKER_STOP;
+    if ((fds[2].revents & POLLIN) && !(fds[0].revents & POLLIN)) {
+        if (read(tk->wakefd, &expirations, sizeof(expirations)) < 0) expirations = 0;
+        return TICKER_WAKE;
+    }
+    return ticker_read(tk, now);
+}
+
+/*
+ * @brief ticker_read(ticker_t *tk, struct timespec *now)
+ * takes the expiry of a timer that is readable, for a caller that polls tk->fd itself
+ * @param[in,out] tk - ticker state, boundary/late/maxLate/missed/steps are updated
+ * @param[in,out] now - realtime clock at the wakeup, the late time is worked out from it
+ * @return TICKER_TICK on a boundary, TICKER_STEPPED if the clock was set and the timer re-armed, -1 on failure
+ */
+int ticker_read(ticker_t *tk, struct timespec *now)
+{
+    uint64_t expirations;
+    ssize_t rv;
+
+    do {
+        rv = read(tk->fd, &expirations, sizeof(expirations));
+    } while ((rv < 0) && (errno == EINTR));
+    if (rv < 0) {
+        if (errno != ECANCELED) {
+            fprintf(stderr, "clock timer read failed: %s\n", strerror(errno));
+            return -1;
+        }
+        tk->steps++;
+        if (ticker_arm(tk) < 0) return -1;
+        return TICKER_STEPPED;
+    }
+    /* the timer repeats so several boundaries may have passed if we were held off */
+    tk->boundary = tk->second + (time_t) expirations - 1;
+    tk->second = tk->boundary + 1;
+    tk->missed += expirations - 1;
+    tk->ticks++;
+    tk->late = ((int64_t) (now->tv_sec - tk->boundary) * 1000000000LL) + now->tv_nsec + tk->lead;
+    if (tk->late > tk->maxLate) tk->maxLate = tk->late;
+    return TICKER_TICK;
+}
+
+void ticker_close(ticker_t *tk)
+{
+    if (tk->fd >= 0) close(tk->fd);
+    tk->fd = -1;
+}
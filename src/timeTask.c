@@ -54,44 +54,96 @@
 #include "nixieclock.h"
 #include "gpiopi.h"
 #include "spipi.h"
+#include "nixieframe.h"
+#include "ticker.h"
+#include "backend.h"
+#include "tzcache.h"
+#include "metrics.h"
+#include "trace.h"
+#include "realtime.h"
+#include "input.h"
+#include "idle.h"
+#include "tasks.h"
+#include "tubefx.h"
+
+/* set with each roll by the LED task, read by the clock every second */
+static atomic_int colon = COLON_ON;
+void setColon(colonEnum_t thisColon) {
+    atomic_store_explicit(&colon, thisColon, memory_order_relaxed);
+}
+
+bool nextColon(bool thisColon) 
+{
+    colonEnum_t mode = atomic_load_explicit(&colon, memory_order_relaxed);
+    if (mode == COLON_ON) return true;
+    if (mode == COLON_BLINK) return !thisColon;
+    return false;
+}
+
+struct clockstate {
+    int spifd;
+    void *gpiomap;
+    tzcache_t tz;
+    nixieframe_t display;
+    bool col;
+    time_t loaded;          /* second whose frame is waiting in the shift registers */
+    time_t dateUntil;       /* seconds before this show the date */
+    idlestate_t idle;
+    bool parked;            /* blanked and the ticker stopped while nobody is there */
+    int64_t latchError;     /* nanoseconds from the second boundary to LE going high */
+    int64_t maxLatchError;
+    uint64_t missed;        /* seconds the ticker had missed at the last tick */
+    time_t traced;          /* last second a missed second was dumped */
+};
+
+/* word in the shift registers, counted against its cathodes from when LE shows it */
+static uint64_t shifted;
 
 /*
- * @brief setNixie(int fd, void *map, bool colon, char *str)
- *
+ * @brief loadNixie(int fd, void *map, int pin, const nixieframe_t *frame)
+ * The HV drivers double buffer, with LE low the shift registers load while the outputs hold
+ * the last latched frame. The new frame shows when latchNixie() raises LE.
  * @param[in] fd - spi file descriptor
  * @param[in] map - gpio map base address
  * @param[in] pin - gpio pin number
- * @param[in] colon - true if colon is displayed, false they are off
- * @param[in] str - pointer to 6 character string or NULL if bytes are cleared
- * str must be six characters from '0' through '9'
+ * @param[in] frame - encoded digits and colon (see nixieframe.h) or NULL if all tubes are cleared
  */
 
-void setNixie(int fd, void *map, int pin, bool colon, char *str) {
+void loadNixie(int fd, void *map, int pin, const nixieframe_t *frame) {
     llconv_t nixie;
-    int i;
     uint8_t dummy[8];
-    nixie.ll = 0;
-    if (str != NULL) {
-        if (colon) nixie.ll |= 3;
-        for (i = 5; i >= 3; i--) {
-            nixie.ll <<= 10;
-            if ((str[i] >= '0') && (str[i] <= '9')) {
-                nixie.ll |= (1 << (str[i] - '0'));
-        	}
-        }
-        nixie.ll <<= 2;
-        if (colon) nixie.ll |= 3;
-        for (i = 2; i >= 0; i--) {
-            nixie.ll <<= 10;
-            if ((str[i] >= '0') && (str[i] <= '9')) {
-            	nixie.ll |= (1 << (str[i] - '0'));
-        	}
-        }
-        nixie.ll = bswap_64(nixie.ll);
-    }
-    gpio_clear_output(map, pin); /* set LE low */
-    spi_transfer(fd, nixie.b, dummy, sizeof(uint64_t));
-    gpio_set_output(map, pin); /* set LE high */
+    int64_t start, end;
+    nixie.ll = (frame != NULL) ? frame->word.ll : 0;
+    shifted = nixie.ll;
+    backend->gpio_clear(map, pin); /* set LE low */
+    start = metric_now();
+    trace_at(TRACE_SPI, 0, start);
+    backend->spi_transfer(fd, nixie.b, dummy, sizeof(uint64_t));
+    end = metric_now();
+    trace_at(TRACE_SPI_END, 0, end);
+    metric_record(&metrics.spi, end - start);
+}
+
+static inline void latchNixie(void *map, int pin) {
+    struct timespec now;
+    if (tubefx_driving()) return; /* LE belongs to the tube thread */
+    backend->gpio_set(map, pin); /* set LE high */
+    clock_gettime(CLOCK_REALTIME, &now);
+    tubefx_account(shifted, ((int64_t) now.tv_sec * 1000000000LL) + now.tv_nsec);
+}
+
+/*
+ * @brief setNixie(int fd, void *map, int pin, const nixieframe_t *frame)
+ * loads and latches a frame immediately, with tube effects the tube thread fades to it
+ */
+
+void setNixie(int fd, void *map, int pin, const nixieframe_t *frame) {
+    if (tubefx_driving()) {
+        tubefx_load((frame != NULL) ? frame->word.ll : 0, 0);
+        return;
+    }
+    loadNixie(fd, map, pin, frame);
+    latchNixie(map, pin);
 }
 
 /*
@@ -104,19 +156,302 @@ void setNixie(int fd, void *map, int pin, bool colon, char *str) {
  */
 
 void testNixie(int fd, void *map, int pin) {
-    char display[7] = "000000";
+    nixieframe_t display;
     bool colon = false;
-    struct timespec delay = {.tv_sec = 0, .tv_nsec = 500000000L };
+    nixie_frame_init(&display);
     for (int i = 0; i < 10; i++) {
-        setNixie(fd, map, pin, colon, display);
-        nanosleep(&delay, NULL);
-        for (int i = 0; i < 6; i++) {
-            display[i]++;
-            if (display[i] > '9') display[i] = '0';
-        }
+        for (int j = 0; j < NIXIE_TUBES; j++) nixie_frame_set_digit(&display, j, i);
+        nixie_frame_set_colon(&display, colon);
+        setNixie(fd, map, pin, &display);
+        if (terminateWait(500)) break;
         colon = !colon;
     }
 }
+/*
+ * @brief encodeSecond(clockstate_t *cs, time_t second) encodes what the tubes show for UTC second
+ */
+static void encodeSecond(clockstate_t *cs, time_t second)
+{
+    int hours, minutes, seconds;
+    struct tm date;
+
+    if (second < cs->dateUntil) {
+        localtime_r(&second, &date);
+        nixie_frame_set_hms(&cs->display, date.tm_mon + 1, date.tm_mday, date.tm_year % 100, false);
+        return;
+    }
+    /* convert to local time from the cached UTC offset, only changed tubes are re-encoded */
+    tzcache_hms(&cs->tz, second, &hours, &minutes, &seconds);
+    nixie_frame_set_hms(&cs->display, hours, minutes, seconds, cs->col);
+}
+
+/*
+ * @brief shiftSecond(clockstate_t *cs, time_t second) shifts the encoded frame out ahead of the
+ * boundary of second, or hands it to the tube thread to fade to on that boundary
+ */
+static void shiftSecond(clockstate_t *cs, time_t second)
+{
+    if (tubefx_driving()) tubefx_load(cs->display.word.ll, second);
+    else loadNixie(cs->spifd, cs->gpiomap, LE, &cs->display);
+    cs->loaded = second;
+}
+
+/*
+ * @brief preloadSecond(clockstate_t *cs, time_t second)
+ * encodes the local time of UTC second and shifts it out ahead of its boundary
+ */
+static void preloadSecond(clockstate_t *cs, time_t second)
+{
+    cs->col = nextColon(cs->col);
+    encodeSecond(cs, second);
+    shiftSecond(cs, second);
+}
+
+/*
+ * @brief showSecond(clockstate_t *cs, time_t second) shows UTC second straight away. The colon is
+ * left as it is, the preload of the second after it moves it on once as every second does.
+ */
+static void showSecond(clockstate_t *cs, time_t second)
+{
+    encodeSecond(cs, second);
+    shiftSecond(cs, second);
+    latchNixie(cs->gpiomap, LE);
+}
+
+/*
+ * @brief displayInput(clockstate_t *cs, time_t next) takes the input queued for the display.
+ * MODE shows the date straight away for NIXIE_DATE_SECONDS, then the frame of the next second
+ * is shifted out again, showing the date overwrote it. While the tube thread is refreshing the
+ * cathodes the date waits for the next flip instead. The events also tell idle who is there.
+ */
+static void displayInput(clockstate_t *cs, time_t next)
+{
+    inputevent_t event;
+    bool date = false;
+
+    while (input_take(INPUT_DISPLAY, &event)) {
+        idle_input(&cs->idle, &event, next - 1);
+        if ((event.line == INPUT_MODE) && (event.type == INPUT_PRESS)) date = true;
+    }
+    if (!date) return;
+    cs->dateUntil = next - 1 + NIXIE_DATE_SECONDS;
+    if (!tubefx_driving() && tubefx_refreshing(next - 1)) {
+        /* the refresh has the shift registers until the boundary, latchSecond() shifts this out then */
+        encodeSecond(cs, next);
+        return;
+    }
+    encodeSecond(cs, next - 1);
+    setNixie(cs->spifd, cs->gpiomap, LE, &cs->display);
+    encodeSecond(cs, next);
+    shiftSecond(cs, next);
+}
+
+/*
+ * @brief latchSecond(clockstate_t *cs, time_t boundary)
+ * The ticker wakes NIXIE_LATCH_LEAD ahead of the boundary, wait out the rest of the second so
+ * the only thing between the boundary and the visible flip is the LE write.
+ */
+static void latchSecond(clockstate_t *cs, time_t boundary)
+{
+    struct timespec now;
+    int64_t remaining;
+
+    if (cs->loaded != boundary) {
+        preloadSecond(cs, boundary); /* held off past a whole second */
+    } else if (!tubefx_driving() && tubefx_refreshing(boundary - 1)) {
+        shiftSecond(cs, boundary); /* the refresh words have been through the shift registers since */
+    }
+    if (tubefx_driving()) return; /* the tube thread flips on the boundary itself */
+    do {
+        clock_gettime(CLOCK_REALTIME, &now);
+        remaining = ((int64_t) (boundary - now.tv_sec) * 1000000000LL) - now.tv_nsec;
+    } while ((remaining > 0) && (remaining <= 2 * NIXIE_LATCH_LEAD)); /* way ahead means the clock stepped */
+    trace_event(TRACE_BOUNDARY, 0);
+    latchNixie(cs->gpiomap, LE);
+    clock_gettime(CLOCK_REALTIME, &now);
+    cs->latchError = ((int64_t) (now.tv_sec - boundary) * 1000000000LL) + now.tv_nsec;
+    if (cs->latchError > cs->maxLatchError) cs->maxLatchError = cs->latchError;
+    trace_event(TRACE_LATCH, trace_ns(cs->latchError));
+    metric_record(&metrics.flip, cs->latchError);
+}
+
+/*
+ * @brief localMinute(clockstate_t *cs, time_t second, int *seconds) local minute of the day of
+ * UTC second, with the second of that minute, for idle and the cathode refresh
+ */
+static int localMinute(clockstate_t *cs, time_t second, int *seconds)
+{
+    int hours, minutes;
+
+    tzcache_hms(&cs->tz, second, &hours, &minutes, seconds);
+    return (hours * 60) + minutes;
+}
+
+/*
+ * @brief parkClock(clockstate_t *cs, ticker_t *ticker, time_t now) blanks the tubes and stops the
+ * ticker until someone is there or the idle window ends
+ * @return 0, -1 if the timer failed
+ */
+static int parkClock(clockstate_t *cs, ticker_t *ticker, time_t now)
+{
+    int seconds;
+    int minute = localMinute(cs, now, &seconds);
+
+    if (!cs->parked) {
+        setNixie(cs->spifd, cs->gpiomap, LE, NULL);
+        cs->idle.parks++;
+        cs->parked = true;
+        idle_park(true);
+    }
+    return ticker_park(ticker, idle_until(now, minute, seconds));
+}
+
+/*
+ * @brief parkedWake(clockstate_t *cs, ticker_t *ticker, int rv, const struct timespec *now) looks
+ * again at who is there, parks again or shows the time straight away
+ * @return 0, -1 if the timer failed
+ */
+static int parkedWake(clockstate_t *cs, ticker_t *ticker, int rv, const struct timespec *now)
+{
+    inputevent_t event;
+    int seconds;
+
+    if (rv == TICKER_STEPPED) tzcache_invalidate(&cs->tz);
+    while (input_take(INPUT_DISPLAY, &event)) idle_input(&cs->idle, &event, now->tv_sec);
+    if (idle_due(&cs->idle, now->tv_sec, localMinute(cs, now->tv_sec, &seconds))) return parkClock(cs, ticker, now->tv_sec);
+    cs->parked = false;
+    idle_park(false);
+    if (ticker_arm(ticker) < 0) return -1;
+    /* the second under way now, then the next one as usual */
+    showSecond(cs, now->tv_sec);
+    preloadSecond(cs, ticker->second);
+#ifdef DEBUG
+    fprintf(stdout, "clock woke from idle at %ld\n", (long) now->tv_sec);
+#endif
+    return 0;
+}
+
+/*
+ * @brief clocktask_open(ticker_t *ticker) sets up the tubes, runs the tube test and arms the ticker
+ * with the first second shifted out
+ * @return the clock, NULL if it could not start and termination was asked for
+ */
+clockstate_t *clocktask_open(ticker_t *ticker)
+{
+    clockstate_t *cs = calloc(1, sizeof(clockstate_t));
+
+    ticker->fd = -1;
+    if (cs == NULL) {
+        notifyToTerminate();
+        return NULL;
+    }
+    cs->spifd = backend->spi_open();
+    cs->gpiomap = backend->gpio_open();
+    if (cs->gpiomap == NULL) {
+        fprintf(stderr,"Failed to open GPIO\n");
+        free(cs);
+        notifyToTerminate();
+        return NULL;
+    }
+    backend->gpio_function(cs->gpiomap, LE, FSEL_OUTPUT);
+    setNixie(cs->spifd, cs->gpiomap, LE, NULL); // clear nixie to initialize
+    nixie_frame_init(&cs->display);
+    tzcache_invalidate(&cs->tz);
+
+    if (nixieTest) testNixie(cs->spifd, cs->gpiomap, LE); // simple sequence of all nixies to test
+    if (ticker_open(ticker, NIXIE_LATCH_LEAD, terminate.fd) < 0) {
+        setNixie(cs->spifd, cs->gpiomap, LE, NULL);
+        free(cs);
+        notifyToTerminate();
+        return NULL;
+    }
+    ticker->wakefd = input_fd(INPUT_DISPLAY);
+    cs->idle.seen = ticker->second;     /* awake to begin with */
+    preloadSecond(cs, ticker->second);
+    return cs;
+}
+
+/*
+ * @brief clocktask_wake(clockstate_t *cs, ticker_t *ticker, int rv, struct timespec *now)
+ * takes one wakeup of the ticker, flips the tubes on a tick and shifts out the second after it
+ * @param[in] rv - what ticker_wait() or ticker_read() returned, TICKER_WAKE for display input
+ * @param[in] now - realtime clock at the wakeup
+ * @return 0 to carry on, -1 to stop
+ */
+int clocktask_wake(clockstate_t *cs, ticker_t *ticker, int rv, struct timespec *now)
+{
+    bool traceMissed;
+    int seconds;
+
+    if (rv < 0) {
+        notifyToTerminate();
+        return -1;
+    }
+    if (rv == TICKER_STOP) return -1;
+    if (cs->parked) {
+        if (parkedWake(cs, ticker, rv, now) == 0) return 0;
+        notifyToTerminate();
+        return -1;
+    }
+    if (rv == TICKER_WAKE) {
+        displayInput(cs, ticker->second);
+        return 0;
+    }
+    metric_set(&metrics.secondsMissed, ticker->missed);
+    metric_set(&metrics.clockSteps, ticker->steps);
+    traceMissed = (ticker->missed > cs->missed);
+    if (traceMissed) trace_event(TRACE_MISSED, (uint32_t) (ticker->missed - cs->missed));
+    cs->missed = ticker->missed;
+    if (rv == TICKER_STEPPED) {
+        trace_event(TRACE_STEPPED, 0);
+        /* what is preloaded is for the old time, show the new time now */
+        tzcache_invalidate(&cs->tz);
+        showSecond(cs, now->tv_sec);
+    } else {
+        latchSecond(cs, ticker->boundary);
+    }
+#ifdef DEBUG
+    if (rv == TICKER_STEPPED) {
+        fprintf(stdout, "clock stepped, timer re-armed\n");
+    } else {
+        fprintf(stdout, "tick %ld wake late %ld ns (max %ld ns, missed %lu) latch %ld ns (max %ld ns)\n",
+            (long) ticker->boundary, (long) ticker->late, (long) ticker->maxLate, (unsigned long) ticker->missed,
+            (long) cs->latchError, (long) cs->maxLatchError);
+    }
+#endif
+    /* shift out the next second now so the boundary only has to raise LE */
+    preloadSecond(cs, ticker->second);
+    /* the events that led up to the missed second are still in the rings, keep them */
+    if (traceMissed && (ticker->boundary - cs->traced >= TRACE_DUMP_HOLD)) {
+        cs->traced = ticker->boundary;
+        if (trace_dump(tracePath) == 0) syslog(LOG_WARNING, "missed second traced to %s", tracePath);
+    }
+    if (idle_enabled() && idle_due(&cs->idle, ticker->second - 1, localMinute(cs, ticker->second - 1, &seconds))
+        && (parkClock(cs, ticker, ticker->second - 1) < 0)) {
+        notifyToTerminate();
+        return -1;
+    }
+    /* the tube thread lights every cathode in turn between the flips until it is over */
+    if (tubefx_enabled() && !cs->parked && tubefx_refresh_due(localMinute(cs, ticker->second - 1, &seconds), seconds)) {
+        tubefx_refresh(ticker->second - 1 + tubeconfig.refreshSeconds);
+    }
+    return 0;
+}
+
+/*
+ * @brief clocktask_close(clockstate_t *cs, ticker_t *ticker) stops the ticker and blanks the tubes
+ */
+void clocktask_close(clockstate_t *cs, ticker_t *ticker)
+{
+    ticker_close(ticker);
+    if (cs == NULL) return;
+#ifdef DEBUG
+    if (idle_enabled()) fprintf(stdout, "clock went idle %u times\n", cs->idle.parks);
+#endif
+    setNixie(cs->spifd, cs->gpiomap, LE, NULL); // clear nixie to clean up
+    free(cs);
+}
+
 /*
  * @brief timeTask updates Nixie clock time
  *
@@ -124,51 +459,22 @@ void testNixie(int fd, void *map, int pin) {
  */
 void *timeTask(void *threadid)
 {
+    struct timespec currentTime;
+    clockstate_t *cs;
+    ticker_t ticker;
     int rv;
-    bool done = false;
-    int spifd;
-    void *gpiomap;
-    struct tm *loctime;
-    time_t UTCtime;
-    struct timespec currentTime, lastTime, remTime;
-    uint8_t timestr[7];
-    bool col = false;
-
-    spifd = spi_open();
-    gpiomap = gpio_open();
-    if (gpiomap == NULL) {
-        fprintf(stderr,"Failed to open GPIO\n");
-        notifyToTerminate();
-        pthread_exit((void *)EXIT_FAILURE);
-    }
-    gpio_set_function_select(gpiomap, LE, FSEL_OUTPUT);
-    setNixie(spifd, gpiomap, LE, false, NULL); // clear nixie to initialize
-
-    testNixie(spifd, gpiomap, LE); // simple sequence of all nixies to test
-    clock_gettime(CLOCK_REALTIME, &lastTime);
-    while (!done) {
-        /* Wait for seconds to change */
-        do {
-            clock_gettime(CLOCK_REALTIME, &currentTime);
-        } while (currentTime.tv_sec == lastTime.tv_sec);
-        lastTime = currentTime;
-        /* convert to local time and a string to send to nixie */
-        loctime = localtime(&currentTime.tv_sec);
-        strftime(timestr, sizeof(timestr), "%H%M%S", loctime);
-        col = nextColon(col);
-        setNixie(spifd, gpiomap, LE, col, timestr);
-        /* we are done get time stamp and wait close to end of the second */
-        clock_gettime(CLOCK_REALTIME, &currentTime);        
-        remTime.tv_sec = currentTime.tv_sec;
-        remTime.tv_nsec = (currentTime.tv_nsec > CONSIDERATE_SLEEP) ? 0L : CONSIDERATE_SLEEP - currentTime.tv_nsec; 
-        do {
-            currentTime = remTime;
-            rv = clock_nanosleep(CLOCK_REALTIME,TIMER_ABSTIME, &currentTime, &remTime);
-            /* This assertion is if rv returns an error for a bad value in currentTime */
-            /* This shouldn't happen except for programming bug */
-            assert((rv == 0) || (rv == EINTR));
-        } while (rv == EINTR);    
-        done = isTerminate();
-    } 
-    setNixie(spifd, gpiomap, LE, false, NULL); // clear nixie to clean up
-}
\ No newline at end of file
+
+    trace_thread("clock");
+    realtime_thread(RT_CLOCK);
+    cs = clocktask_open(&ticker);
+    if (cs == NULL) pthread_exit((void *)EXIT_FAILURE);
+    while (!isTerminate()) {
+        /* block until just ahead of the next second, until the clock is stepped or until terminated */
+        trace_event(TRACE_SLEEP, 0);
+        rv = ticker_wait(&ticker, &currentTime);
+        trace_event(TRACE_WAKE, trace_ns(ticker.late));
+        if (clocktask_wake(cs, &ticker, rv, &currentTime) < 0) break;
+    }
+    clocktask_close(cs, &ticker);
+    return NULL;
+}
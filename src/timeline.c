@@ -0,0 +1,121 @@
+/*
+ * @file timeline.c
+ * @brief expands the LED roll into a precomputed frame timeline
+ * @details for raspberry pi 3B+
+ * A fast record is one frame held for its delay. A slow record is its steps (delay * fps) frames
+ * fading to the next record, exactly the colors ledTask would interpolate on the fly. Frames are
+ * padded to a cache line and the whole pass is one allocation, so the render loop only copies.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "nixieclock.h"
+#include "timeline.h"
+#include "interpolate.h"
+
+static uint64_t framecount(const ledrollhead_t *ledrollhead)
+{
+    uint64_t count = 0;
+    for (int i = 0; i < ledrollhead->count; i++) {
+        const ledroll_t *p = &ledrollhead->roll[i];
+        count += p->steps;
+    }
+    return count;
+}
+
+/*
+ * @brief timeline_size(const ledrollhead_t *ledrollhead)
+ * @return bytes needed to compile the roll, SIZE_MAX if it cannot be represented
+ */
+size_t timeline_size(const ledrollhead_t *ledrollhead)
+{
+    uint64_t count = framecount(ledrollhead);
+    uint64_t bytes = count * (((uint64_t) ledrollhead->geometry.stride * sizeof(uint32_t)) + sizeof(int64_t));
+    if ((count > UINT32_MAX) || (bytes > SIZE_MAX)) return SIZE_MAX;
+    return (size_t) bytes + sizeof(ledtimeline_t);
+}
+
+/*
+ * @brief timeline_compile(const ledrollhead_t *ledrollhead, size_t limit)
+ * @details expands one pass of the roll if it fits in limit bytes
+ * @return timeline or NULL if the roll is too large or memory could not be allocated
+ */
+ledtimeline_t *timeline_compile(const ledrollhead_t *ledrollhead, size_t limit)
+{
+    ledtimeline_t *tl;
+    size_t size = timeline_size(ledrollhead);
+    uint32_t index = 0;
+    int64_t start = 0;
+
+    if ((size == SIZE_MAX) || (size > limit)) return NULL;
+    tl = (ledtimeline_t *) malloc(sizeof(ledtimeline_t));
+    if (tl == NULL) return NULL;
+    tl->count = (uint32_t) framecount(ledrollhead);
+    tl->leds = ledrollhead->geometry.count;
+    tl->stride = ledrollhead->geometry.stride;
+    tl->offset = (int64_t *) malloc(tl->count * sizeof(int64_t));
+    tl->frame = (uint32_t *) aligned_alloc(LEDFRAME_ALIGN, (size_t) tl->count * tl->stride * sizeof(uint32_t));
+    if ((tl->offset == NULL) || (tl->frame == NULL)) {
+        timeline_free(tl);
+        return NULL;
+    }
+    for (int i = 0; i < ledrollhead->count; i++) {
+        const ledroll_t *p = &ledrollhead->roll[i];
+        const uint32_t *color = ledroll_color(ledrollhead, i);
+        const uint32_t *nextcolor = ledroll_color(ledrollhead, (i + 1 < ledrollhead->count) ? i + 1 : 0);
+        if (p->isFast) {
+            uint32_t *frame = &tl->frame[(size_t) index * tl->stride];
+            memcpy(frame, color, tl->stride * sizeof(uint32_t));
+            tl->offset[index++] = start;
+        } else {
+            for (uint32_t j = 0; j < p->steps; j++) {
+                uint32_t *frame = &tl->frame[(size_t) index * tl->stride];
+                memset(&frame[tl->leds], 0, (tl->stride - tl->leds) * sizeof(uint32_t));
+                interpolate_frame(frame, color, nextcolor, tl->leds, j, p->steps);
+                tl->offset[index++] = start + ledroll_offset(p, j);
+            }
+        }
+        start += ledroll_offset(p, p->steps);
+    }
+    tl->period = start;
+    return tl;
+}
+
+void timeline_free(ledtimeline_t *tl)
+{
+    if (tl == NULL) return;
+    free(tl->offset);
+    free(tl->frame);
+    free(tl);
+}
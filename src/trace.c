@@ -0,0 +1,111 @@
+/*
+ * @file trace.c
+ * @brief per thread event rings and the signal safe dump of them
+ * @details for raspberry pi 3B+
+ * The rings are static, claiming one is an atomic increment at thread start. A dump reads the rings
+ * while their threads keep writing, the oldest few events of a busy ring can be overwritten as they
+ * are written out, trace2chrome.py drops anything older than head - TRACE_EVENTS.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+const char *tracePath = TRACE_PATH;
+_Thread_local tracering_t *traceRing = NULL;
+
+static tracering_t rings[TRACE_RINGS];
+static atomic_uint claimed = 0;
+
+/*
+ * @brief trace_thread(const char *name) gives the calling thread a ring, threads past TRACE_RINGS
+ * are not traced
+ */
+void trace_thread(const char *name)
+{
+    unsigned index = atomic_fetch_add(&claimed, 1);
+
+    if (index >= TRACE_RINGS) return;
+    strncpy(rings[index].name, name, TRACE_NAME - 1);
+    traceRing = &rings[index];
+}
+
+static int writeAll(int fd, const void *data, size_t length)
+{
+    const uint8_t *p = data;
+    ssize_t n;
+
+    while (length > 0) {
+        n = write(fd, p, length);
+        if (n <= 0) return -1;
+        p += n;
+        length -= n;
+    }
+    return 0;
+}
+
+/*
+ * @brief trace_dump(const char *path) writes every ring to path, async signal safe
+ * @return 0 or -1 if the file could not be written
+ */
+int trace_dump(const char *path)
+{
+    traceheader_t header = {.magic = TRACE_MAGIC, .version = TRACE_VERSION, .events = TRACE_EVENTS};
+    struct timespec realtime, monotonic;
+    unsigned count = atomic_load(&claimed);
+    int rv = 0;
+    int fd;
+
+    if (count > TRACE_RINGS) count = TRACE_RINGS;
+    header.rings = count;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    clock_gettime(CLOCK_MONOTONIC, &monotonic);
+    header.realtime = ((int64_t) (realtime.tv_sec - monotonic.tv_sec) * 1000000000LL) + (realtime.tv_nsec - monotonic.tv_nsec);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    if (writeAll(fd, &header, sizeof(header)) < 0) rv = -1;
+    for (unsigned i = 0; (i < count) && (rv == 0); i++) {
+        uint64_t head = atomic_load_explicit(&rings[i].head, memory_order_acquire);
+        if ((writeAll(fd, rings[i].name, TRACE_NAME) < 0) || (writeAll(fd, &head, sizeof(head)) < 0) ||
+            (writeAll(fd, rings[i].event, sizeof(rings[i].event)) < 0)) rv = -1;
+    }
+    if (close(fd) < 0) rv = -1;
+    return rv;
+}
+
+/* SIGUSR1 */
+void trace_signal(int signum)
+{
+    trace_dump(tracePath);
+}
@@ -0,0 +1,568 @@
+/*
+ * @file tubefx.c
+ * @brief tube thread, crossfades and dims the nixie tubes with bursts of driver words
+ * @details for raspberry pi 3B+
+ * The HV drivers only switch a cathode fully on or off, so a tube part way between two digits or
+ * at part brightness is made by switching words faster than the eye follows. Done a word at a
+ * time that is an ioctl and two GPIO writes every 50 usec. Here a period is a handful of words and
+ * a burst of periods goes to the kernel at once, with the transfer delays spacing the words and
+ * the chip select, wired to LE, latching each one as it ends.
+ * The cathode refresh is a burst too, its ten words are worked out once as the thread starts.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+
+#include "nixieclock.h"
+#include "gpiopi.h"
+#include "spipi.h"
+#include "backend.h"
+#include "metrics.h"
+#include "trace.h"
+#include "realtime.h"
+#include "tubefx.h"
+
+#define NS_PER_SEC 1000000000LL
+/* time one driver word takes to shift out at SPI_BURST_SPEED */
+#define SHIFT_NS (((int64_t) sizeof(uint64_t) * 8 * NS_PER_SEC) / SPI_BURST_SPEED)
+#define PERIOD_NS ((int64_t) TUBEFX_PERIOD_US * 1000)
+/* the bursts stop this far ahead of a flip, the first word of the fade shifts in at SPI_SPEED */
+#define FLIP_LEAD (2 * NIXIE_LATCH_LEAD)
+
+typedef struct {
+    uint64_t word;
+    time_t second;              /* UTC second the word shows from, 0 straight away */
+} tubeload_t;
+
+typedef struct {
+    _Alignas(64) atomic_uint head;      /* written by the clock */
+    _Alignas(64) atomic_uint tail;      /* written by the tube thread */
+    tubeload_t load[TUBEFX_QUEUE];
+} tubequeue_t;
+
+typedef struct {
+    int spifd;
+    void *gpiomap;
+    uint64_t from;              /* word the fade under way leaves */
+    uint64_t to;                /* word it goes to, the word shown once it is over */
+    uint64_t shown;             /* word last shifted out while steady */
+    uint32_t period;            /* periods of the fade done */
+    bool fading;
+    tubeload_t pending[TUBEFX_PENDING];     /* seconds still to come, earliest first */
+    int npending;
+    uint64_t sequence[NIXIE_DIGITS];        /* refresh words, every cathode lit in one of them */
+    uint32_t step;                          /* next refresh word */
+    uint8_t tx[TUBEFX_BURST * sizeof(uint64_t)];
+    uint16_t show[TUBEFX_BURST];    /* microseconds each word shows */
+} tubes_t;
+
+tubeconfig_t tubeconfig = TUBEFX_OFF;
+tubefxstats_t tubefxstats;
+static tubequeue_t queue;
+static int wakefd = -1;
+/* UTC second the cathode refresh under way ends */
+static atomic_int_fast64_t refreshUntil;
+
+static inline int64_t realnow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return ((int64_t) now.tv_sec * NS_PER_SEC) + now.tv_nsec;
+}
+
+/*
+ * @brief tubefx_open() creates the eventfd the tube thread waits on for the clock's frames
+ * @return 0 on success, -1 on failure
+ */
+int tubefx_open(void)
+{
+    atomic_store(&queue.head, 0);
+    atomic_store(&queue.tail, 0);
+    wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakefd < 0) {
+        fprintf(stderr, "unable to create tube effects eventfd: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * @brief wake() wakes the tube thread for a frame handed over or a refresh asked for
+ */
+static void wake(void)
+{
+    uint64_t one = 1;
+
+    if ((wakefd >= 0) && (write(wakefd, &one, sizeof(one)) < 0)) {
+        fprintf(stderr, "tube effects wake failed: %s\n", strerror(errno));
+    }
+}
+
+/*
+ * @brief tubefx_enabled() does the tube thread run, for the effects or the cathode refresh
+ */
+bool tubefx_enabled(void)
+{
+    return tubefx_driving() || (tubeconfig.refreshSeconds > 0);
+}
+
+/*
+ * @brief tubefx_driving() do the tubes belong to the tube thread, for the fades and dimming.
+ * Otherwise the clock loads and latches them and the tube thread only has the refresh gaps.
+ */
+bool tubefx_driving(void)
+{
+    return (tubeconfig.fade > 0) || (tubeconfig.brightness < 100);
+}
+
+/*
+ * @brief tubefx_refreshing(time_t second) does the tube thread refresh the cathodes after the flip
+ * of UTC second
+ */
+bool tubefx_refreshing(time_t second)
+{
+    return second < atomic_load_explicit(&refreshUntil, memory_order_relaxed);
+}
+
+/*
+ * @brief tubefx_refresh_due(int minute, int seconds) should a refresh start on this local second
+ * @param[in] minute, seconds - local minute of the day and second of the minute
+ */
+bool tubefx_refresh_due(int minute, int seconds)
+{
+    if ((seconds != 0) || (tubeconfig.refreshSeconds == 0)) return false;
+    if ((tubeconfig.refreshEvery > 0) && ((minute % tubeconfig.refreshEvery) == 0)) return true;
+    return minute == tubeconfig.refreshAt;
+}
+
+/*
+ * @brief tubefx_refresh(time_t until) has the tube thread refresh the cathodes between the flips
+ * of every second before UTC second until
+ */
+void tubefx_refresh(time_t until)
+{
+    atomic_store(&refreshUntil, until);
+    atomic_fetch_add_explicit(&tubefxstats.refreshes, 1, memory_order_relaxed);
+    wake();
+}
+
+/*
+ * @brief tubefx_account(uint64_t word, int64_t ns) notes word went on the tubes at CLOCK_REALTIME
+ * ns and adds the time since the word before to each cathode that word lit. Only from the thread
+ * switching the tubes at the time, during a refresh the clock and the tube thread take turns.
+ */
+void tubefx_account(uint64_t word, int64_t ns)
+{
+    static atomic_uint_fast64_t last;
+    static atomic_int_fast64_t from;
+    uint64_t lit = atomic_load_explicit(&last, memory_order_relaxed);
+    int64_t since = atomic_load_explicit(&from, memory_order_relaxed);
+
+    if ((lit != 0) && (ns > since)) {
+        for (int s = 0; s < NIXIE_TUBES; s++) {
+            if ((lit & nixielut.slot[s]) == 0) continue;
+            for (int d = 0; d < NIXIE_DIGITS; d++) {
+                if (lit & nixielut.digit[s][d]) {
+                    atomic_fetch_add_explicit(&tubefxstats.cathode[s][d], ns - since, memory_order_relaxed);
+                }
+            }
+        }
+    }
+    atomic_store_explicit(&last, word, memory_order_relaxed);
+    atomic_store_explicit(&from, ns, memory_order_relaxed);
+}
+
+/*
+ * @brief tubefx_load(uint64_t word, time_t second) hands the tube thread a frame, only from the
+ * clock thread
+ * @param[in] word - driver word in shift out byte order
+ * @param[in] second - UTC second the frame shows from, 0 or a second already begun for straight away
+ */
+void tubefx_load(uint64_t word, time_t second)
+{
+    unsigned head = atomic_load_explicit(&queue.head, memory_order_relaxed);
+
+    if (head - atomic_load_explicit(&queue.tail, memory_order_acquire) >= TUBEFX_QUEUE) {
+        atomic_fetch_add_explicit(&tubefxstats.dropped, 1, memory_order_relaxed);
+        return;
+    }
+    queue.load[head & (TUBEFX_QUEUE - 1)] = (tubeload_t) {.word = word, .second = second};
+    atomic_store_explicit(&queue.head, head + 1, memory_order_release);
+    wake();
+}
+
+/*
+ * @brief tubefx_period(uint64_t from, uint64_t to, uint32_t mix, uint32_t on, tubeword_t *out)
+ * renders one PWM period, to for the first mix of the on steps, from for the rest of them and
+ * blank after. Cathodes lit in both words stay lit all on steps. Runs of one word are merged.
+ * @return words written to out, at most three
+ */
+uint32_t tubefx_period(uint64_t from, uint64_t to, uint32_t mix, uint32_t on, tubeword_t *out)
+{
+    tubeword_t segment[3];
+    uint32_t count = 0;
+
+    if (on > TUBEFX_STEPS) on = TUBEFX_STEPS;
+    if (mix > on) mix = on;
+    segment[0] = (tubeword_t) {.word = to, .steps = mix};
+    segment[1] = (tubeword_t) {.word = from, .steps = on - mix};
+    segment[2] = (tubeword_t) {.word = 0, .steps = TUBEFX_STEPS - on};
+    for (int i = 0; i < 3; i++) {
+        if (segment[i].steps == 0) continue;
+        if ((count > 0) && (out[count - 1].word == segment[i].word)) {
+            out[count - 1].steps += segment[i].steps;
+        } else {
+            out[count++] = segment[i];
+        }
+    }
+    return count;
+}
+
+static uint32_t onSteps(void)
+{
+    uint32_t on = ((tubeconfig.brightness * TUBEFX_STEPS) + 50) / 100;
+    return (on < 1) ? 1 : on;
+}
+
+/*
+ * @brief mixSteps(const tubes_t *t) steps of the current period the fade shows its new word for
+ */
+static uint32_t mixSteps(const tubes_t *t)
+{
+    uint32_t periods = (tubeconfig.fade * 1000) / TUBEFX_PERIOD_US;
+
+    if (!t->fading || (periods == 0)) return TUBEFX_STEPS;
+    return ((t->period + 1) * TUBEFX_STEPS) / periods;
+}
+
+/*
+ * @brief start(tubes_t *t, uint64_t word) fades from whichever word shows most to word
+ */
+static void start(tubes_t *t, uint64_t word)
+{
+    t->from = (mixSteps(t) * 2 < TUBEFX_STEPS) ? t->from : t->to;
+    t->to = word;
+    t->period = 0;
+    t->fading = (tubeconfig.fade > 0) && (t->from != t->to);
+}
+
+/*
+ * @brief take(tubes_t *t, int64_t now) takes the frames the clock handed over. A frame for now
+ * starts straight away and forgets the seconds still to come, the clock loads the next one again
+ * after it. A frame for a second to come replaces any held for it or after it.
+ */
+static void take(tubes_t *t, int64_t now)
+{
+    unsigned tail = atomic_load_explicit(&queue.tail, memory_order_relaxed);
+    tubeload_t load;
+
+    while (tail != atomic_load_explicit(&queue.head, memory_order_acquire)) {
+        load = queue.load[tail & (TUBEFX_QUEUE - 1)];
+        atomic_store_explicit(&queue.tail, ++tail, memory_order_release);
+        if ((int64_t) load.second * NS_PER_SEC <= now) {
+            t->npending = 0;
+            start(t, load.word);
+            continue;
+        }
+        while ((t->npending > 0) && (t->pending[t->npending - 1].second >= load.second)) t->npending--;
+        if (t->npending < TUBEFX_PENDING) {
+            t->pending[t->npending++] = load;
+        } else {
+            atomic_fetch_add_explicit(&tubefxstats.dropped, 1, memory_order_relaxed);
+        }
+    }
+}
+
+/*
+ * @brief flip(tubes_t *t, int64_t boundary) starts the fade to the frame held for the second.
+ * Like the clock without the effects, the first word of the fade is shifted in with LE low ahead
+ * of the boundary and LE rising on the boundary is all that is left to show it.
+ */
+static void flip(tubes_t *t, int64_t boundary)
+{
+    tubeword_t period[3];
+    uint8_t dummy[sizeof(uint64_t)];
+    int64_t late;
+
+    start(t, t->pending[0].word);
+    memmove(&t->pending[0], &t->pending[1], (t->npending - 1) * sizeof(tubeload_t));
+    t->npending--;
+    tubefx_period(t->from, t->to, mixSteps(t), onSteps(), period);
+    backend->gpio_clear(t->gpiomap, LE);
+    backend->spi_transfer(t->spifd, (uint8_t *) &period[0].word, dummy, sizeof(uint64_t));
+    while (realnow() < boundary) continue;
+    trace_event(TRACE_BOUNDARY, 0);
+    backend->gpio_set(t->gpiomap, LE);
+    late = realnow() - boundary;
+    tubefx_account(period[0].word, boundary + late);
+    t->shown = period[0].word;
+    trace_event(TRACE_LATCH, trace_ns(late));
+    metric_record(&metrics.flip, late);
+    atomic_fetch_add_explicit(&tubefxstats.flips, 1, memory_order_relaxed);
+    if (late > atomic_load_explicit(&tubefxstats.maxLate, memory_order_relaxed)) {
+        atomic_store_explicit(&tubefxstats.maxLate, late, memory_order_relaxed);
+    }
+}
+
+/*
+ * @brief send(tubes_t *t, uint32_t count) sends the rendered words, each latched by LE as it ends
+ */
+static void send(tubes_t *t, uint32_t count)
+{
+    int64_t start = realnow();
+    int64_t at = start + SHIFT_NS;
+    uint64_t word;
+
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(&word, &t->tx[i * sizeof(uint64_t)], sizeof(uint64_t));
+        tubefx_account(word, at);
+        at += (int64_t) t->show[i] * 1000;
+    }
+    trace_at(TRACE_SPI, count, start);
+    /* LE may still be high from the flip, the burst only pulses it */
+    backend->gpio_clear(t->gpiomap, LE);
+    backend->spi_burst(t->spifd, t->tx, sizeof(uint64_t), t->show, count);
+    trace_event(TRACE_SPI_END, 0);
+    atomic_fetch_add_explicit(&tubefxstats.bursts, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&tubefxstats.words, count, memory_order_relaxed);
+}
+
+/*
+ * @brief shift(tubes_t *t, uint64_t word) shows one word and leaves it
+ */
+static void shift(tubes_t *t, uint64_t word)
+{
+    memcpy(t->tx, &word, sizeof(uint64_t));
+    t->show[0] = 0;
+    send(t, 1);
+    t->shown = word;
+}
+
+/*
+ * @brief render(tubes_t *t, int64_t budget) renders the periods that fit in budget nanoseconds
+ * and in a burst, the fade moves on a period at a time
+ * @return words rendered
+ */
+static uint32_t render(tubes_t *t, int64_t budget)
+{
+    uint32_t periods = (tubeconfig.fade * 1000) / TUBEFX_PERIOD_US;
+    uint32_t on = onSteps();
+    uint32_t count = 0;
+    tubeword_t period[3];
+    uint32_t words = 0;
+
+    for (int64_t used = PERIOD_NS; (used <= budget) && (count + 3 <= TUBEFX_BURST); used += PERIOD_NS) {
+        words = tubefx_period(t->from, t->to, mixSteps(t), on, period);
+        for (uint32_t i = 0; i < words; i++) {
+            memcpy(&t->tx[count * sizeof(uint64_t)], &period[i].word, sizeof(uint64_t));
+            t->show[count++] = period[i].steps * TUBEFX_STEP_US;
+        }
+        if (t->fading && (++t->period >= periods)) {
+            t->fading = false;
+            if (on == TUBEFX_STEPS) break;
+        }
+    }
+    t->shown = (count > 0) ? period[words - 1].word : t->shown;
+    return count;
+}
+
+/*
+ * @brief sequenceInit(tubes_t *t) works out the refresh words, each tube a digit on from the one
+ * to its left like the reels of a slot machine, so every word lights six different cathodes
+ */
+static void sequenceInit(tubes_t *t)
+{
+    uint8_t digit[NIXIE_TUBES];
+    nixieframe_t frame;
+
+    nixie_frame_init(&frame);
+    for (int i = 0; i < NIXIE_DIGITS; i++) {
+        for (int s = 0; s < NIXIE_TUBES; s++) digit[s] = (i + s) % NIXIE_DIGITS;
+        nixie_frame_set_digits(&frame, digit, (i & 1) != 0);
+        t->sequence[i] = frame.word.ll;
+    }
+}
+
+/*
+ * @brief refreshGap(const tubes_t *t, int64_t now) where the refresh goes in the second under way,
+ * after the flip has shown the time for TUBEFX_REFRESH_HOLD_MS or the fade is over
+ * @return CLOCK_REALTIME ns the next gap starts, now if it has, INT64_MAX with no refresh under way
+ */
+static int64_t refreshGap(const tubes_t *t, int64_t now)
+{
+    int64_t second = now / NS_PER_SEC;
+    uint32_t hold = (tubeconfig.fade > TUBEFX_REFRESH_HOLD_MS) ? tubeconfig.fade : TUBEFX_REFRESH_HOLD_MS;
+    int64_t until = atomic_load_explicit(&refreshUntil, memory_order_relaxed);
+    int64_t begin = (second * NS_PER_SEC) + ((int64_t) hold * 1000000LL);
+
+    if (t->fading || (second >= until)) return INT64_MAX;
+    if (now < begin) return begin;
+    if (now + (TUBEFX_REFRESH_STEP_MS * 1000000LL) <= ((second + 1) * NS_PER_SEC) - FLIP_LEAD) return now;
+    return (second + 1 < until) ? begin + NS_PER_SEC : INT64_MAX;
+}
+
+/*
+ * @brief refresh(tubes_t *t, int64_t end) sends refresh words until CLOCK_REALTIME ns end, the
+ * time comes back with the next flip
+ */
+static void refresh(tubes_t *t, int64_t end)
+{
+    int64_t left = end - realnow();
+    uint32_t count = 0;
+
+    while ((left >= TUBEFX_REFRESH_STEP_MS * 1000000LL) && (count < TUBEFX_BURST)) {
+        memcpy(&t->tx[count * sizeof(uint64_t)], &t->sequence[t->step], sizeof(uint64_t));
+        t->show[count++] = TUBEFX_REFRESH_STEP_MS * 1000;
+        t->step = (t->step + 1) % NIXIE_DIGITS;
+        left -= TUBEFX_REFRESH_STEP_MS * 1000000LL;
+    }
+    if (count == 0) return;
+    send(t, count);
+    memcpy(&t->shown, &t->tx[(count - 1) * sizeof(uint64_t)], sizeof(uint64_t));
+}
+
+/*
+ * @brief sleepUntil(int64_t at) sleeps until the realtime clock reaches at, a wake()
+ * or termination, INT64_MAX for no time
+ */
+static void sleepUntil(int64_t at)
+{
+    struct pollfd pfd[2] = {{.fd = wakefd, .events = POLLIN}, {.fd = terminate.fd, .events = POLLIN}};
+    struct timespec timeout;
+    int64_t left = at - realnow();
+    uint64_t count;
+
+    if (left <= 0) return;
+    timeout.tv_sec = left / NS_PER_SEC;
+    timeout.tv_nsec = left % NS_PER_SEC;
+    trace_event(TRACE_SLEEP, 0);
+    ppoll(pfd, 2, (at == INT64_MAX) ? NULL : &timeout, NULL);
+    trace_event(TRACE_WAKE, 0);
+    if ((pfd[0].revents & POLLIN) && (read(wakefd, &count, sizeof(count)) < 0)) return;
+}
+
+/*
+ * @brief tubefxTask shows the frames the clock hands over with the fades and brightness of
+ * tubeconfig
+ *
+ * @param[in] threadid unused
+ */
+void *tubefxTask(void *threadid)
+{
+    tubes_t *t = calloc(1, sizeof(tubes_t));
+    int64_t now, next, gap;
+    uint32_t count;
+
+    trace_thread("tubes");
+    /* it flips the tubes on the boundary, so it runs as the clock does */
+    realtime_thread(RT_CLOCK);
+    if (t == NULL) {
+        notifyToTerminate();
+        pthread_exit((void *)EXIT_FAILURE);
+    }
+    t->spifd = backend->spi_open();
+    t->gpiomap = backend->gpio_open();
+    if (t->gpiomap == NULL) {
+        fprintf(stderr,"Failed to open GPIO\n");
+        free(t);
+        notifyToTerminate();
+        pthread_exit((void *)EXIT_FAILURE);
+    }
+    backend->gpio_function(t->gpiomap, LE, FSEL_OUTPUT);
+    sequenceInit(t);
+    if (tubefx_driving()) shift(t, 0);
+    while (!isTerminate()) {
+        now = realnow();
+        take(t, now);
+        next = (t->npending > 0) ? (int64_t) t->pending[0].second * NS_PER_SEC : INT64_MAX;
+        if (next - now <= FLIP_LEAD) {
+            flip(t, next);
+            next = (t->npending > 0) ? (int64_t) t->pending[0].second * NS_PER_SEC : INT64_MAX;
+        }
+        now = realnow();
+        gap = refreshGap(t, now);
+        if (gap <= now) {
+            /* up to the next flip, or the end of the second if the clock has not handed it over */
+            refresh(t, ((next < (now / NS_PER_SEC + 1) * NS_PER_SEC) ? next : (now / NS_PER_SEC + 1) * NS_PER_SEC)
+                - FLIP_LEAD);
+            continue;
+        }
+        /* wake for whichever comes first, the next flip or the next refresh gap */
+        if (gap > next - FLIP_LEAD) gap = (next == INT64_MAX) ? next : next - FLIP_LEAD;
+        /* nothing to switch, a blank tube is blank at any brightness */
+        if (!t->fading && ((onSteps() == TUBEFX_STEPS) || (t->to == 0))) {
+            if (tubefx_driving() && (t->shown != t->to)) shift(t, t->to);
+            sleepUntil(gap);
+            continue;
+        }
+        count = render(t, (gap == INT64_MAX) ? INT64_MAX : gap - realnow());
+        if (count == 0) {
+            sleepUntil(gap);
+        } else {
+            send(t, count);
+        }
+    }
+    if (tubefx_driving()) shift(t, 0);
+#ifdef DEBUG
+    fprintf(stdout, "tube flips %llu worst %ld ns, bursts %llu of %llu words, dropped %llu\n",
+        (unsigned long long) atomic_load(&tubefxstats.flips), (long) atomic_load(&tubefxstats.maxLate),
+        (unsigned long long) atomic_load(&tubefxstats.bursts), (unsigned long long) atomic_load(&tubefxstats.words),
+        (unsigned long long) atomic_load(&tubefxstats.dropped));
+    for (int s = 0; s < NIXIE_TUBES; s++) {
+        uint64_t least = UINT64_MAX, most = 0;
+        for (int d = 0; d < NIXIE_DIGITS; d++) {
+            uint64_t lit = atomic_load(&tubefxstats.cathode[s][d]);
+            if (lit < least) least = lit;
+            if (lit > most) most = lit;
+        }
+        fprintf(stdout, "tube %d cathodes lit %.1f s to %.1f s\n", s, (double) least / 1e9, (double) most / 1e9);
+    }
+#endif
+    close(t->spifd);
+    free(t);
+    return NULL;
+}
+
+void tubefx_close(void)
+{
+    if (wakefd >= 0) close(wakefd);
+    wakefd = -1;
+}
@@ -0,0 +1,184 @@
+/*
+ * @file tzcache.c
+ * @brief caches the local UTC offset between zone transitions
+ * @details for raspberry pi 3B+
+ * localtime() takes the tzfile lock and does a full broken down conversion. The clock only needs
+ * hours, minutes and seconds, which are integer arithmetic on tv_sec once the UTC offset is known.
+ * The offset is resolved with localtime_r() and the next transition is found by stepping a day at
+ * a time then bisecting to the second. Conversions in between never touch the zone database.
+ * @copyright Copyright  Alkgrove Electronics 2018 Company Confidential
+ * @author Robert Alkire
+ * @date  10/17/2026
+ *
+ * @par Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ * and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+ * and the following disclaimer in the documentation and/or other materials provided with the
+ * distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without specific prior written
+ * permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "tzcache.h"
+
+static long utcoffset(time_t t)
+{
+    struct tm tm;
+    if (localtime_r(&t, &tm) == NULL) return 0;
+    return tm.tm_gmtoff;
+}
+
+/*
+ * @brief nexttransition(time_t t, long offset)
+ * @return first second after t whose UTC offset differs from offset, or t + TZCACHE_HORIZON
+ */
+static time_t nexttransition(time_t t, long offset)
+{
+    time_t lo = t;
+    time_t hi;
+    time_t mid;
+
+    for (hi = t + SECONDS_PER_DAY; hi <= t + TZCACHE_HORIZON; hi += SECONDS_PER_DAY) {
+        if (utcoffset(hi) != offset) break;
+        lo = hi;
+    }
+    if (hi > t + TZCACHE_HORIZON) return t + TZCACHE_HORIZON;
+    /* offset at lo is the cached one, at hi it is not */
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+        if (utcoffset(mid) == offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return hi;
+}
+
+/*
+ * @brief tzcache_resolve(tzcache_t *tz, time_t t)
+ * Finds the UTC offset at t and how long it holds. Within a still valid span this is only a recheck
+ * that the zone has not been changed under us, at a transition or after a clock step it searches
+ * for the next transition.
+ * @param[in,out] tz - cache
+ * @param[in] t - UTC seconds
+ */
+void tzcache_resolve(tzcache_t *tz, time_t t)
+{
+    long offset;
+
+    tzset();
+    offset = utcoffset(t);
+    tz->resolves++;
+    if ((t < tz->from) || (t >= tz->transition) || (offset != tz->offset) ||
+        ((tz->transition < tz->from + TZCACHE_HORIZON) && (utcoffset(tz->transition) == offset))) {
+        tz->offset = offset;
+        tz->transition = nexttransition(t, offset);
+        tz->from = t;
+    }
+    tz->until = (tz->transition < t + TZCACHE_RECHECK) ? tz->transition : t + TZCACHE_RECHECK;
+}
+
+/* zones with unusual rules, half hour DST and southern hemisphere summers */
+static const char *testzones[] = {
+    NULL, "UTC", "America/New_York", "Europe/London", "Australia/Lord_Howe", "Pacific/Chatham",
+    "America/Sao_Paulo", "Asia/Kolkata",
+};
+
+static int selftestzone(time_t start, int years)
+{
+    tzcache_t tz = {0};
+    struct tm tm;
+    time_t end = start + (time_t) years * 36525L * SECONDS_PER_DAY / 100;
+    time_t t;
+    time_t probe;
+    time_t transition;
+    int h, m, s;
+    int errors = 0;
+    uint32_t transitions = 0;
+    long checks = 0;
+
+    tzcache_invalidate(&tz);
+    /* walk forward the way the clock does, with an odd stride so every time of day gets hit,
+     * and check the seconds either side of every transition the cache finds */
+    for (t = start; t < end; t += 997) {
+        tzcache_hms(&tz, t, &h, &m, &s);
+        if (tz.transition < t + 997) {
+            transition = tz.transition;
+            for (probe = transition - 2; probe <= transition + 2; probe++) {
+                int ph, pm, ps;
+                tzcache_hms(&tz, probe, &ph, &pm, &ps);
+                localtime_r(&probe, &tm);
+                checks++;
+                if ((ph != tm.tm_hour) || (pm != tm.tm_min) || (ps != tm.tm_sec)) {
+                    if (errors++ < 10) fprintf(stderr, "  %ld: cache %02d:%02d:%02d localtime %02d:%02d:%02d\n",
+                        (long) probe, ph, pm, ps, tm.tm_hour, tm.tm_min, tm.tm_sec);
+                }
+            }
+            transitions++;
+            tzcache_hms(&tz, t, &h, &m, &s);
+        }
+        localtime_r(&t, &tm);
+        checks++;
+        if ((h != tm.tm_hour) || (m != tm.tm_min) || (s != tm.tm_sec)) {
+            if (errors++ < 10) fprintf(stderr, "  %ld: cache %02d:%02d:%02d localtime %02d:%02d:%02d\n",
+                (long) t, h, m, s, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        }
+    }
+    fprintf(stdout, "%-20s %8ld checks %4u spans %6u resolves %d errors\n",
+        getenv("TZ") ? getenv("TZ") : "(system)", checks, transitions, tz.resolves, errors);
+    return errors;
+}
+
+/*
+ * @brief tzcache_selftest(time_t start, int years)
+ * compares the cache against localtime() over the given span for the system zone and a set of
+ * zones with awkward transitions
+ * @return number of mismatches
+ */
+int tzcache_selftest(time_t start, int years)
+{
+    char *saved = getenv("TZ");
+    int errors = 0;
+
+    if (saved != NULL) saved = strdup(saved);
+    for (int i = 0; i < sizeof(testzones)/sizeof(char *); i++) {
+        if (testzones[i] == NULL) {
+            unsetenv("TZ");
+        } else {
+            setenv("TZ", testzones[i], 1);
+        }
+        tzset();
+        errors += selftestzone(start, years);
+    }
+    if (saved != NULL) {
+        setenv("TZ", saved, 1);
+        free(saved);
+    } else {
+        unsetenv("TZ");
+    }
+    tzset();
+    return errors;
+}
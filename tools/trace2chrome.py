@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Convert a pixied event trace (SIGUSR1 or a missed second, see inc/trace.h) to Chrome trace JSON.
+
+usage: trace2chrome.py [/run/pixie.trace] [pixie.json]
+
+Open the output in chrome://tracing or https://ui.perfetto.dev. Times are microseconds of
+CLOCK_MONOTONIC, the wall clock time of the first event is in the metadata.
+"""
+import json
+import struct
+import sys
+import time
+
+HEADER = struct.Struct('<4sIIIq')
+RING = struct.Struct('<16sQ')
+EVENT = struct.Struct('<qII')
+
+# type: (name, phase), B and E pairs are spans, i instants, the same table as TRACE_EVENT_e
+EVENTS = {
+    1: ('sleep', 'B'),
+    2: ('sleep', 'E'),
+    3: ('boundary', 'i'),
+    4: ('spi', 'B'),
+    5: ('spi', 'E'),
+    6: ('latch', 'i'),
+    7: ('build', 'B'),
+    8: ('build', 'E'),
+    9: ('render', 'B'),
+    10: ('render', 'E'),
+    11: ('missed', 'i'),
+    12: ('stepped', 'i'),
+    13: ('live', 'i'),
+}
+ARGS = {2: 'late_ns', 6: 'after_boundary_ns', 8: 'changed', 11: 'seconds'}
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, version, rings, count, realtime = HEADER.unpack_from(data, 0)
+    if magic != b'PXTR' or version != 1:
+        sys.exit('%s is not a pixied trace' % path)
+    offset = HEADER.size
+    threads = []
+    for _ in range(rings):
+        name, head = RING.unpack_from(data, offset)
+        offset += RING.size
+        events = [EVENT.unpack_from(data, offset + i * EVENT.size) for i in range(count)]
+        offset += count * EVENT.size
+        # oldest first, anything overwritten while the dump was written is older than head - count
+        first = max(0, head - count)
+        ordered = [events[i % count] for i in range(first, head)]
+        threads.append((name.rstrip(b'\0').decode(), sorted(e for e in ordered if e[0] > 0)))
+    return realtime, threads
+
+
+def convert(realtime, threads):
+    out = []
+    start = min((events[0][0] for _, events in threads if events), default=0)
+    for tid, (name, events) in enumerate(threads, 1):
+        out.append({'ph': 'M', 'pid': 1, 'tid': tid, 'name': 'thread_name', 'args': {'name': name}})
+        open_spans = set()
+        for ns, kind, arg in events:
+            label, phase = EVENTS.get(kind, ('event %d' % kind, 'i'))
+            # a ring that wrapped can start with the end of a span
+            if phase == 'E' and label not in open_spans:
+                continue
+            if phase == 'B':
+                open_spans.add(label)
+            elif phase == 'E':
+                open_spans.discard(label)
+            event = {'name': label, 'ph': phase, 'pid': 1, 'tid': tid, 'ts': (ns - start) / 1000.0}
+            if phase == 'i':
+                event['s'] = 't'
+            if kind in ARGS:
+                event['args'] = {ARGS[kind]: arg}
+            out.append(event)
+    wall = time.strftime('%Y-%m-%d %H:%M:%S', time.localtime((start + realtime) / 1e9))
+    return {'traceEvents': out, 'displayTimeUnit': 'ns', 'metadata': {'first event': wall}}
+
+
+def main():
+    source = sys.argv[1] if len(sys.argv) > 1 else '/run/pixie.trace'
+    target = sys.argv[2] if len(sys.argv) > 2 else 'pixie.json'
+    realtime, threads = read(source)
+    with open(target, 'w') as f:
+        json.dump(convert(realtime, threads), f)
+    print('%s: %d threads, %d events written to %s' % (source, len(threads),
+          sum(len(events) for _, events in threads), target))
+
+
+if __name__ == '__main__':
+    main()